@@ -4,6 +4,7 @@
 #include <raylib.h>
 #include <raymath.h>
 #include "../src/game.h"
+#include "../src/obstacleindex.h"
 
 typedef enum
 {
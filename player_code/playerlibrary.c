@@ -0,0 +1,109 @@
+#include "player.h"
+#include "../src/candidates.h"
+#include "../src/shotlibrary.h"
+#include <stdio.h>
+#include <math.h>
+
+char *name = "Library Player";
+char *description = "This player looks up every open direct pot in a precomputed shot library and picks the speed and spin that leave the cue ball nearest to a straight shot on the next ball.";
+
+ShotLibrary *loaded_library = NULL;
+bool tried_library = false;
+CandidateList *list = NULL;
+
+Vector3 next_target(Game *game, Ball *ball)
+{
+    for (int i = 0; i < game->scene.ball_set.num_balls; i++)
+    {
+        Ball *next_ball = &(game->scene.ball_set.balls[i]);
+        if (next_ball->id == 0 || next_ball->id == ball->id || next_ball->pocketed)
+        {
+            continue;
+        }
+        Vector3 nearest_pocket = game->scene.table.pockets[0].position;
+        for (int j = 1; j < game->scene.table.num_pockets; j++)
+        {
+            Vector3 pocket = game->scene.table.pockets[j].position;
+            if (Vector3Distance(pocket, next_ball->initial_position) < Vector3Distance(nearest_pocket, next_ball->initial_position))
+            {
+                nearest_pocket = pocket;
+            }
+        }
+        return Vector3Add(next_ball->initial_position, Vector3Scale(Vector3Normalize(Vector3Subtract(next_ball->initial_position, nearest_pocket)), 0.4));
+    }
+    return Vector3Zero();
+}
+
+bool safe_rest(Game *game, Vector3 position, double radius)
+{
+    for (int i = 0; i < game->scene.table.num_pockets; i++)
+    {
+        if (Vector3Distance(position, game->scene.table.pockets[i].position) < 2 * game->scene.table.pockets[i].radius)
+        {
+            return false;
+        }
+    }
+    Vector3 low = game->scene.table.cushions[0].p1;
+    Vector3 high = low;
+    for (int i = 0; i < game->scene.table.num_cushions; i++)
+    {
+        low = Vector3Min(low, Vector3Min(game->scene.table.cushions[i].p1, game->scene.table.cushions[i].p2));
+        high = Vector3Max(high, Vector3Max(game->scene.table.cushions[i].p1, game->scene.table.cushions[i].p2));
+    }
+    return position.x > low.x + radius && position.x < high.x - radius && position.y > low.y + radius && position.y < high.y - radius;
+}
+
+void pot_ball(Game *game, Ball *ball)
+{
+    if (!tried_library)
+    {
+        tried_library = true;
+        loaded_library = open_shot_library("shot_library.bin", game->scene.coefficients, game->scene.ball_set.balls[0].radius);
+        list = create_candidate_list();
+    }
+    Ball *cue_ball = &(game->scene.ball_set.balls[0]);
+    Vector3 aim_line = Vector3Subtract(ball->initial_position, cue_ball->initial_position);
+    game->v = Vector3Scale(Vector3Normalize(aim_line), 3);
+    game->w = Vector3Zero();
+    if (loaded_library == NULL)
+    {
+        return;
+    }
+
+    enumerate_candidates(game, ball, list);
+    Vector3 target = next_target(game, ball);
+    double best_score = INFINITY;
+    for (int i = 0; i < list->num_candidates; i++)
+    {
+        ShotCandidate *candidate = &(list->candidates[i]);
+        if (candidate->type != DIRECT_SHOT || candidate->blocked || candidate->cut_cosine < 0.2 || !strike_hits_ball_first(game, candidate->object_ball, candidate->v, candidate->w))
+        {
+            continue;
+        }
+        double pocket_distance = Vector3Distance(ball->initial_position, game->scene.table.pockets[candidate->pocket].position);
+        for (double speed = 1; speed <= 7; speed += 0.25)
+        {
+            for (double spin_ratio = -2.5; spin_ratio <= 2.5; spin_ratio += 0.25)
+            {
+                LibraryOutcome outcome;
+                if (!lookup_shot_library(loaded_library, game->scene.coefficients, cue_ball->radius, cue_ball->initial_position, candidate->aim_point, ball->initial_position, speed, spin_ratio, &outcome))
+                {
+                    continue;
+                }
+                if (outcome.object_travel < pocket_distance + ball->radius || !safe_rest(game, outcome.cue_rest, cue_ball->radius))
+                {
+                    continue;
+                }
+                // Prefer softer shots when the position is equally good.
+                double score = Vector3Distance(outcome.cue_rest, target) + 0.02 * speed;
+                if (score < best_score)
+                {
+                    best_score = score;
+                    Vector3 aim = Vector3Normalize(Vector3Subtract(candidate->aim_point, cue_ball->initial_position));
+                    game->v = Vector3Scale(aim, speed);
+                    game->w = library_strike_spin(aim, speed, spin_ratio, cue_ball->radius);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#include "player.h"
+#include "../src/pipeline.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+char *name = "Ranked Player";
+char *description = "This player lists every direct, bank, kick and combo shot, simulates the most promising ones and plays the one that leaves the best next shot.";
+
+ShotPipeline *pipeline = NULL;
+// The pipeline keeps its counters in pipeline->total either way; set
+// POOL_PIPELINE_STATS to have them printed every 100 decisions.
+bool print_stats = false;
+
+void pot_ball(Game *game, Ball *ball)
+{
+    if (pipeline == NULL)
+    {
+        pipeline = create_shot_pipeline(16, 4);
+        print_stats = getenv("POOL_PIPELINE_STATS") != NULL;
+    }
+    if (!choose_shot(pipeline, game, ball, &(game->v), &(game->w)))
+    {
+        Vector3 aim_line = Vector3Subtract(ball->initial_position, game->scene.ball_set.balls[0].initial_position);
+        game->v = Vector3Scale(Vector3Normalize(aim_line), 3);
+        game->w = Vector3Zero();
+    }
+    if (print_stats && pipeline->num_decisions % 100 == 0)
+    {
+        print_pipeline_stats(pipeline);
+    }
+}
@@ -0,0 +1,52 @@
+#include "player.h"
+#include "../src/candidates.h"
+#include "../src/robustness.h"
+
+char *name = "Safe Player";
+char *description = "This player replays each open direct and bank shot many times with realistic cueing errors and plays the one most likely to pot without scratching.";
+
+CandidateList *list = NULL;
+RobustnessEvaluator *evaluator = NULL;
+// About 0.3 degrees of aim error, 5% of speed and a little unintended spin.
+ExecutionNoise noise = {0.005, 0.05, 2};
+
+void pot_ball(Game *game, Ball *ball)
+{
+    if (list == NULL)
+    {
+        list = create_candidate_list();
+        evaluator = create_robustness_evaluator(0);
+    }
+    Vector3 aim_line = Vector3Subtract(ball->initial_position, game->scene.ball_set.balls[0].initial_position);
+    game->v = Vector3Scale(Vector3Normalize(aim_line), 3);
+    game->w = Vector3Zero();
+
+    enumerate_candidates(game, ball, list);
+    double best_score = 0;
+    int num_tried = 0;
+    for (int i = 0; i < list->num_candidates && num_tried < 8; i++)
+    {
+        ShotCandidate *candidate = &(list->candidates[i]);
+        if ((candidate->type != DIRECT_SHOT && candidate->type != BANK_SHOT) || candidate->blocked || candidate->cut_cosine < 0.3)
+        {
+            continue;
+        }
+        // The analytic strike only just reaches the pocket, so hit it firmer.
+        Vector3 v = Vector3Scale(candidate->v, 1.5);
+        Vector3 w = Vector3Scale(candidate->w, 1.5);
+        if (!strike_hits_ball_first(game, candidate->object_ball, v, w))
+        {
+            continue;
+        }
+        num_tried++;
+        // Every candidate sees the same errors, so they are compared fairly.
+        Robustness robustness = evaluate_robustness(evaluator, game, v, w, noise, 64, 1);
+        double score = robustness.pot_probability - robustness.scratch_probability;
+        if (score > best_score)
+        {
+            best_score = score;
+            game->v = v;
+            game->w = w;
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#include "player.h"
+#include "../src/candidates.h"
+#include "../src/potwindow.h"
+#include <math.h>
+
+char *name = "Window Player";
+char *description = "This player finds the exact range of angles that pots each open direct shot and plays the widest one through its centre.";
+
+GameFork *window_fork = NULL;
+CandidateList *list = NULL;
+
+void pot_ball(Game *game, Ball *ball)
+{
+    if (window_fork == NULL)
+    {
+        window_fork = create_game_fork(game->scene.ball_set.num_balls);
+        list = create_candidate_list();
+    }
+    enumerate_candidates(game, ball, list);
+
+    PotWindow best = {false, 0, 0, 0, 0, 0};
+    double best_speed = 0;
+    double best_spin = 0;
+    int num_tried = 0;
+    for (int i = 0; i < list->num_candidates && num_tried < 4; i++)
+    {
+        ShotCandidate *candidate = &(list->candidates[i]);
+        if (candidate->type != DIRECT_SHOT || candidate->blocked || candidate->cut_cosine < 0.5)
+        {
+            continue;
+        }
+        // The analytic strike only just reaches the pocket, so hit it firmer.
+        Vector3 across = Vector3Normalize(Vector3CrossProduct(candidate->v, (Vector3){0, 0, 1}));
+        double speed = 1.5 * Vector3Length(candidate->v);
+        double spin = 1.5 * Vector3DotProduct(candidate->w, across);
+        if (!strike_hits_ball_first(game, candidate->object_ball, Vector3Scale(Vector3Normalize(candidate->v), speed), Vector3Scale(across, spin)))
+        {
+            continue;
+        }
+        num_tried++;
+        PotWindow window = find_pot_window(window_fork, game, ball, candidate->pocket, speed, spin);
+        if (window.found && (!best.found || window.width > best.width))
+        {
+            best = window;
+            best_speed = speed;
+            best_spin = spin;
+        }
+    }
+
+    if (best.found)
+    {
+        Vector3 aim_line = {cos(best.centre_angle), sin(best.centre_angle), 0};
+        game->v = Vector3Scale(aim_line, best_speed);
+        game->w = Vector3Scale(Vector3Normalize(Vector3CrossProduct(aim_line, (Vector3){0, 0, 1})), best_spin);
+        return;
+    }
+    Vector3 aim_line = Vector3Subtract(ball->initial_position, game->scene.ball_set.balls[0].initial_position);
+    game->v = Vector3Scale(Vector3Normalize(aim_line), 3);
+    game->w = Vector3Zero();
+}
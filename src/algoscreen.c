@@ -39,8 +39,12 @@ Screen *update_algorithm_screen(Screen *screen)
     Game *game = algo_screen->game;
     Ball *ball = &game->scene.ball_set.balls[algo_screen->current_ball];
     Vector2 mouse_position = GetMousePosition();
-    ball->initial_position = (Vector3){mouse_position.x, mouse_position.y, 0};
-    ball->initial_position = Vector3Scale(ball->initial_position, 1.0 / 200);
+    Vector3 position = Vector3Scale((Vector3){mouse_position.x, mouse_position.y, 0}, 1.0 / 200);
+    if (position.x != ball->initial_position.x || position.y != ball->initial_position.y)
+    {
+        ball->initial_position = position;
+        refresh_table_state(game);
+    }
     Ball *target_ball = &game->scene.ball_set.balls[1];
     algo_screen->game->players[0].module.pot_ball(algo_screen->game, target_ball);
     clear_paths(&game->scene);
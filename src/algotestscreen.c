@@ -6,6 +6,8 @@ Screen *create_algorithm_test_screen(Game *game)
 {
     AlgorithmTestScreen *screen = malloc(sizeof(AlgorithmTestScreen));
     screen->game = game;
+    screen->outcome_map = create_outcome_map(0);
+    screen->max_spin = 0;
     screen->base.update = update_algorithm_test_screen;
     screen->base.render = render_algorithm_test_screen;
     return (Screen *)screen;
@@ -16,33 +18,55 @@ Screen *update_algorithm_test_screen(Screen *screen)
     AlgorithmTestScreen *algo_screen = (AlgorithmTestScreen *)screen;
     if (IsKeyPressed(KEY_ESCAPE))
     {
+        free_outcome_map(algo_screen->outcome_map);
         free(screen);
         return (Screen *)create_main_menu_screen();
     }
-
-    for (int i = 0; i < 100; i++)
+    if (IsKeyPressed(KEY_SPACE))
     {
-        Vector2 m = GetMousePosition();
-        Vector3 v = Vector3Subtract((Vector3){m.x, m.y, 0}, Vector3Scale(algo_screen->game->scene.ball_set.balls[0].initial_position, 200));
-        v = Vector3Normalize(v);
-        v = Vector3Scale(v, i * 0.05);
+        algo_screen->max_spin = algo_screen->max_spin > 0 ? 0 : 60;
+        algo_screen->outcome_map->table_version = -1;
+    }
 
-        clear_paths(&algo_screen->game->scene);
-        generate_shot(algo_screen->game, v, (Vector3){0, 0, 0});
-        Path path = algo_screen->game->current_shot.ball_paths[0];
-        algo_screen->possible_paths[i] = path.segments[path.num_segments - 1].initial_position;
+    // The map is refined a batch at a time so the screen stays responsive,
+    // and starts again whenever the balls have moved.
+    if (algo_screen->outcome_map->table_version != algo_screen->game->table_version)
+    {
+        reset_outcome_map(algo_screen->outcome_map, algo_screen->game, 0.05, 5, algo_screen->max_spin, 32);
     }
+    update_outcome_map(algo_screen->outcome_map, algo_screen->game, 128);
     update_game(algo_screen->game);
     return screen;
 }
 
 void render_algorithm_test_screen(Screen *screen)
 {
+    AlgorithmTestScreen *algo_screen = (AlgorithmTestScreen *)screen;
+    OutcomeMap *map = algo_screen->outcome_map;
     ClearBackground(GREEN);
-    render_game(((AlgorithmTestScreen *)screen)->game);
-    for (int i = 0; i < 99; i++)
+    render_game(algo_screen->game);
+    Vector3 cue_ball = algo_screen->game->scene.ball_set.balls[0].initial_position;
+    for (int i = 0; i < map->num_samples; i++)
     {
-        Vector3 p1 = ((AlgorithmTestScreen *)screen)->possible_paths[i];
-        DrawCircle(p1.x * 200, p1.y * 200, 5, RED);
+        OutcomeSample sample = map->samples[i];
+        if (!sample.done || (sample.pocketed & 1))
+        {
+            continue;
+        }
+        Vector3 p = sample.rest_position;
+        if (sample.pocketed != 0)
+        {
+            // Pot windows are drawn as spokes around the cue ball, longer for
+            // faster strikes.
+            Vector3 d = outcome_strike_velocity(sample);
+            DrawLine(cue_ball.x * 200, cue_ball.y * 200, (cue_ball.x + 0.1 * d.x) * 200, (cue_ball.y + 0.1 * d.y) * 200, YELLOW);
+            DrawCircle(p.x * 200, p.y * 200, 2, BLUE);
+        }
+        else
+        {
+            DrawCircle(p.x * 200, p.y * 200, 2, RED);
+        }
     }
-}
\ No newline at end of file
+    DrawText(TextFormat("Samples: %d  Cells: %d/%d", map->num_samples, map->next_cell, map->num_cells), 10, 70, 20, WHITE);
+    DrawText(algo_screen->max_spin > 0 ? "Spin: on (Space to toggle)" : "Spin: off (Space to toggle)", 10, 100, 20, WHITE);
+}
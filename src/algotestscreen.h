@@ -1,11 +1,13 @@
 #include "screen.h"
 #include "game.h"
+#include "outcomemap.h"
 
 typedef struct AlgorithmTestScreen
 {
     Screen base;
     Game *game;
-    Vector3 possible_paths[100];
+    OutcomeMap *outcome_map;
+    double max_spin;
 } AlgorithmTestScreen;
 
 Screen *create_algorithm_test_screen(Game *game);
@@ -0,0 +1,40 @@
+#include "analytics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[])
+{
+    int num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int first_path = 1;
+    if (argc > 2 && strcmp(argv[1], "-j") == 0)
+    {
+        num_threads = atoi(argv[2]);
+        first_path = 3;
+    }
+    if (num_threads <= 0)
+    {
+        printf("Usage: %s [-j threads] [replay.bin ...]\n", argv[0]);
+        return 1;
+    }
+    char *default_path = "frames.bin";
+    char **paths = first_path < argc ? &(argv[first_path]) : &default_path;
+    int num_paths = first_path < argc ? argc - first_path : 1;
+
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    Analytics *analytics = analyse_replays(paths, num_paths, num_threads);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (analytics == NULL)
+    {
+        return 1;
+    }
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    print_analytics(analytics);
+    printf("\nScanned %.1f MB on %d threads in %.3f s\n", analytics->num_bytes / 1e6, num_threads, seconds);
+    free_analytics(analytics);
+    return 0;
+}
@@ -0,0 +1,501 @@
+#include "analytics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+typedef struct
+{
+    Replay *replay;
+    int *player_slots;
+    int cue_ball;
+} AnalyticsFile;
+
+typedef struct
+{
+    AnalyticsFile *files;
+    int num_files;
+    int next_file;
+    int next_frame;
+    pthread_mutex_t lock;
+} AnalyticsQueue;
+
+typedef struct
+{
+    AnalyticsQueue *queue;
+    Analytics totals;
+    bool *pocketed;
+} AnalyticsWorker;
+
+void add_frame_length(FrameLengths *lengths, int num_shots, long count)
+{
+    if (num_shots >= lengths->size)
+    {
+        int size = lengths->size == 0 ? 64 : lengths->size;
+        while (num_shots >= size)
+        {
+            size *= 2;
+        }
+        lengths->counts = realloc(lengths->counts, size * sizeof(long));
+        memset(lengths->counts + lengths->size, 0, (size - lengths->size) * sizeof(long));
+        lengths->size = size;
+    }
+    lengths->counts[num_shots] += count;
+}
+
+void merge_frame_lengths(FrameLengths *into, FrameLengths *from)
+{
+    for (int i = 0; i < from->size; i++)
+    {
+        if (from->counts[i] > 0)
+        {
+            add_frame_length(into, i, from->counts[i]);
+        }
+    }
+}
+
+// Hands out the next run of frames, moving on to the next file once one
+// is used up. Returns the number of frames taken, 0 when there are none left.
+int take_analytics_frames(AnalyticsQueue *queue, AnalyticsFile **file, int *first)
+{
+    pthread_mutex_lock(&(queue->lock));
+    while (queue->next_file < queue->num_files && queue->next_frame >= (int)queue->files[queue->next_file].replay->num_frames)
+    {
+        queue->next_file++;
+        queue->next_frame = 0;
+    }
+    int count = 0;
+    if (queue->next_file < queue->num_files)
+    {
+        *file = &(queue->files[queue->next_file]);
+        *first = queue->next_frame;
+        count = (*file)->replay->num_frames - queue->next_frame;
+        if (count > ANALYTICS_CHUNK_FRAMES)
+        {
+            count = ANALYTICS_CHUNK_FRAMES;
+        }
+        queue->next_frame += count;
+    }
+    pthread_mutex_unlock(&(queue->lock));
+    return count;
+}
+
+void analyse_frame(AnalyticsWorker *worker, AnalyticsFile *file, ReplayFrame *frame)
+{
+    Replay *replay = file->replay;
+    Analytics *totals = &(worker->totals);
+    int num_balls = replay->header->num_balls;
+    int num_players = replay->header->num_players;
+    int cue_ball = file->cue_ball;
+    for (int i = 0; i < num_balls; i++)
+    {
+        worker->pocketed[i] = false;
+    }
+
+    for (uint32_t i = 0; i < frame->num_shots; i++)
+    {
+        ReplayShot *shot = replay_shot(replay, frame, i);
+        ShotEvent *events = shot == NULL ? NULL : replay_events(replay, shot);
+        if (events == NULL)
+        {
+            continue;
+        }
+        totals->num_shots++;
+        PlayerAnalytics *player = NULL;
+        if (shot->player >= 0 && shot->player < num_players)
+        {
+            player = &(totals->players[file->player_slots[shot->player]]);
+        }
+        int target = -1;
+        for (int j = 0; j < num_balls; j++)
+        {
+            if (j != cue_ball && !worker->pocketed[j])
+            {
+                target = j;
+                break;
+            }
+        }
+
+        int first_contact = -1;
+        bool potted = false;
+        bool scratched = false;
+        for (uint32_t j = 0; j < shot->num_events; j++)
+        {
+            ShotEvent event = events[j];
+            if (player != NULL && event.type < ANALYTICS_NUM_EVENT_TYPES)
+            {
+                player->num_events[event.type]++;
+            }
+            if (event.type == BALL_BALL_COLLISION && first_contact < 0 && (event.ball1 == cue_ball || event.ball2 == cue_ball))
+            {
+                first_contact = event.ball1 == cue_ball ? event.ball2 : event.ball1;
+            }
+            if (event.type != BALL_POCKETED || event.ball1 < 0 || event.ball1 >= num_balls)
+            {
+                continue;
+            }
+            if (event.ball1 == cue_ball)
+            {
+                scratched = true;
+                continue;
+            }
+            if (worker->pocketed[event.ball1])
+            {
+                continue;
+            }
+            potted = true;
+            worker->pocketed[event.ball1] = true;
+            if (player != NULL)
+            {
+                player->pots++;
+                if (event.cushion_or_pocket >= 0 && event.cushion_or_pocket < ANALYTICS_MAX_POCKETS)
+                {
+                    player->pocket_pots[event.cushion_or_pocket]++;
+                }
+            }
+        }
+        if (player != NULL)
+        {
+            player->num_shots++;
+            player->potting_shots += potted;
+            player->scratches += scratched;
+            player->accurate_first_contacts += target >= 0 && first_contact == target;
+            player->missed_contacts += first_contact < 0;
+        }
+    }
+
+    if (frame->winner < 0 || frame->winner >= num_players)
+    {
+        totals->unfinished_frames++;
+        return;
+    }
+    totals->num_frames++;
+    add_frame_length(&(totals->frame_lengths), frame->num_shots, 1);
+    for (int i = 0; i < num_players; i++)
+    {
+        totals->players[file->player_slots[i]].num_frames++;
+    }
+    PlayerAnalytics *winner = &(totals->players[file->player_slots[frame->winner]]);
+    winner->frames_won++;
+    add_frame_length(&(winner->won_frame_lengths), frame->num_shots, 1);
+}
+
+void *run_analytics_worker(void *arg)
+{
+    AnalyticsWorker *worker = arg;
+    AnalyticsFile *file;
+    int first;
+    int count;
+    while ((count = take_analytics_frames(worker->queue, &file, &first)) > 0)
+    {
+        for (int i = first; i < first + count; i++)
+        {
+            ReplayFrame *frame = replay_frame(file->replay, i);
+            if (frame != NULL)
+            {
+                analyse_frame(worker, file, frame);
+            }
+        }
+    }
+    return NULL;
+}
+
+// Players are matched across files by name. A file that gives two players
+// the same name has the later ones numbered so their shots stay apart.
+int analytics_player_slot(Analytics *analytics, int *capacity, Replay *replay, int player)
+{
+    ReplayPlayer *record = replay_player(replay, player);
+    char *text = record == NULL ? NULL : replay_text(replay, record->name_offset, record->name_length);
+    int length = text == NULL ? 0 : record->name_length;
+    char *name = malloc(length + 16);
+    if (length > 0)
+    {
+        memcpy(name, text, length);
+    }
+    name[length] = '\0';
+    for (int i = 0; i < player; i++)
+    {
+        ReplayPlayer *other = replay_player(replay, i);
+        char *other_text = other == NULL ? NULL : replay_text(replay, other->name_offset, other->name_length);
+        if (other_text != NULL && other->name_length == (uint32_t)length && memcmp(other_text, name, length) == 0)
+        {
+            sprintf(name + length, " (%d)", player + 1);
+            break;
+        }
+    }
+
+    for (int i = 0; i < analytics->num_players; i++)
+    {
+        if (strcmp(analytics->players[i].name, name) == 0)
+        {
+            free(name);
+            return i;
+        }
+    }
+    if (analytics->num_players == *capacity)
+    {
+        *capacity *= 2;
+        analytics->players = realloc(analytics->players, *capacity * sizeof(PlayerAnalytics));
+    }
+    PlayerAnalytics *slot = &(analytics->players[analytics->num_players]);
+    memset(slot, 0, sizeof(PlayerAnalytics));
+    slot->name = name;
+    return analytics->num_players++;
+}
+
+void merge_analytics(Analytics *into, Analytics *from)
+{
+    into->num_frames += from->num_frames;
+    into->unfinished_frames += from->unfinished_frames;
+    into->num_shots += from->num_shots;
+    merge_frame_lengths(&(into->frame_lengths), &(from->frame_lengths));
+    for (int i = 0; i < into->num_players; i++)
+    {
+        PlayerAnalytics *a = &(into->players[i]);
+        PlayerAnalytics *b = &(from->players[i]);
+        a->num_frames += b->num_frames;
+        a->frames_won += b->frames_won;
+        a->num_shots += b->num_shots;
+        for (int j = 0; j < ANALYTICS_NUM_EVENT_TYPES; j++)
+        {
+            a->num_events[j] += b->num_events[j];
+        }
+        a->potting_shots += b->potting_shots;
+        a->pots += b->pots;
+        for (int j = 0; j < ANALYTICS_MAX_POCKETS; j++)
+        {
+            a->pocket_pots[j] += b->pocket_pots[j];
+        }
+        a->scratches += b->scratches;
+        a->accurate_first_contacts += b->accurate_first_contacts;
+        a->missed_contacts += b->missed_contacts;
+        merge_frame_lengths(&(a->won_frame_lengths), &(b->won_frame_lengths));
+    }
+}
+
+void clear_analytics(Analytics *analytics)
+{
+    for (int i = 0; i < analytics->num_players; i++)
+    {
+        free(analytics->players[i].name);
+        free(analytics->players[i].won_frame_lengths.counts);
+    }
+    free(analytics->players);
+    free(analytics->frame_lengths.counts);
+}
+
+Analytics *analyse_replays(char **paths, int num_paths, int num_threads)
+{
+    Analytics *analytics = malloc(sizeof(Analytics));
+    memset(analytics, 0, sizeof(Analytics));
+    int player_capacity = 4;
+    analytics->players = malloc(player_capacity * sizeof(PlayerAnalytics));
+
+    AnalyticsFile *files = malloc(num_paths * sizeof(AnalyticsFile));
+    int max_balls = 0;
+    for (int i = 0; i < num_paths; i++)
+    {
+        Replay *replay = open_replay(paths[i]);
+        if (replay == NULL)
+        {
+            continue;
+        }
+        AnalyticsFile *file = &(files[analytics->num_files++]);
+        file->replay = replay;
+        file->player_slots = malloc(replay->header->num_players * sizeof(int));
+        for (uint32_t j = 0; j < replay->header->num_players; j++)
+        {
+            file->player_slots[j] = analytics_player_slot(analytics, &player_capacity, replay, j);
+        }
+        file->cue_ball = -1;
+        for (uint32_t j = 0; j < replay->header->num_balls; j++)
+        {
+            ReplayBall *ball = replay_ball(replay, j);
+            if (ball != NULL && ball->id == 0)
+            {
+                file->cue_ball = j;
+                break;
+            }
+        }
+        if ((int)replay->header->num_balls > max_balls)
+        {
+            max_balls = replay->header->num_balls;
+        }
+        analytics->num_bytes += replay->size;
+    }
+    if (analytics->num_files == 0)
+    {
+        free(files);
+        free_analytics(analytics);
+        return NULL;
+    }
+
+    if (num_threads < 1)
+    {
+        num_threads = 1;
+    }
+    AnalyticsQueue queue;
+    queue.files = files;
+    queue.num_files = analytics->num_files;
+    queue.next_file = 0;
+    queue.next_frame = 0;
+    pthread_mutex_init(&(queue.lock), NULL);
+    AnalyticsWorker *workers = malloc(num_threads * sizeof(AnalyticsWorker));
+    pthread_t threads[num_threads];
+    for (int i = 0; i < num_threads; i++)
+    {
+        AnalyticsWorker *worker = &(workers[i]);
+        worker->queue = &queue;
+        memset(&(worker->totals), 0, sizeof(Analytics));
+        worker->totals.num_players = analytics->num_players;
+        worker->totals.players = calloc(analytics->num_players, sizeof(PlayerAnalytics));
+        worker->pocketed = malloc(max_balls * sizeof(bool));
+        pthread_create(&(threads[i]), NULL, run_analytics_worker, worker);
+    }
+    for (int i = 0; i < num_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+        AnalyticsWorker *worker = &(workers[i]);
+        merge_analytics(analytics, &(worker->totals));
+        free(worker->pocketed);
+        clear_analytics(&(worker->totals));
+    }
+    pthread_mutex_destroy(&(queue.lock));
+    free(workers);
+
+    for (int i = 0; i < analytics->num_files; i++)
+    {
+        close_replay(files[i].replay);
+        free(files[i].player_slots);
+    }
+    free(files);
+    return analytics;
+}
+
+void free_analytics(Analytics *analytics)
+{
+    clear_analytics(analytics);
+    free(analytics);
+}
+
+// The Wilson score interval, which stays inside 0 to 1 and behaves for
+// rates near either end.
+void wilson_interval(long successes, long trials, double *low, double *high)
+{
+    if (trials == 0)
+    {
+        *low = 0;
+        *high = 0;
+        return;
+    }
+    double z = 1.96;
+    double n = trials;
+    double p = successes / n;
+    double denominator = 1 + z * z / n;
+    double centre = (p + z * z / (2 * n)) / denominator;
+    double margin = z * sqrt(p * (1 - p) / n + z * z / (4 * n * n)) / denominator;
+    *low = centre - margin;
+    *high = centre + margin;
+}
+
+void print_rate(char *label, long successes, long trials)
+{
+    double low;
+    double high;
+    wilson_interval(successes, trials, &low, &high);
+    printf("  %-24s %8ld / %-8ld %6.2f%%  (95%% CI %.2f%% - %.2f%%)\n", label, successes, trials, trials == 0 ? 0 : 100.0 * successes / trials, 100 * low, 100 * high);
+}
+
+// The smallest frame length that at least fraction of the frames fit in.
+int frame_length_percentile(FrameLengths *lengths, long num_frames, double fraction)
+{
+    long cumulative = 0;
+    for (int i = 0; i < lengths->size; i++)
+    {
+        cumulative += lengths->counts[i];
+        if (cumulative > 0 && cumulative >= fraction * num_frames)
+        {
+            return i;
+        }
+    }
+    return lengths->size - 1;
+}
+
+void print_frame_lengths(FrameLengths *lengths, bool full)
+{
+    long n = 0;
+    double sum = 0;
+    double sum_squares = 0;
+    for (int i = 0; i < lengths->size; i++)
+    {
+        n += lengths->counts[i];
+        sum += (double)i * lengths->counts[i];
+        sum_squares += (double)i * i * lengths->counts[i];
+    }
+    if (n == 0)
+    {
+        printf("  No finished frames\n");
+        return;
+    }
+    double mean = sum / n;
+    double variance = n > 1 ? (sum_squares - n * mean * mean) / (n - 1) : 0;
+    double sd = sqrt(variance > 0 ? variance : 0);
+    double margin = 1.96 * sd / sqrt(n);
+    printf("  Mean %.2f shots (95%% CI %.2f - %.2f), sd %.2f\n", mean, mean - margin, mean + margin, sd);
+    printf("  Min %d, 10%% %d, median %d, 90%% %d, max %d\n", frame_length_percentile(lengths, n, 0), frame_length_percentile(lengths, n, 0.1), frame_length_percentile(lengths, n, 0.5), frame_length_percentile(lengths, n, 0.9), frame_length_percentile(lengths, n, 1));
+    if (!full)
+    {
+        return;
+    }
+    printf("  %6s %10s %8s %8s\n", "Shots", "Frames", "Share", "Within");
+    long cumulative = 0;
+    for (int i = 0; i < lengths->size; i++)
+    {
+        if (lengths->counts[i] == 0)
+        {
+            continue;
+        }
+        cumulative += lengths->counts[i];
+        printf("  %6d %10ld %7.2f%% %7.2f%%\n", i, lengths->counts[i], 100.0 * lengths->counts[i] / n, 100.0 * cumulative / n);
+    }
+}
+
+void print_player_analytics(PlayerAnalytics *player)
+{
+    char *event_names[ANALYTICS_NUM_EVENT_TYPES] = {"none", "ball-ball", "cushion", "pocketed", "roll", "stop"};
+    printf("\n%s\n", player->name);
+    print_rate("Frames won", player->frames_won, player->num_frames);
+    print_rate("Shots that pot", player->potting_shots, player->num_shots);
+    print_rate("Scratches", player->scratches, player->num_shots);
+    print_rate("Accurate first contact", player->accurate_first_contacts, player->num_shots);
+    print_rate("Missed every ball", player->missed_contacts, player->num_shots);
+    printf("  Pots: %ld, %.3f per shot\n", player->pots, player->num_shots == 0 ? 0 : (double)player->pots / player->num_shots);
+    for (int i = 0; i < ANALYTICS_MAX_POCKETS; i++)
+    {
+        if (player->pocket_pots[i] > 0)
+        {
+            char label[32];
+            sprintf(label, "Pots in pocket %d", i + 1);
+            print_rate(label, player->pocket_pots[i], player->pots);
+        }
+    }
+    printf("  Events per shot:");
+    for (int i = BALL_BALL_COLLISION; i < ANALYTICS_NUM_EVENT_TYPES; i++)
+    {
+        printf(" %s %.2f", event_names[i], player->num_shots == 0 ? 0 : (double)player->num_events[i] / player->num_shots);
+    }
+    printf("\n  Length of frames won:\n");
+    print_frame_lengths(&(player->won_frame_lengths), false);
+}
+
+void print_analytics(Analytics *analytics)
+{
+    printf("%d files, %ld frames (%ld unfinished), %ld shots\n", analytics->num_files, analytics->num_frames, analytics->unfinished_frames, analytics->num_shots);
+    printf("\nFrame length:\n");
+    print_frame_lengths(&(analytics->frame_lengths), true);
+    for (int i = 0; i < analytics->num_players; i++)
+    {
+        print_player_analytics(&(analytics->players[i]));
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef ANALYTICS_H
+#define ANALYTICS_H
+#include "serialise.h"
+
+#define ANALYTICS_MAX_POCKETS 8
+#define ANALYTICS_NUM_EVENT_TYPES (BALL_STOP + 1)
+#define ANALYTICS_CHUNK_FRAMES 64
+
+// Frame lengths are kept as a count for each number of shots, so the
+// distributions found by different threads merge by adding the counts.
+typedef struct
+{
+    long *counts;
+    int size;
+} FrameLengths;
+
+void add_frame_length(FrameLengths *lengths, int num_shots, long count);
+
+void merge_frame_lengths(FrameLengths *into, FrameLengths *from);
+
+// Totals for one player across every file, matched up by name. A pot is an
+// object ball going down, counted once however many times the simulation
+// reports it, and a scratch is a shot that pots the cue ball.
+// The first contact is accurate when the first ball the cue ball touches is
+// the lowest ball left on the table, as evaluate_shot has it.
+typedef struct
+{
+    char *name;
+    long num_frames;
+    long frames_won;
+    long num_shots;
+    long num_events[ANALYTICS_NUM_EVENT_TYPES];
+    long potting_shots;
+    long pots;
+    long pocket_pots[ANALYTICS_MAX_POCKETS];
+    long scratches;
+    long accurate_first_contacts;
+    long missed_contacts;
+    FrameLengths won_frame_lengths;
+} PlayerAnalytics;
+
+// Only frames with a winner count towards the frame lengths. The frame a
+// replay was written in the middle of is counted as unfinished.
+typedef struct
+{
+    int num_files;
+    size_t num_bytes;
+    PlayerAnalytics *players;
+    int num_players;
+    long num_frames;
+    long unfinished_frames;
+    long num_shots;
+    FrameLengths frame_lengths;
+} Analytics;
+
+// Scans the replays on num_threads threads. Threads take frames a chunk at
+// a time and keep their own totals, which are added up at the end, and only
+// the shot and event records are read, never the path segments. Returns
+// NULL if none of the files could be opened.
+Analytics *analyse_replays(char **paths, int num_paths, int num_threads);
+
+void print_analytics(Analytics *analytics);
+
+void free_analytics(Analytics *analytics);
+
+#endif // ANALYTICS_H
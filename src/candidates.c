@@ -0,0 +1,223 @@
+#include "candidates.h"
+#include "geometry.h"
+#include "pocketability.h"
+#include <stdlib.h>
+#include <math.h>
+
+CandidateList *create_candidate_list()
+{
+    CandidateList *list = malloc(sizeof(CandidateList));
+    list->capacity = 64;
+    list->candidates = malloc(list->capacity * sizeof(ShotCandidate));
+    list->num_candidates = 0;
+    return list;
+}
+
+void free_candidate_list(CandidateList *list)
+{
+    free(list->candidates);
+    free(list);
+}
+
+ShotCandidate *add_candidate(CandidateList *list, CandidateType type, int object_ball, int potted_ball, int pocket, int cushion)
+{
+    if (list->num_candidates == list->capacity)
+    {
+        list->capacity *= 2;
+        list->candidates = realloc(list->candidates, list->capacity * sizeof(ShotCandidate));
+    }
+    ShotCandidate *candidate = &(list->candidates[list->num_candidates++]);
+    candidate->type = type;
+    candidate->object_ball = object_ball;
+    candidate->potted_ball = potted_ball;
+    candidate->pocket = pocket;
+    candidate->cushion = cushion;
+    candidate->second_cut_cosine = 1;
+    candidate->blocked = false;
+    candidate->score = 0;
+    return candidate;
+}
+
+// Speed a ball needs to roll the given distance and stop.
+double stopping_speed(Coefficients c, double distance)
+{
+    double factor = ((double)12 / (49 * c.mu_slide * c.g)) + ((double)25 / (98 * c.mu_roll * c.g));
+    return sqrt(distance / factor);
+}
+
+// Speed a sliding ball needs to still be moving at final_speed after the
+// given distance.
+double sliding_speed(Coefficients c, double final_speed, double distance)
+{
+    return sqrt(final_speed * final_speed + 2 * c.g * c.mu_slide * distance);
+}
+
+void set_cue_ball_strike(ShotCandidate *candidate, Vector3 aim_line, double speed, double impact_speed, double radius)
+{
+    double spin = 5 * (speed - impact_speed) / (2 * radius);
+    candidate->v = Vector3Scale(Vector3Normalize(aim_line), speed);
+    candidate->w = Vector3Scale(Vector3Normalize(Vector3CrossProduct(aim_line, (Vector3){0, 0, 1})), spin);
+}
+
+void enumerate_candidates(Game *game, Ball *ball, CandidateList *list)
+{
+    Scene *scene = &(game->scene);
+    Coefficients c = scene->coefficients;
+    Ball *cue_ball = &(scene->ball_set.balls[0]);
+    Vector3 cue_ball_position = cue_ball->initial_position;
+    int object_ball = ball - scene->ball_set.balls;
+    int num_pockets = scene->table.num_pockets;
+    int num_cushions = scene->table.num_cushions;
+    list->num_candidates = 0;
+
+    // Direct and bank shots come straight from the pocketability cache. Kicks
+    // and combos need lines the cache does not hold, which are collected here
+    // and tested together in one batch at the end.
+    int max_corridors = 2 * num_pockets * num_cushions + 2 * scene->ball_set.num_balls * num_pockets;
+    Corridor *corridors = malloc(max_corridors * sizeof(Corridor));
+    int *corridor_candidates = malloc(max_corridors * sizeof(int));
+    int num_corridors = 0;
+
+    for (int i = 0; i < num_pockets; i++)
+    {
+        Vector3 pocket = scene->table.pockets[i].position;
+        PocketLine *line = get_pocket_line(game, ball, i);
+        if (line->cut_cosine <= 0)
+        {
+            continue;
+        }
+        Vector3 aim_line = Vector3Subtract(line->aim_point, cue_ball_position);
+        Vector3 shot_line = Vector3Subtract(pocket, ball->initial_position);
+        ShotCandidate *candidate = add_candidate(list, DIRECT_SHOT, object_ball, object_ball, i, -1);
+        candidate->aim_point = line->aim_point;
+        candidate->cut_cosine = line->cut_cosine;
+        candidate->distance = Vector3Length(aim_line) + Vector3Length(shot_line);
+        candidate->blocked = !line->object_ball_path_open || !line->cue_ball_path_open;
+        double impact_speed = stopping_speed(c, Vector3Length(shot_line)) / line->cut_cosine;
+        double speed = sliding_speed(c, impact_speed, Vector3Length(aim_line));
+        set_cue_ball_strike(candidate, aim_line, speed, impact_speed, cue_ball->radius);
+    }
+
+    for (int i = 0; i < scene->ball_set.num_balls; i++)
+    {
+        Ball *target_ball = &(scene->ball_set.balls[i]);
+        if (i == 0 || i == object_ball || target_ball->pocketed)
+        {
+            continue;
+        }
+        for (int j = 0; j < num_pockets; j++)
+        {
+            PocketLine *line = get_pocket_line(game, target_ball, j);
+            Vector3 pocket = scene->table.pockets[j].position;
+            Vector3 shot_line1 = Vector3Subtract(line->aim_point, ball->initial_position);
+            Vector3 shot_line2 = Vector3Subtract(pocket, target_ball->initial_position);
+            Vector3 aim_point = ghost_ball_position(ball->initial_position, line->aim_point, ball->radius);
+            Vector3 aim_line = Vector3Subtract(aim_point, cue_ball_position);
+            double first_cut_cosine = cut_cosine(cue_ball_position, aim_point, ball->initial_position, line->aim_point);
+            double second_cut_cosine = cut_cosine(ball->initial_position, line->aim_point, target_ball->initial_position, pocket);
+            if (first_cut_cosine <= 0 || second_cut_cosine <= 0)
+            {
+                continue;
+            }
+            ShotCandidate *candidate = add_candidate(list, COMBO_SHOT, object_ball, i, j, -1);
+            candidate->aim_point = aim_point;
+            candidate->cut_cosine = first_cut_cosine;
+            candidate->second_cut_cosine = second_cut_cosine;
+            candidate->distance = Vector3Length(aim_line) + Vector3Length(shot_line1) + Vector3Length(shot_line2);
+            candidate->blocked = !line->object_ball_path_open;
+            double target_impact_speed = stopping_speed(c, Vector3Length(shot_line2)) / candidate->second_cut_cosine;
+            double object_speed = sliding_speed(c, target_impact_speed, Vector3Length(shot_line1));
+            double impact_speed = object_speed / candidate->cut_cosine;
+            double speed = sliding_speed(c, impact_speed, Vector3Length(aim_line));
+            set_cue_ball_strike(candidate, aim_line, speed, impact_speed, cue_ball->radius);
+            corridors[num_corridors] = ball_corridor(cue_ball_position, aim_point, cue_ball);
+            corridor_candidates[num_corridors++] = list->num_candidates - 1;
+            corridors[num_corridors] = ball_corridor(ball->initial_position, line->aim_point, ball);
+            corridor_candidates[num_corridors++] = list->num_candidates - 1;
+        }
+    }
+
+    for (int i = 0; i < num_pockets; i++)
+    {
+        for (int j = 0; j < num_cushions; j++)
+        {
+            BankLine *bank = get_bank_line(game, ball, i, j);
+            if (!bank->exists || bank->cut_cosine <= 0)
+            {
+                continue;
+            }
+            Vector3 aim_line = Vector3Subtract(bank->aim_point, cue_ball_position);
+            Vector3 shot_line = Vector3Subtract(bank->pocket_image, ball->initial_position);
+            ShotCandidate *candidate = add_candidate(list, BANK_SHOT, object_ball, object_ball, i, j);
+            candidate->aim_point = bank->aim_point;
+            candidate->cut_cosine = bank->cut_cosine;
+            candidate->distance = Vector3Length(aim_line) + Vector3Length(shot_line);
+            candidate->blocked = !bank->object_ball_path_open || !bank->cue_ball_path_open;
+            double impact_speed = stopping_speed(c, Vector3Length(shot_line)) / bank->cut_cosine;
+            double speed = sliding_speed(c, impact_speed, Vector3Length(aim_line));
+            set_cue_ball_strike(candidate, aim_line, speed, impact_speed, cue_ball->radius);
+        }
+    }
+
+    for (int i = 0; i < num_pockets; i++)
+    {
+        Vector3 pocket = scene->table.pockets[i].position;
+        PocketLine *line = get_pocket_line(game, ball, i);
+        Vector3 shot_line = Vector3Subtract(pocket, ball->initial_position);
+        for (int j = 0; j < num_cushions; j++)
+        {
+            Cushion cushion = scene->table.cushions[j];
+            Vector3 aim_point_image = reflect_in_cushion(line->aim_point, cushion);
+            if (line->aim_point.x == aim_point_image.x && line->aim_point.y == aim_point_image.y)
+            {
+                continue;
+            }
+            Vector3 collision_point = cushion_contact_point(cue_ball_position, aim_point_image, cushion);
+            Vector3 aim_line1 = Vector3Subtract(collision_point, cue_ball_position);
+            Vector3 aim_line2 = Vector3Subtract(line->aim_point, collision_point);
+            double kick_cut_cosine = cut_cosine(collision_point, line->aim_point, ball->initial_position, pocket);
+            if (kick_cut_cosine <= 0)
+            {
+                continue;
+            }
+            ShotCandidate *candidate = add_candidate(list, KICK_SHOT, object_ball, object_ball, i, j);
+            candidate->aim_point = line->aim_point;
+            candidate->cut_cosine = kick_cut_cosine;
+            candidate->distance = Vector3Length(aim_line1) + Vector3Length(aim_line2) + Vector3Length(shot_line);
+            candidate->blocked = !line->object_ball_path_open;
+            double impact_speed = stopping_speed(c, Vector3Length(shot_line)) / candidate->cut_cosine;
+            double cushion_speed = sliding_speed(c, impact_speed, Vector3Length(aim_line2));
+            double speed = sliding_speed(c, cushion_speed, Vector3Length(aim_line1));
+            set_cue_ball_strike(candidate, aim_line1, speed, cushion_speed, cue_ball->radius);
+            corridors[num_corridors] = ball_corridor(cue_ball_position, collision_point, cue_ball);
+            corridor_candidates[num_corridors++] = list->num_candidates - 1;
+            corridors[num_corridors] = ball_corridor(collision_point, line->aim_point, cue_ball);
+            corridor_candidates[num_corridors++] = list->num_candidates - 1;
+        }
+    }
+
+    bool *blocked = malloc(num_corridors * sizeof(bool));
+    corridors_blocked(game, corridors, num_corridors, blocked);
+    for (int i = 0; i < num_corridors; i++)
+    {
+        if (blocked[i])
+        {
+            list->candidates[corridor_candidates[i]].blocked = true;
+        }
+    }
+    free(blocked);
+    free(corridors);
+    free(corridor_candidates);
+}
+
+int compare_candidates(const void *a, const void *b)
+{
+    double score_a = ((ShotCandidate *)a)->score;
+    double score_b = ((ShotCandidate *)b)->score;
+    return (score_a < score_b) - (score_a > score_b);
+}
+
+void sort_candidates(CandidateList *list)
+{
+    qsort(list->candidates, list->num_candidates, sizeof(ShotCandidate), compare_candidates);
+}
@@ -0,0 +1,51 @@
+#ifndef CANDIDATES_H
+#define CANDIDATES_H
+#include "game.h"
+
+typedef enum
+{
+    DIRECT_SHOT,
+    BANK_SHOT,
+    KICK_SHOT,
+    COMBO_SHOT
+} CandidateType;
+
+// One geometric way of potting a ball. Indices refer to the scene's ball and
+// table arrays; cushion is -1 for shots that do not use one. v and w are the
+// analytic estimate of the cue ball velocity and spin needed to send the
+// potted ball just into the pocket.
+typedef struct
+{
+    CandidateType type;
+    int object_ball;
+    int potted_ball;
+    int pocket;
+    int cushion;
+    Vector3 aim_point;
+    Vector3 v;
+    Vector3 w;
+    double cut_cosine;
+    double second_cut_cosine;
+    double distance;
+    bool blocked;
+    double score;
+} ShotCandidate;
+
+typedef struct
+{
+    ShotCandidate *candidates;
+    int num_candidates;
+    int capacity;
+} CandidateList;
+
+CandidateList *create_candidate_list();
+
+void free_candidate_list(CandidateList *list);
+
+// Lists every way of potting ball. Cuts of 90 degrees or more cannot send a
+// ball anywhere near its pocket, so they are left out.
+void enumerate_candidates(Game *game, Ball *ball, CandidateList *list);
+
+void sort_candidates(CandidateList *list);
+
+#endif // CANDIDATES_H
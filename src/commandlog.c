@@ -0,0 +1,377 @@
+#include "commandlog.h"
+#include "fork.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+uint32_t hash_bytes(uint32_t hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+uint32_t shot_outcome_hash(Shot *shot, int num_balls)
+{
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < shot->num_events; i++)
+    {
+        ShotEvent *event = &(shot->events[i]);
+        hash = hash_bytes(hash, &(event->time), sizeof(double));
+        hash = hash_bytes(hash, &(event->type), sizeof(uint8_t));
+        hash = hash_bytes(hash, &(event->ball1), sizeof(int16_t));
+        hash = hash_bytes(hash, &(event->ball2), sizeof(int16_t));
+        hash = hash_bytes(hash, &(event->cushion_or_pocket), sizeof(int16_t));
+    }
+    for (int i = 0; i < num_balls; i++)
+    {
+        Path *path = &(shot->ball_paths[i]);
+        if (path->num_segments > 0)
+        {
+            hash = hash_bytes(hash, &(path->segments[path->num_segments - 1].initial_position), sizeof(Vec2));
+        }
+    }
+    return hash;
+}
+
+int command_log_player(Game *game, Player *player)
+{
+    return player == NULL ? -1 : (int)(player - game->players);
+}
+
+bool save_command_log(Game *game, char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return false;
+    }
+    int num_balls = game->scene.ball_set.num_balls;
+    CommandLogHeader header;
+    memset(&header, 0, sizeof(CommandLogHeader));
+    memcpy(header.magic, COMMAND_LOG_MAGIC, sizeof(COMMAND_LOG_MAGIC));
+    header.version = COMMAND_LOG_VERSION;
+    header.seed = game->seed;
+    header.num_players = game->num_players;
+    header.num_balls = num_balls;
+    header.num_frames = game->num_frames;
+    for (int i = 0; i < game->num_frames; i++)
+    {
+        header.num_shots += game->frames[i].num_shots;
+    }
+    header.coefficients = game->scene.coefficients;
+    bool written = fwrite(&header, sizeof(CommandLogHeader), 1, file) == 1;
+    size_t text_size = 0;
+    for (int i = 0; i < game->num_players; i++)
+    {
+        char *text[2] = {game->players[i].module.name, game->players[i].module.description};
+        for (int j = 0; j < 2; j++)
+        {
+            uint32_t length = strlen(text[j]);
+            written = written && fwrite(&length, sizeof(uint32_t), 1, file) == 1 && fwrite(text[j], 1, length, file) == length;
+            text_size += sizeof(uint32_t) + length;
+        }
+    }
+    // Keep the frame records aligned.
+    char zeros[4] = {0};
+    size_t padding = (4 - text_size % 4) % 4;
+    written = written && fwrite(zeros, 1, padding, file) == padding;
+
+    Vector2 rack[num_balls];
+    CommandLogShot *shots = malloc(10 * sizeof(CommandLogShot));
+    int shot_capacity = 10;
+    for (int i = 0; i < game->num_frames && written; i++)
+    {
+        Frame *frame = &(game->frames[i]);
+        CommandLogFrame record = {frame->num_shots, command_log_player(game, frame->winner)};
+        for (int j = 0; j < num_balls; j++)
+        {
+            // A frame that has no shots yet is the one being played.
+            Vector3 position = frame->num_shots > 0 ? Vec2ToVector3(frame->shot_history[0].ball_paths[j].segments[0].initial_position) : game->scene.ball_set.balls[j].initial_position;
+            rack[j] = (Vector2){position.x, position.y};
+        }
+        if (frame->num_shots > shot_capacity)
+        {
+            shot_capacity = frame->num_shots;
+            shots = realloc(shots, shot_capacity * sizeof(CommandLogShot));
+        }
+        for (int j = 0; j < frame->num_shots; j++)
+        {
+            Shot *shot = &(frame->shot_history[j]);
+            shots[j] = (CommandLogShot){command_log_player(game, shot->player), shot_outcome_hash(shot, num_balls), shot->v, shot->w};
+        }
+        written = fwrite(&record, sizeof(CommandLogFrame), 1, file) == 1 && fwrite(rack, sizeof(Vector2), num_balls, file) == (size_t)num_balls && fwrite(shots, sizeof(CommandLogShot), frame->num_shots, file) == (size_t)frame->num_shots;
+    }
+    free(shots);
+    if (fclose(file) != 0 || !written)
+    {
+        fprintf(stderr, "Failed to write %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+typedef struct
+{
+    Game *game;
+    char **frame_records;
+    GameFork *fork;
+    Ball *balls;
+    int first;
+    int stride;
+    int num_divergent;
+    int *first_divergent_shot;
+} CommandLogWorker;
+
+void copy_shot_paths(Shot *shot, Game *source)
+{
+    int num_balls = source->scene.ball_set.num_balls;
+    shot->num_events = source->current_shot.num_events;
+    shot->event_capacity = shot->num_events > 0 ? shot->num_events : 1;
+    shot->events = malloc(shot->event_capacity * sizeof(ShotEvent));
+    memcpy(shot->events, source->current_shot.events, shot->num_events * sizeof(ShotEvent));
+    shot->ball_paths = malloc(num_balls * sizeof(Path));
+    for (int i = 0; i < num_balls; i++)
+    {
+        Path path = source->scene.ball_set.balls[i].path;
+        shot->ball_paths[i].num_segments = path.num_segments;
+        shot->ball_paths[i].capacity = path.num_segments;
+        shot->ball_paths[i].segments = malloc(path.num_segments * sizeof(PathSegment));
+        memcpy(shot->ball_paths[i].segments, path.segments, path.num_segments * sizeof(PathSegment));
+    }
+    shot->end_time = source->current_shot.end_time;
+}
+
+void replay_command_log_frame(CommandLogWorker *worker, int index)
+{
+    Game *game = worker->game;
+    int num_balls = game->scene.ball_set.num_balls;
+    CommandLogFrame *record = (CommandLogFrame *)worker->frame_records[index];
+    Vector2 *rack = (Vector2 *)(record + 1);
+    CommandLogShot *shots = (CommandLogShot *)(rack + num_balls);
+
+    Frame *frame = &(game->frames[index]);
+    frame->num_shots = record->num_shots;
+    frame->shot_capacity = record->num_shots > 0 ? record->num_shots : 1;
+    frame->shot_history = malloc(frame->shot_capacity * sizeof(Shot));
+    frame->winner = record->winner >= 0 && record->winner < game->num_players ? &(game->players[record->winner]) : NULL;
+
+    Scene scene = game->scene;
+    scene.ball_set.balls = worker->balls;
+    for (int i = 0; i < num_balls; i++)
+    {
+        worker->balls[i].initial_position = (Vector3){rack[i].x, rack[i].y, 0};
+        worker->balls[i].initial_orientation = game->scene.ball_set.balls[i].initial_orientation;
+    }
+    for (int i = 0; i < frame->num_shots; i++)
+    {
+        fork_scene(worker->fork, &scene);
+        simulate_fork(worker->fork, shots[i].v, shots[i].w);
+        Game *fork_game = &(worker->fork->game);
+        add_orientation_to_path(fork_game);
+
+        Shot *shot = &(frame->shot_history[i]);
+        copy_shot_paths(shot, fork_game);
+        shot->player = shots[i].player >= 0 && shots[i].player < game->num_players ? &(game->players[shots[i].player]) : NULL;
+        shot->v = shots[i].v;
+        shot->w = shots[i].w;
+        if (shot_outcome_hash(shot, num_balls) != shots[i].outcome_hash)
+        {
+            if (worker->first_divergent_shot[index] == 0)
+            {
+                worker->first_divergent_shot[index] = i + 1;
+            }
+            worker->num_divergent++;
+        }
+
+        // The next shot starts where the game left the balls.
+        for (int j = 0; j < num_balls; j++)
+        {
+            Ball *ball = &(fork_game->scene.ball_set.balls[j]);
+            worker->balls[j].initial_position = get_ball_position(*ball, shot->end_time);
+            worker->balls[j].initial_orientation = get_ball_orientation(*ball, shot->end_time);
+        }
+        release_game_fork(worker->fork);
+    }
+}
+
+void *run_command_log_worker(void *arg)
+{
+    CommandLogWorker *worker = arg;
+    for (int i = worker->first; i < worker->game->num_frames; i += worker->stride)
+    {
+        replay_command_log_frame(worker, i);
+    }
+    return NULL;
+}
+
+char *read_command_log(char *path, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to open command log %s\n", path);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *data = malloc(length > 0 ? length : 1);
+    if (length < 0 || fread(data, 1, length, file) != (size_t)length)
+    {
+        fprintf(stderr, "Failed to read command log %s\n", path);
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    *size = length;
+    return data;
+}
+
+Game *load_command_log(char *path, int num_threads, int *num_divergent)
+{
+    size_t size;
+    char *data = read_command_log(path, &size);
+    if (data == NULL)
+    {
+        return NULL;
+    }
+    CommandLogHeader *header = (CommandLogHeader *)data;
+    Scene scene = create_scene();
+    if (size < sizeof(CommandLogHeader) || memcmp(header->magic, COMMAND_LOG_MAGIC, sizeof(COMMAND_LOG_MAGIC)) != 0 || header->version != COMMAND_LOG_VERSION || (int)header->num_balls != scene.ball_set.num_balls)
+    {
+        fprintf(stderr, "%s is not a version %d command log for this table\n", path, COMMAND_LOG_VERSION);
+        free_ball_set(&(scene.ball_set));
+        free(data);
+        return NULL;
+    }
+    free_ball_set(&(scene.ball_set));
+
+    // Every player takes at least two lengths and every frame at least its
+    // record and rack, so larger counts cannot be right.
+    size_t body_size = size - sizeof(CommandLogHeader);
+    size_t min_frame_size = sizeof(CommandLogFrame) + header->num_balls * sizeof(Vector2);
+    if (header->num_players < 1 || header->num_players > body_size / (2 * sizeof(uint32_t)) || header->num_frames > body_size / min_frame_size)
+    {
+        fprintf(stderr, "Command log %s claims %u players and %u frames, more than the file holds\n", path, header->num_players, header->num_frames);
+        free(data);
+        return NULL;
+    }
+
+    // Find the players and the start of every frame before replaying any.
+    char *cursor = data + sizeof(CommandLogHeader);
+    char *end = data + size;
+    Player *players = malloc(header->num_players * sizeof(Player));
+    bool valid = true;
+    for (uint32_t i = 0; i < header->num_players; i++)
+    {
+        char *text[2] = {NULL, NULL};
+        for (int j = 0; j < 2; j++)
+        {
+            uint32_t length;
+            valid = valid && end - cursor >= (long)sizeof(uint32_t);
+            if (!valid)
+            {
+                break;
+            }
+            memcpy(&length, cursor, sizeof(uint32_t));
+            cursor += sizeof(uint32_t);
+            valid = end - cursor >= (long)length;
+            text[j] = valid ? strndup(cursor, length) : NULL;
+            cursor += valid ? length : 0;
+        }
+        players[i].type = AI;
+        players[i].module.name = text[0];
+        players[i].module.description = text[1];
+        players[i].module.pot_ball = NULL;
+        players[i].module.handle = NULL;
+        players[i].module.library_path = NULL;
+    }
+    cursor += (4 - (cursor - data) % 4) % 4;
+    char **frame_records = malloc((header->num_frames + 1) * sizeof(char *));
+    uint64_t num_shots = 0;
+    for (uint32_t i = 0; i < header->num_frames && valid; i++)
+    {
+        frame_records[i] = cursor;
+        CommandLogFrame record;
+        valid = end - cursor >= (long)sizeof(CommandLogFrame);
+        if (valid)
+        {
+            memcpy(&record, cursor, sizeof(CommandLogFrame));
+            size_t frame_size = min_frame_size + (size_t)record.num_shots * sizeof(CommandLogShot);
+            valid = (size_t)(end - cursor) >= frame_size;
+            cursor += valid ? frame_size : 0;
+            num_shots += record.num_shots;
+        }
+    }
+    if (!valid || num_shots != header->num_shots)
+    {
+        fprintf(stderr, "Command log %s is truncated\n", path);
+        for (uint32_t i = 0; i < header->num_players; i++)
+        {
+            free(players[i].module.name);
+            free(players[i].module.description);
+        }
+        free(players);
+        free(frame_records);
+        free(data);
+        return NULL;
+    }
+
+    Game *game = create_game(players, header->num_players);
+    free(players);
+    game->seed = header->seed;
+    game->scene.coefficients = header->coefficients;
+    free(game->frames[0].shot_history);
+    game->frame_capacity = header->num_frames > 0 ? header->num_frames : 1;
+    game->frames = realloc(game->frames, game->frame_capacity * sizeof(Frame));
+    game->num_frames = header->num_frames;
+
+    if (num_threads < 1)
+    {
+        num_threads = 1;
+    }
+    int *first_divergent_shot = calloc(game->frame_capacity, sizeof(int));
+    CommandLogWorker *workers = malloc(num_threads * sizeof(CommandLogWorker));
+    pthread_t threads[num_threads];
+    for (int i = 0; i < num_threads; i++)
+    {
+        CommandLogWorker *worker = &(workers[i]);
+        worker->game = game;
+        worker->frame_records = frame_records;
+        worker->fork = create_game_fork(header->num_balls);
+        worker->balls = malloc(header->num_balls * sizeof(Ball));
+        memcpy(worker->balls, game->scene.ball_set.balls, header->num_balls * sizeof(Ball));
+        worker->first = i;
+        worker->stride = num_threads;
+        worker->num_divergent = 0;
+        worker->first_divergent_shot = first_divergent_shot;
+        pthread_create(&(threads[i]), NULL, run_command_log_worker, worker);
+    }
+    *num_divergent = 0;
+    for (int i = 0; i < num_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+        *num_divergent += workers[i].num_divergent;
+        free_game_fork(workers[i].fork);
+        free(workers[i].balls);
+    }
+    for (int i = 0; i < game->num_frames; i++)
+    {
+        if (first_divergent_shot[i] != 0)
+        {
+            fprintf(stderr, "Frame %d diverges from the command log at shot %d\n", i + 1, first_divergent_shot[i]);
+        }
+    }
+    free(first_divergent_shot);
+    free(workers);
+    free(frame_records);
+    free(data);
+    return game;
+}
@@ -0,0 +1,54 @@
+#ifndef COMMANDLOG_H
+#define COMMANDLOG_H
+#include "game.h"
+#include <stdint.h>
+
+#define COMMAND_LOG_MAGIC "POOLCMD"
+#define COMMAND_LOG_VERSION 1
+
+// A command log stores only what the engine needs to replay a game: each
+// frame's rack and the strike of every shot. Paths are rebuilt on load by
+// simulating the shots again. Each shot also carries a hash of the events
+// and rest positions it produced when it was saved, so a load with a
+// different engine reports where the two diverge.
+//
+// The file is a CommandLogHeader, then for each player the name and the
+// description as a length and the characters, then for each frame a
+// CommandLogFrame, the rack as one Vector2 per ball and the frame's shots.
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t seed;
+    uint32_t num_players;
+    uint32_t num_balls;
+    uint32_t num_frames;
+    uint32_t num_shots;
+    Coefficients coefficients;
+} CommandLogHeader;
+
+typedef struct
+{
+    uint32_t num_shots;
+    int32_t winner;
+} CommandLogFrame;
+
+typedef struct
+{
+    int32_t player;
+    uint32_t outcome_hash;
+    Vector3 v;
+    Vector3 w;
+} CommandLogShot;
+
+uint32_t shot_outcome_hash(Shot *shot, int num_balls);
+
+bool save_command_log(Game *game, char *path);
+
+// Rebuilds the game on num_threads threads, one frame at a time. The players
+// are named after the ones in the file but have no modules loaded. Shots
+// whose outcome no longer matches the file are counted in num_divergent, and
+// every frame containing one is reported with the first shot that differs.
+Game *load_command_log(char *path, int num_threads, int *num_divergent);
+
+#endif // COMMANDLOG_H
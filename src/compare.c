@@ -4,13 +4,292 @@
 #include <dlfcn.h>
 #include <time.h>
 #include "serialise.h"
+#include "commandlog.h"
+#include "trajectory.h"
+#include "shotcache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define CHECKPOINT_PATH "compare.ckpt"
+#define CHECKPOINT_MAGIC "POOLCKP"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_INTERVAL 50
+#define REPLAY_PATH "frames.bin"
+
+// A checkpoint is taken as a frame starts, once the writer thread has put
+// every finished frame in the replay. Play from there depends only on the
+// seed, the frame number, the rack, the turn and the orientations the balls
+// were left in, so besides those the checkpoint keeps each finished frame's
+// result and where the replay ends. The header is followed by each
+// player's library path as a length and the characters, a CheckpointBall
+// per ball and a CheckpointFrame per finished frame. The shots are read
+// back from the replay, which carries on from the recorded offset.
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t seed;
+    uint32_t num_players;
+    uint32_t num_balls;
+    uint32_t num_frames;
+    int32_t current_player;
+    int32_t consecutive_fouls;
+    uint32_t reserved;
+    uint64_t replay_offset;
+    Vector3 v;
+    Vector3 w;
+} CheckpointHeader;
+
+typedef struct
+{
+    Vector3 position;
+    Quaternion orientation;
+} CheckpointBall;
+
+typedef struct
+{
+    uint32_t num_shots;
+    int32_t winner;
+} CheckpointFrame;
+
+int checkpoint_player_index(Game *game, Player *player)
+{
+    return player == NULL ? -1 : (int)(player - game->players);
+}
+
+void save_checkpoint(Game *game, ReplayWriter *replay)
+{
+    int num_frames = game->num_frames - 1;
+    if (replay == NULL || (int)replay->header.num_frames != num_frames || !sync_replay_writer(replay))
+    {
+        return;
+    }
+    FILE *file = fopen(CHECKPOINT_PATH ".tmp", "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to open %s for writing\n", CHECKPOINT_PATH ".tmp");
+        return;
+    }
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(CheckpointHeader));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    header.version = CHECKPOINT_VERSION;
+    header.seed = game->seed;
+    header.num_players = game->num_players;
+    header.num_balls = game->scene.ball_set.num_balls;
+    header.num_frames = num_frames;
+    header.current_player = game->current_player;
+    header.consecutive_fouls = game->consecutive_fouls;
+    header.replay_offset = replay->offset;
+    header.v = game->v;
+    header.w = game->w;
+    bool written = fwrite(&header, sizeof(CheckpointHeader), 1, file) == 1;
+    for (int i = 0; i < game->num_players; i++)
+    {
+        char *library_path = game->players[i].module.library_path;
+        uint32_t length = strlen(library_path);
+        written = written && fwrite(&length, sizeof(uint32_t), 1, file) == 1 && fwrite(library_path, 1, length, file) == length;
+    }
+    for (int i = 0; i < game->scene.ball_set.num_balls; i++)
+    {
+        Ball *ball = &(game->scene.ball_set.balls[i]);
+        CheckpointBall record = {ball->initial_position, ball->initial_orientation};
+        written = written && fwrite(&record, sizeof(CheckpointBall), 1, file) == 1;
+    }
+    for (int i = 0; i < num_frames; i++)
+    {
+        CheckpointFrame record = {game->frames[i].num_shots, checkpoint_player_index(game, game->frames[i].winner)};
+        written = written && fwrite(&record, sizeof(CheckpointFrame), 1, file) == 1;
+    }
+    if (fclose(file) != 0 || !written)
+    {
+        fprintf(stderr, "Failed to write %s\n", CHECKPOINT_PATH ".tmp");
+        return;
+    }
+    rename(CHECKPOINT_PATH ".tmp", CHECKPOINT_PATH);
+}
+
+bool read_checkpoint(FILE *file, Player *players, int num_players, CheckpointHeader *header, CheckpointBall **balls, CheckpointFrame **frames)
+{
+    if (fread(header, sizeof(CheckpointHeader), 1, file) != 1 || memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0 || header->version != CHECKPOINT_VERSION || header->num_players != (uint32_t)num_players || header->seed == 0 || header->num_frames == 0 || header->current_player < 0 || header->current_player >= num_players)
+    {
+        return false;
+    }
+    for (int i = 0; i < num_players; i++)
+    {
+        char *library_path = players[i].module.library_path;
+        uint32_t length;
+        if (fread(&length, sizeof(uint32_t), 1, file) != 1 || length != strlen(library_path))
+        {
+            return false;
+        }
+        char text[length];
+        if (fread(text, 1, length, file) != length || memcmp(text, library_path, length) != 0)
+        {
+            return false;
+        }
+    }
+    struct stat st;
+    long position = ftell(file);
+    if (fstat(fileno(file), &st) != 0 || position < 0 || (uint64_t)(st.st_size - position) != header->num_balls * (uint64_t)sizeof(CheckpointBall) + header->num_frames * (uint64_t)sizeof(CheckpointFrame))
+    {
+        return false;
+    }
+    *balls = malloc((header->num_balls + 1) * sizeof(CheckpointBall));
+    *frames = malloc(header->num_frames * sizeof(CheckpointFrame));
+    return fread(*balls, sizeof(CheckpointBall), header->num_balls, file) == header->num_balls && fread(*frames, sizeof(CheckpointFrame), header->num_frames, file) == header->num_frames;
+}
+
+bool replay_matches_checkpoint(Replay *replay, CheckpointHeader *header, CheckpointFrame *frames)
+{
+    if (replay->num_frames < header->num_frames)
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < header->num_frames; i++)
+    {
+        ReplayFrame *frame = replay_frame(replay, i);
+        if (frame == NULL || frame->num_shots != frames[i].num_shots || frame->winner != frames[i].winner)
+        {
+            return false;
+        }
+    }
+    ReplayFrame *last = replay_frame(replay, header->num_frames - 1);
+    return replay->frame_offsets[header->num_frames - 1] + last->size == header->replay_offset;
+}
+
+// The replay must end where the checkpoint says and agree with it about
+// every finished frame. Those frames are read back into the game and
+// *replay_writer is left writing after the last of them.
+Game *load_checkpoint(Player *players, int num_players, ReplayWriter **replay_writer)
+{
+    FILE *file = fopen(CHECKPOINT_PATH, "rb");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    CheckpointHeader header;
+    CheckpointBall *balls = NULL;
+    CheckpointFrame *frames = NULL;
+    bool same_match = read_checkpoint(file, players, num_players, &header, &balls, &frames);
+    fclose(file);
+    Replay *replay = same_match ? open_replay(REPLAY_PATH) : NULL;
+    if (replay == NULL || !replay_matches_checkpoint(replay, &header, frames))
+    {
+        fprintf(stderr, "%s is from a different match, starting again\n", CHECKPOINT_PATH);
+        if (replay != NULL)
+        {
+            close_replay(replay);
+        }
+        free(balls);
+        free(frames);
+        return NULL;
+    }
+
+    Game *game = create_game(players, num_players);
+    int num_frames = header.num_frames;
+    Frame current_frame = game->frames[0];
+    while (game->frame_capacity <= num_frames)
+    {
+        game->frame_capacity *= 2;
+    }
+    game->frames = realloc(game->frames, game->frame_capacity * sizeof(Frame));
+    bool resumed = header.num_balls == (uint32_t)game->scene.ball_set.num_balls;
+    for (int i = 0; resumed && i < num_frames; i++)
+    {
+        resumed = read_replay_frame(replay, i, game, &(game->frames[i]));
+    }
+    *replay_writer = resumed ? append_replay_writer(REPLAY_PATH, game, replay, num_frames) : NULL;
+    close_replay(replay);
+    free(frames);
+    if (*replay_writer == NULL)
+    {
+        fprintf(stderr, "Could not carry on from %s, starting again\n", REPLAY_PATH);
+        free(balls);
+        return NULL;
+    }
+    game->frames[num_frames] = current_frame;
+    game->num_frames = num_frames + 1;
+    game->seed = header.seed;
+    game->current_player = header.current_player;
+    game->consecutive_fouls = header.consecutive_fouls;
+    game->v = header.v;
+    game->w = header.w;
+    game->playback_speed = 1000;
+    game->default_playback_speed = 1000;
+    for (int i = 0; i < game->scene.ball_set.num_balls; i++)
+    {
+        game->scene.ball_set.balls[i].initial_position = balls[i].position;
+        game->scene.ball_set.balls[i].initial_orientation = balls[i].orientation;
+    }
+    free(balls);
+    refresh_table_state(game);
+    seed_frame_random(game);
+    printf("Resuming from frame %d\n", game->num_frames);
+    return game;
+}
+
+// Replays a command log with the current engine and reports the frames
+// whose shots no longer come out as they were recorded.
+int verify_command_log(char *path, int num_threads)
+{
+    int num_divergent;
+    Game *game = load_command_log(path, num_threads, &num_divergent);
+    if (game == NULL)
+    {
+        return 1;
+    }
+    int num_shots = 0;
+    for (int i = 0; i < game->num_frames; i++)
+    {
+        num_shots += game->frames[i].num_shots;
+    }
+    printf("%s: %d of %d shots in %d frames replay differently\n", path, num_divergent, num_shots, game->num_frames);
+    return num_divergent > 0 ? 2 : 0;
+}
 
 int main(int argc, char *argv[])
 {
+    if (argc >= 2 && strcmp(argv[1], "--verify") == 0)
+    {
+        int num_threads = argc > 3 ? atoi(argv[3]) : sysconf(_SC_NPROCESSORS_ONLN);
+        if (num_threads <= 0)
+        {
+            num_threads = 1;
+        }
+        return verify_command_log(argc > 2 ? argv[2] : "frames.cmd", num_threads);
+    }
 
-    if (argc < 3)
+    char *commands_path = NULL;
+    char *trajectories_path = NULL;
+    char *arguments[3];
+    int num_arguments = 0;
+    bool bad_usage = false;
+    for (int i = 1; i < argc; i++)
     {
-        printf("Usage: %s <player1.so> <player2.so> \n", argv[0]);
+        if (strcmp(argv[i], "--commands") == 0 && i + 1 < argc)
+        {
+            commands_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--trajectories") == 0 && i + 1 < argc)
+        {
+            trajectories_path = argv[++i];
+        }
+        else if (argv[i][0] == '-' || num_arguments == 3)
+        {
+            bad_usage = true;
+        }
+        else
+        {
+            arguments[num_arguments++] = argv[i];
+        }
+    }
+    if (bad_usage || num_arguments < 2)
+    {
+        printf("Usage: %s [--commands frames.cmd] [--trajectories frames.trj] <player1.so> <player2.so> [shot cache MB]\n", argv[0]);
+        printf("       %s --verify [frames.cmd] [threads]\n", argv[0]);
         return 1;
     }
 
@@ -18,8 +297,8 @@ int main(int argc, char *argv[])
     players[0].type = AI;
     players[1].type = AI;
 
-    char *player1_path = argv[1];
-    char *player2_path = argv[2];
+    char *player1_path = arguments[0];
+    char *player2_path = arguments[1];
 
     players[0].module.library_path = player1_path;
     players[1].module.library_path = player2_path;
@@ -87,17 +366,55 @@ int main(int argc, char *argv[])
     }
     players[1].module.pot_ball = pot_ball;
 
-    SetRandomSeed(time(NULL));
+    if (num_arguments > 2)
+    {
+        set_shot_cache_limit(default_shot_cache(), (size_t)atoi(arguments[2]) << 20);
+    }
 
-    Game *game = create_game(players, 2);
-    game->playback_speed = 1000;
-    game->default_playback_speed = 1000;
+    ReplayWriter *replay = NULL;
+    Game *game = load_checkpoint(players, 2, &replay);
+    if (game == NULL)
+    {
+        unsigned int seed = time(NULL);
+        SetRandomSeed(seed);
+
+        game = create_game(players, 2);
+        game->seed = seed;
+        game->playback_speed = 1000;
+        game->default_playback_speed = 1000;
 
+        // Frames go to the replay as soon as they finish, so a run that dies
+        // partway through still leaves a readable file.
+        replay = open_replay_writer(REPLAY_PATH, game);
+    }
+    if (replay != NULL)
+    {
+        start_replay_writer_thread(replay);
+    }
+    int frames_written = game->num_frames - 1;
     while (game->num_frames < 1000)
     {
         printf("Frame %d\n", game->num_frames + 1);
+        int num_frames = game->num_frames;
         update_game(game);
+        while (replay != NULL && frames_written < game->num_frames - 1)
+        {
+            write_replay_frame(replay, game, &(game->frames[frames_written++]));
+        }
+        if (game->num_frames > num_frames && (game->num_frames - 1) % CHECKPOINT_INTERVAL == 0)
+        {
+            save_checkpoint(game, replay);
+        }
     }
+    if (replay != NULL)
+    {
+        while (frames_written < game->num_frames)
+        {
+            write_replay_frame(replay, game, &(game->frames[frames_written++]));
+        }
+        close_replay_writer(replay);
+    }
+    remove(CHECKPOINT_PATH);
 
     Frame *frames = game->frames;
     int p1 = 0;
@@ -151,7 +468,17 @@ int main(int argc, char *argv[])
         printf("%d: %d\n", i, freqs[i]);
     }
 
-    serialise_game(game);
+    print_shot_cache_stats(default_shot_cache());
+
+    bool saved = true;
+    if (commands_path != NULL && !save_command_log(game, commands_path))
+    {
+        saved = false;
+    }
+    if (trajectories_path != NULL && !export_trajectories(game, trajectories_path))
+    {
+        saved = false;
+    }
 
-    return 0;
+    return saved ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include "fork.h"
+#include "obstacleindex.h"
+#include "geometry.h"
+#include "pocketability.h"
+#include <stdlib.h>
+#include <string.h>
+
+void reserve_fork(GameFork *fork, int num_balls)
+{
+    if (num_balls <= fork->ball_capacity)
+    {
+        return;
+    }
+    fork->balls = realloc(fork->balls, num_balls * sizeof(Ball));
+    fork->ball_paths = realloc(fork->ball_paths, num_balls * sizeof(Path));
+    fork->path_buffers = realloc(fork->path_buffers, num_balls * sizeof(Path));
+    for (int i = fork->ball_capacity; i < num_balls; i++)
+    {
+        fork->path_buffers[i].segments = malloc(10 * sizeof(PathSegment));
+        fork->path_buffers[i].num_segments = 0;
+        fork->path_buffers[i].capacity = 10;
+    }
+    fork->ball_capacity = num_balls;
+}
+
+GameFork *create_game_fork(int num_balls)
+{
+    GameFork *fork = malloc(sizeof(GameFork));
+    fork->balls = NULL;
+    fork->ball_paths = NULL;
+    fork->path_buffers = NULL;
+    fork->ball_capacity = 0;
+    fork->obstacle_index = NULL;
+    fork->geometry = create_table_geometry();
+    fork->pocketability = create_pocketability();
+    fork->in_use = false;
+    fork->game.scene.ball_set.num_balls = 0;
+    fork->game.current_shot.event_capacity = 10;
+    fork->game.current_shot.events = malloc(fork->game.current_shot.event_capacity * sizeof(ShotEvent));
+    fork->game.current_shot.num_events = 0;
+    reserve_fork(fork, num_balls);
+    return fork;
+}
+
+void reclaim_paths(GameFork *fork)
+{
+    // add_segment may have moved a path buffer while growing it, so take the
+    // buffers back from the previous fork's balls before overwriting them.
+    for (int i = 0; i < fork->game.scene.ball_set.num_balls; i++)
+    {
+        fork->path_buffers[i] = fork->balls[i].path;
+    }
+}
+
+void copy_balls(GameFork *fork, Scene *scene)
+{
+    int num_balls = scene->ball_set.num_balls;
+    reserve_fork(fork, num_balls);
+    memcpy(fork->balls, scene->ball_set.balls, num_balls * sizeof(Ball));
+    for (int i = 0; i < num_balls; i++)
+    {
+        fork->balls[i].path = fork->path_buffers[i];
+        fork->balls[i].path.num_segments = 0;
+    }
+    fork->game.scene.ball_set.balls = fork->balls;
+    fork->game.scene.ball_set.num_balls = num_balls;
+    fork->game.scene.ball_set.ball_capacity = fork->ball_capacity;
+}
+
+Game *fork_game(GameFork *fork, Game *game)
+{
+    Shot shot = fork->game.current_shot;
+    reclaim_paths(fork);
+    fork->game = *game;
+    copy_balls(fork, &(game->scene));
+    shot.player = &(game->players[game->current_player]);
+    shot.ball_paths = fork->ball_paths;
+    shot.num_events = 0;
+    shot.end_time = 0;
+    fork->game.current_shot = shot;
+    fork->game.state = BEFORE_SHOT;
+    fork->game.geometry = fork->geometry;
+    fork->geometry->version = -1;
+    fork->game.pocketability = fork->pocketability;
+    fork->pocketability->version = -1;
+    fork->in_use = true;
+    return &(fork->game);
+}
+
+Game *fork_scene(GameFork *fork, Scene *scene)
+{
+    Shot shot = fork->game.current_shot;
+    reclaim_paths(fork);
+    memset(&(fork->game), 0, sizeof(Game));
+    fork->game.scene = *scene;
+    copy_balls(fork, scene);
+    shot.player = NULL;
+    shot.ball_paths = fork->ball_paths;
+    shot.num_events = 0;
+    shot.end_time = 0;
+    fork->game.current_shot = shot;
+    fork->game.state = BEFORE_SHOT;
+    fork->game.geometry = fork->geometry;
+    fork->geometry->version = -1;
+    fork->game.pocketability = fork->pocketability;
+    fork->pocketability->version = -1;
+    fork->in_use = true;
+    return &(fork->game);
+}
+
+void simulate_fork(GameFork *fork, Vector3 v, Vector3 w)
+{
+    simulate_fork_until(fork, v, w, 0);
+}
+
+void simulate_fork_until(GameFork *fork, Vector3 v, Vector3 w, int max_events)
+{
+    Game *game = &(fork->game);
+    Ball *cue_ball = &(game->scene.ball_set.balls[0]);
+    clear_paths(&(game->scene));
+    game->current_shot.num_events = 0;
+    simulate_paths_until(game, cue_ball, cue_ball->initial_position, v, w, 0, max_events);
+    double end_time = 0;
+    for (int i = 0; i < game->scene.ball_set.num_balls; i++)
+    {
+        Path path = game->scene.ball_set.balls[i].path;
+        game->current_shot.ball_paths[i] = path;
+        double start_time = path.segments[path.num_segments - 1].start_time;
+        if (start_time > end_time)
+        {
+            end_time = start_time;
+        }
+    }
+    game->current_shot.end_time = end_time + 1;
+    game->current_shot.v = v;
+    game->current_shot.w = w;
+    game->v = v;
+    game->w = w;
+}
+
+ShotResult evaluate_fork(GameFork *fork)
+{
+    return evaluate_shot(&(fork->game.scene), &(fork->game.current_shot));
+}
+
+void advance_fork(GameFork *fork)
+{
+    Game *game = &(fork->game);
+    mark_pocketed_balls(&(game->scene), &(game->current_shot));
+    for (int i = 0; i < game->scene.ball_set.num_balls; i++)
+    {
+        Ball *ball = &(game->scene.ball_set.balls[i]);
+        if (ball->path.num_segments > 0)
+        {
+            ball->initial_position = Vec2ToVector3(ball->path.segments[ball->path.num_segments - 1].initial_position);
+        }
+        ball->path.num_segments = 0;
+    }
+    game->current_shot.num_events = 0;
+
+    // The source game's index describes the table before this shot.
+    if (fork->obstacle_index == NULL)
+    {
+        fork->obstacle_index = create_obstacle_index();
+    }
+    game->obstacle_index = fork->obstacle_index;
+    game->table_version++;
+    build_obstacle_index(fork->obstacle_index, &(game->scene), game->table_version);
+}
+
+void release_game_fork(GameFork *fork)
+{
+    fork->in_use = false;
+}
+
+void free_game_fork(GameFork *fork)
+{
+    reclaim_paths(fork);
+    for (int i = 0; i < fork->ball_capacity; i++)
+    {
+        free(fork->path_buffers[i].segments);
+    }
+    free(fork->balls);
+    free(fork->ball_paths);
+    free(fork->path_buffers);
+    free(fork->game.current_shot.events);
+    if (fork->obstacle_index != NULL)
+    {
+        free_obstacle_index(fork->obstacle_index);
+    }
+    free_table_geometry(fork->geometry);
+    free_pocketability(fork->pocketability);
+    free(fork);
+}
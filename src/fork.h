@@ -0,0 +1,41 @@
+#ifndef FORK_H
+#define FORK_H
+#include "game.h"
+
+// A fork is a throwaway copy of a game that can be simulated without touching
+// the original. The table, coefficients, players and frame history are shared
+// with the source game and must be treated as read-only; only the balls and
+// the current shot belong to the fork. Forking and releasing never allocate
+// once the fork's buffers have grown to fit the table.
+typedef struct
+{
+    Game game;
+    Ball *balls;
+    Path *ball_paths;
+    Path *path_buffers;
+    int ball_capacity;
+    struct ObstacleIndex *obstacle_index;
+    struct TableGeometry *geometry;
+    struct Pocketability *pocketability;
+    bool in_use;
+} GameFork;
+
+GameFork *create_game_fork(int num_balls);
+
+Game *fork_game(GameFork *fork, Game *game);
+
+Game *fork_scene(GameFork *fork, Scene *scene);
+
+void simulate_fork(GameFork *fork, Vector3 v, Vector3 w);
+
+void simulate_fork_until(GameFork *fork, Vector3 v, Vector3 w, int max_events);
+
+ShotResult evaluate_fork(GameFork *fork);
+
+void advance_fork(GameFork *fork);
+
+void release_game_fork(GameFork *fork);
+
+void free_game_fork(GameFork *fork);
+
+#endif // FORK_H
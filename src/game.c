@@ -1,9 +1,17 @@
 #include "game.h"
 #include "polynomial.h"
+#include "obstacleindex.h"
+#include "geometry.h"
+#include "pocketability.h"
 #include <stdlib.h>
 #include <raylib.h>
 #include <assert.h>
 
+// A ball cannot meet the same obstacle again within this many seconds of
+// leaving it. With planar state in double precision the root of the contact
+// just resolved lands within about 1e-6 s of the segment start.
+#define REPEAT_COLLISION_TOLERANCE 1e-5
+
 Vector3 world_to_screen(Vector3 position)
 {
     double scale = 200;
@@ -15,14 +23,14 @@ int meters_to_pixels(double meters)
     return (int)(200 * meters);
 }
 
+// Taken shots never change, so each call only counts the shots added since
+// the one before.
 void update_stats(Game *game)
 {
-    game->p1_stats = (Stats){0, 0, 0};
-    game->p2_stats = (Stats){0, 0, 0};
-    for (int i = 0; i < game->num_frames; i++)
+    for (int i = game->stats_frame; i < game->num_frames; i++)
     {
         Frame frame = game->frames[i];
-        for (int j = 0; j < frame.num_shots; j++)
+        for (int j = i == game->stats_frame ? game->stats_shot : 0; j < frame.num_shots; j++)
         {
             Shot shot = frame.shot_history[j];
             if (shot.player == &(game->players[0]))
@@ -38,7 +46,7 @@ void update_stats(Game *game)
                 ShotEvent event = shot.events[k];
                 if (event.type == BALL_POCKETED)
                 {
-                    if (event.ball1->id == 0)
+                    if (event_ball1(&(game->scene), event)->id == 0)
                     {
                         if (shot.player == &(game->players[0]))
                         {
@@ -64,6 +72,11 @@ void update_stats(Game *game)
             }
         }
     }
+    if (game->num_frames > 0)
+    {
+        game->stats_frame = game->num_frames - 1;
+        game->stats_shot = game->frames[game->num_frames - 1].num_shots;
+    }
 }
 
 void shot_add_event(Shot *shot, ShotEvent event)
@@ -84,7 +97,7 @@ void shot_add_event(Shot *shot, ShotEvent event)
     shot->num_events++;
 }
 
-Vector3 get_position(PathSegment segment, double time)
+Vec2 get_position(PathSegment segment, double time)
 {
     if (time < segment.start_time)
     {
@@ -92,13 +105,13 @@ Vector3 get_position(PathSegment segment, double time)
     }
     if (time > segment.end_time)
     {
-        return Vector3Add(segment.initial_position, Vector3Add(Vector3Scale(segment.initial_velocity, segment.end_time - segment.start_time), Vector3Scale(segment.acceleration, 0.5 * (segment.end_time - segment.start_time) * (segment.end_time - segment.start_time))));
+        return Vec2Add(segment.initial_position, Vec2Add(Vec2Scale(segment.initial_velocity, segment.end_time - segment.start_time), Vec2Scale(segment.acceleration, 0.5 * (segment.end_time - segment.start_time) * (segment.end_time - segment.start_time))));
     }
-    Vector3 p = Vector3Add(segment.initial_position, Vector3Add(Vector3Scale(segment.initial_velocity, time - segment.start_time), Vector3Scale(segment.acceleration, 0.5 * (time - segment.start_time) * (time - segment.start_time))));
+    Vec2 p = Vec2Add(segment.initial_position, Vec2Add(Vec2Scale(segment.initial_velocity, time - segment.start_time), Vec2Scale(segment.acceleration, 0.5 * (time - segment.start_time) * (time - segment.start_time))));
     return p;
 }
 
-Vector3 get_velocity(PathSegment segment, double time)
+Vec2 get_velocity(PathSegment segment, double time)
 {
     if (time < segment.start_time)
     {
@@ -106,9 +119,9 @@ Vector3 get_velocity(PathSegment segment, double time)
     }
     if (time > segment.end_time)
     {
-        return Vector3Add(segment.initial_velocity, Vector3Scale(segment.acceleration, segment.end_time - segment.start_time));
+        return Vec2Add(segment.initial_velocity, Vec2Scale(segment.acceleration, segment.end_time - segment.start_time));
     }
-    Vector3 v = Vector3Add(segment.initial_velocity, Vector3Scale(segment.acceleration, time - segment.start_time));
+    Vec2 v = Vec2Add(segment.initial_velocity, Vec2Scale(segment.acceleration, time - segment.start_time));
     return v;
 }
 
@@ -130,7 +143,7 @@ void print_path(Path path)
     for (int i = 0; i < path.num_segments; i++)
     {
         PathSegment segment = path.segments[i];
-        Vector3 acceleration = segment.acceleration;
+        Vec2 acceleration = segment.acceleration;
         (void)acceleration;
     }
 }
@@ -162,29 +175,41 @@ void add_segment(Path *path, PathSegment segment)
     path->num_segments++;
 }
 
-void add_sliding_segment(Ball *ball, Vector3 initial_position, Vector3 initial_velocity, Vector3 initial_angular_velocity, double start_time, Coefficients coefficients)
+// The velocity of the point where the ball touches the cloth, which is what
+// sliding friction opposes.
+Vec2 contact_point_velocity(Vec2 velocity, Vector3 angular_velocity, double radius)
+{
+    return (Vec2){velocity.x - angular_velocity.y * radius, velocity.y + angular_velocity.x * radius};
+}
+
+Vector3 friction_angular_acceleration(Vec2 acceleration, double scale)
+{
+    return (Vector3){-acceleration.y * scale, acceleration.x * scale, 0};
+}
+
+void add_sliding_segment(Ball *ball, Vec2 initial_position, Vec2 initial_velocity, Vector3 initial_angular_velocity, double start_time, Coefficients coefficients)
 {
     double mu_slide = coefficients.mu_slide;
     double g = coefficients.g;
     double R = ball->radius;
-    Vector3 contact_point_v = Vector3Subtract(initial_velocity, Vector3CrossProduct(initial_angular_velocity, (Vector3){0, 0, R}));
-    Vector3 acceleration = Vector3Scale(Vector3Normalize(contact_point_v), -mu_slide * g);
-    Vector3 angular_acceleration = Vector3Scale(Vector3CrossProduct(acceleration, (Vector3){0, 0, -1}), -2.5 / R);
-    double end_time = start_time + 2 * Vector3Length(contact_point_v) / (7 * mu_slide * g);
+    Vec2 contact_point_v = contact_point_velocity(initial_velocity, initial_angular_velocity, R);
+    Vec2 acceleration = Vec2Scale(Vec2Normalize(contact_point_v), -mu_slide * g);
+    Vector3 angular_acceleration = friction_angular_acceleration(acceleration, -2.5 / R);
+    double end_time = start_time + 2 * Vec2Length(contact_point_v) / (7 * mu_slide * g);
     PathSegment segment = {initial_position, initial_velocity, acceleration, initial_angular_velocity, angular_acceleration, false, start_time, end_time, NULL};
     ball->path.segments[ball->path.num_segments - 1].end_time = start_time;
     add_segment(&(ball->path), segment);
 }
 
-void add_rolling_segment(Ball *ball, Vector3 initial_position, Vector3 initial_velocity, double start_time, Coefficients coefficients)
+void add_rolling_segment(Ball *ball, Vec2 initial_position, Vec2 initial_velocity, double start_time, Coefficients coefficients)
 {
     double mu_roll = coefficients.mu_roll;
     double g = coefficients.g;
     double R = ball->radius;
-    Vector3 acceleration = Vector3Scale(Vector3Normalize(initial_velocity), -mu_roll * g);
-    Vector3 initial_angular_velocity = Vector3CrossProduct(initial_velocity, (Vector3){0, 0, -1 / R});
-    Vector3 angular_acceleration = Vector3Scale(Vector3CrossProduct(acceleration, (Vector3){0, 0, -1}), 1 / R);
-    double end_time = start_time + Vector3Length(initial_velocity) / (mu_roll * g);
+    Vec2 acceleration = Vec2Scale(Vec2Normalize(initial_velocity), -mu_roll * g);
+    Vector3 initial_angular_velocity = friction_angular_acceleration(initial_velocity, 1 / R);
+    Vector3 angular_acceleration = friction_angular_acceleration(acceleration, 1 / R);
+    double end_time = start_time + Vec2Length(initial_velocity) / (mu_roll * g);
     PathSegment segment = {initial_position, initial_velocity, acceleration, initial_angular_velocity, angular_acceleration, true, start_time, end_time, NULL};
     add_segment(&(ball->path), segment);
 }
@@ -200,13 +225,14 @@ bool detect_ball_cushion_collision(Game *game, Ball ball, Cushion *cushion, doub
 {
     double collision_time = INFINITY;
     PathSegment *segment = &(ball.path.segments[ball.path.num_segments - 1]);
-    Vector3 p1 = segment->initial_position;
-    Vector3 v1 = segment->initial_velocity;
-    Vector3 line_normal = Vector3Normalize(Vector3CrossProduct(Vector3Subtract(cushion->p2, cushion->p1), (Vector3){0, 0, 1}));
-    double sn = Vector3DotProduct(Vector3Subtract(cushion->p1, p1), line_normal);
-    double vn = Vector3DotProduct(v1, line_normal);
-    Vector3 a = segment->acceleration;
-    double an = Vector3DotProduct(a, line_normal);
+    Vec2 p1 = segment->initial_position;
+    Vec2 v1 = segment->initial_velocity;
+    Vec2 cushion_p1 = Vec2FromVector3(cushion->p1);
+    Vec2 line_normal = Vec2LineNormal(cushion_p1, Vec2FromVector3(cushion->p2));
+    double sn = Vec2DotProduct(Vec2Subtract(cushion_p1, p1), line_normal);
+    double vn = Vec2DotProduct(v1, line_normal);
+    Vec2 a = segment->acceleration;
+    double an = Vec2DotProduct(a, line_normal);
     if (an == 0)
     {
         collision_time = segment->start_time + (sn / vn);
@@ -227,7 +253,7 @@ bool detect_ball_cushion_collision(Game *game, Ball ball, Cushion *cushion, doub
     bool repeat_collision = false;
     Shot *current_shot = &(game->current_shot);
     ShotEvent *events = current_shot->events;
-    ShotEvent last_event = {NONE, NULL, NULL, NULL, NULL, 0};
+    ShotEvent last_event = {0, NONE, 0, -1, -1, -1};
     if (current_shot->num_events > 0)
     {
         last_event = events[current_shot->num_events - 1];
@@ -236,12 +262,12 @@ bool detect_ball_cushion_collision(Game *game, Ball ball, Cushion *cushion, doub
 
     if (last_event.type == BALL_CUSHION_COLLISION)
     {
-        if (last_event.ball1->id == ball.id && last_event.cushion == cushion)
+        if (event_ball1(&(game->scene), last_event)->id == ball.id && event_cushion(&(game->scene), last_event) == cushion)
         {
             repeat_collision = true;
         }
     }
-    double tolerance = repeat_collision ? 1e-3 : 0;
+    double tolerance = repeat_collision ? REPEAT_COLLISION_TOLERANCE : 0;
     if (collision_time1 > segment->start_time + tolerance && collision_time1 < segment->end_time && collision_time1 > min_time && collision_time1 < collision_time)
     {
         collision_time = collision_time1;
@@ -262,12 +288,12 @@ bool detect_ball_ball_collision(Game *game, Ball ball1, Ball ball2, double *t)
 {
     PathSegment *segment1 = &(ball1.path.segments[ball1.path.num_segments - 1]);
     PathSegment *segment2 = &(ball2.path.segments[ball2.path.num_segments - 1]);
-    Vector3 p1 = segment1->initial_position;
-    Vector3 p2 = segment2->initial_position;
-    Vector3 v1 = segment1->initial_velocity;
-    Vector3 v2 = segment2->initial_velocity;
-    Vector3 a1 = segment1->acceleration;
-    Vector3 a2 = segment2->acceleration;
+    Vec2 p1 = segment1->initial_position;
+    Vec2 p2 = segment2->initial_position;
+    Vec2 v1 = segment1->initial_velocity;
+    Vec2 v2 = segment2->initial_velocity;
+    Vec2 a1 = segment1->acceleration;
+    Vec2 a2 = segment2->acceleration;
     double t1 = segment1->start_time;
     double t2 = segment2->start_time;
     double r1 = ball1.radius;
@@ -302,7 +328,7 @@ bool detect_ball_ball_collision(Game *game, Ball ball1, Ball ball2, double *t)
     bool repeat_collision = false;
     Shot *current_shot = &(game->current_shot);
     ShotEvent *events = current_shot->events;
-    ShotEvent last_event = {NONE, NULL, NULL, NULL, NULL, 0};
+    ShotEvent last_event = {0, NONE, 0, -1, -1, -1};
     if (current_shot->num_events > 0)
     {
         last_event = events[current_shot->num_events - 1];
@@ -311,12 +337,14 @@ bool detect_ball_ball_collision(Game *game, Ball ball1, Ball ball2, double *t)
 
     if (last_event.type == BALL_BALL_COLLISION)
     {
-        if ((last_event.ball1->id == ball1.id && last_event.ball2->id == ball2.id) || (last_event.ball1->id == ball2.id && last_event.ball2->id == ball1.id))
+        int id1 = event_ball1(&(game->scene), last_event)->id;
+        int id2 = event_ball2(&(game->scene), last_event)->id;
+        if ((id1 == ball1.id && id2 == ball2.id) || (id1 == ball2.id && id2 == ball1.id))
         {
             repeat_collision = true;
         }
     }
-    double tolerance = repeat_collision ? 1e-3 : 0;
+    double tolerance = repeat_collision ? REPEAT_COLLISION_TOLERANCE : 0;
     if (x1 > segment1->start_time + tolerance && x1 < segment1->end_time && x1 > segment2->start_time + tolerance && x1 < segment2->end_time && x1 < collision_time && x1 > min_time)
     {
         collision_time = x1;
@@ -344,16 +372,16 @@ bool detect_ball_ball_collision(Game *game, Ball ball1, Ball ball2, double *t)
 bool detect_ball_pocket_collision(Game *game, Ball ball, Pocket pocket, double *t)
 {
     PathSegment *segment1 = &(ball.path.segments[ball.path.num_segments - 1]);
-    Vector3 p1 = segment1->initial_position;
-    Vector3 p2 = pocket.position;
-    Vector3 v1 = segment1->initial_velocity;
-    Vector3 a1 = segment1->acceleration;
+    Vec2 p1 = segment1->initial_position;
+    Vec2 p2 = Vec2FromVector3(pocket.position);
+    Vec2 v1 = segment1->initial_velocity;
+    Vec2 a1 = segment1->acceleration;
     double t1 = segment1->start_time;
     double r2 = pocket.radius;
 
     if (segment1->rolling)
     {
-        Vector3 p3 = get_position(*segment1, segment1->end_time);
+        Vec2 p3 = get_position(*segment1, segment1->end_time);
         double a = (p3.x - p1.x) * (p3.x - p1.x) + (p3.y - p1.y) * (p3.y - p1.y);
         double b = 2 * ((p3.x - p1.x) * (p1.x - p2.x) + (p3.y - p1.y) * (p1.y - p2.y));
         double c = (p1.x - p2.x) * (p1.x - p2.x) + (p1.y - p2.y) * (p1.y - p2.y) - (r2) * (r2);
@@ -372,9 +400,9 @@ bool detect_ball_pocket_collision(Game *game, Ball ball, Pocket pocket, double *
         {
             return false;
         }
-        double distance = x * Vector3Length(Vector3Subtract(p3, p1));
-        double v = Vector3Length(v1);
-        a = -Vector3Length(a1);
+        double distance = x * Vec2Length(Vec2Subtract(p3, p1));
+        double v = Vec2Length(v1);
+        a = -Vec2Length(a1);
         solve_quadratic(0.5 * a, v, -distance, &x1, &x2);
         double collision_time = INFINITY;
         if (x1 < collision_time && x1 > 0)
@@ -414,7 +442,7 @@ bool detect_ball_pocket_collision(Game *game, Ball ball, Pocket pocket, double *
     bool repeat_collision = false;
     Shot *current_shot = &(game->current_shot);
     ShotEvent *events = current_shot->events;
-    ShotEvent last_event = {NONE, NULL, NULL, NULL, NULL, 0};
+    ShotEvent last_event = {0, NONE, 0, -1, -1, -1};
     if (current_shot->num_events > 0)
     {
         last_event = events[current_shot->num_events - 1];
@@ -424,12 +452,12 @@ bool detect_ball_pocket_collision(Game *game, Ball ball, Pocket pocket, double *
 
     if (last_event.type == BALL_POCKETED)
     {
-        if (last_event.ball1->id == ball.id)
+        if (event_ball1(&(game->scene), last_event)->id == ball.id)
         {
             repeat_collision = true;
         }
     }
-    double tolerance = repeat_collision ? 1e-3 : 0;
+    double tolerance = repeat_collision ? REPEAT_COLLISION_TOLERANCE : 0;
     if (x1 > segment1->start_time + tolerance && x1 < segment1->end_time && x1 < collision_time && x1 > min_time)
     {
         collision_time = x1;
@@ -458,28 +486,28 @@ void resolve_ball_ball_collision(Ball *ball1, Ball *ball2, double time, Coeffici
 {
     PathSegment *segment1 = &(ball1->path.segments[ball1->path.num_segments - 1]);
     PathSegment *segment2 = &(ball2->path.segments[ball2->path.num_segments - 1]);
-    Vector3 p1 = get_position(*segment1, time);
-    Vector3 p2 = get_position(*segment2, time);
-    Vector3 v1 = get_velocity(*segment1, time);
-    Vector3 v2 = get_velocity(*segment2, time);
+    Vec2 p1 = get_position(*segment1, time);
+    Vec2 p2 = get_position(*segment2, time);
+    Vec2 v1 = get_velocity(*segment1, time);
+    Vec2 v2 = get_velocity(*segment2, time);
     Vector3 w1 = get_angular_velocity(*segment1, time);
     Vector3 w2 = get_angular_velocity(*segment2, time);
-    Vector3 normal = Vector3Normalize(Vector3Subtract(p2, p1));
-    Vector3 tangent = Vector3CrossProduct(normal, (Vector3){0, 0, 1});
+    Vec2 normal = Vec2Normalize(Vec2Subtract(p2, p1));
+    Vec2 tangent = {normal.y, -normal.x};
     double e = coefficients.e_ball_ball;
     double m1 = ball1->mass;
     double m2 = ball2->mass;
-    double v1n = Vector3DotProduct(v1, normal);
-    double v2n = Vector3DotProduct(v2, normal);
-    double v1t = Vector3DotProduct(v1, tangent);
-    double v2t = Vector3DotProduct(v2, tangent);
+    double v1n = Vec2DotProduct(v1, normal);
+    double v2n = Vec2DotProduct(v2, normal);
+    double v1t = Vec2DotProduct(v1, tangent);
+    double v2t = Vec2DotProduct(v2, tangent);
     double v1n_final = (v1n * (m1 - e * m2) + 2 * e * m2 * v2n) / (m1 + m2);
     double v2n_final = (v2n * (m2 - e * m1) + 2 * e * m1 * v1n) / (m1 + m2);
     double v1t_final = v1t;
     double v2t_final = v2t;
 
-    Vector3 v1_final = Vector3Add(Vector3Scale(normal, v1n_final), Vector3Scale(tangent, v1t_final));
-    Vector3 v2_final = Vector3Add(Vector3Scale(normal, v2n_final), Vector3Scale(tangent, v2t_final));
+    Vec2 v1_final = Vec2Add(Vec2Scale(normal, v1n_final), Vec2Scale(tangent, v1t_final));
+    Vec2 v2_final = Vec2Add(Vec2Scale(normal, v2n_final), Vec2Scale(tangent, v2t_final));
     add_sliding_segment(ball1, p1, v1_final, w1, time, coefficients);
     add_sliding_segment(ball2, p2, v2_final, w2, time, coefficients);
 }
@@ -487,33 +515,33 @@ void resolve_ball_ball_collision(Ball *ball1, Ball *ball2, double time, Coeffici
 void resolve_ball_cushion_collision(Ball *ball, Cushion *cushion, double time, Coefficients coefficients)
 {
     PathSegment *segment = &(ball->path.segments[ball->path.num_segments - 1]);
-    Vector3 p = get_position(*segment, time);
-    Vector3 v = get_velocity(*segment, time);
+    Vec2 p = get_position(*segment, time);
+    Vec2 v = get_velocity(*segment, time);
     Vector3 w = get_angular_velocity(*segment, time);
-    Vector3 normal = Vector3Normalize(Vector3CrossProduct(Vector3Subtract(cushion->p2, cushion->p1), (Vector3){0, 0, 1}));
-    Vector3 tangent = Vector3CrossProduct(normal, (Vector3){0, 0, 1});
+    Vec2 normal = Vec2LineNormal(Vec2FromVector3(cushion->p1), Vec2FromVector3(cushion->p2));
+    Vec2 tangent = {normal.y, -normal.x};
     double e = coefficients.e_ball_cushion;
-    double v_n = Vector3DotProduct(v, normal);
-    double v_t = Vector3DotProduct(v, tangent);
+    double v_n = Vec2DotProduct(v, normal);
+    double v_t = Vec2DotProduct(v, tangent);
     double v_n_final = -e * v_n;
     double v_t_final = v_t;
-    Vector3 v_final = Vector3Add(Vector3Scale(normal, v_n_final), Vector3Scale(tangent, v_t_final));
+    Vec2 v_final = Vec2Add(Vec2Scale(normal, v_n_final), Vec2Scale(tangent, v_t_final));
     add_sliding_segment(ball, p, v_final, w, time, coefficients);
 }
 
 void resolve_ball_pocket_collision(Ball *ball, Pocket pocket, double time, Coefficients coefficients)
 {
     (void)pocket;
-    Vector3 p;
+    Vec2 p;
     if (ball->id == 0)
     {
-        p = (Vector3){2.3, 0.3, 0};
+        p = (Vec2){2.3, 0.3};
     }
     else
     {
-        p = Vector3Add((Vector3){1000, 200, 0}, Vector3Scale((Vector3){0, 50, 0}, ball->id));
+        p = (Vec2){1000, 200 + 50 * ball->id};
     }
-    Vector3 v = {0, 0, 0};
+    Vec2 v = {0, 0};
     Vector3 w = {0, 0, 0};
     add_sliding_segment(ball, p, v, w, time, coefficients);
 }
@@ -521,19 +549,76 @@ void resolve_ball_pocket_collision(Ball *ball, Pocket pocket, double time, Coeff
 void resolve_roll(Ball *ball, double time, Coefficients coefficients)
 {
     PathSegment *segment = &(ball->path.segments[ball->path.num_segments - 1]);
-    Vector3 p = get_position(*segment, segment->end_time);
-    Vector3 v = get_velocity(*segment, segment->end_time);
+    Vec2 p = get_position(*segment, segment->end_time);
+    Vec2 v = get_velocity(*segment, segment->end_time);
     add_rolling_segment(ball, p, v, time, coefficients);
 }
 
 void resolve_stop(Ball *ball, double time)
 {
     PathSegment *segment = &(ball->path.segments[ball->path.num_segments - 1]);
-    Vector3 p = get_position(*segment, segment->end_time);
-    PathSegment stop_segment = {p, {0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0}, false, time, INFINITY, NULL};
+    Vec2 p = get_position(*segment, segment->end_time);
+    PathSegment stop_segment = {p, {0, 0}, {0, 0}, {0, 0, 0}, {0, 0, 0}, false, time, INFINITY, NULL};
     add_segment(&(ball->path), stop_segment);
 }
 
+bool ball_is_resting(Ball *ball)
+{
+    return ball->path.segments[ball->path.num_segments - 1].end_time == INFINITY;
+}
+
+bool only_cue_ball_moving(Game *game)
+{
+    for (int i = 1; i < game->scene.ball_set.num_balls; i++)
+    {
+        Path path = game->scene.ball_set.balls[i].path;
+        if (path.num_segments != 1 || path.segments[0].end_time != INFINITY)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+Ball *event_ball1(Scene *scene, ShotEvent event)
+{
+    return event.ball1 >= 0 ? &(scene->ball_set.balls[event.ball1]) : NULL;
+}
+
+Ball *event_ball2(Scene *scene, ShotEvent event)
+{
+    return event.ball2 >= 0 ? &(scene->ball_set.balls[event.ball2]) : NULL;
+}
+
+Cushion *event_cushion(Scene *scene, ShotEvent event)
+{
+    if (event.type != BALL_CUSHION_COLLISION || event.cushion_or_pocket < 0)
+    {
+        return NULL;
+    }
+    return &(scene->table.cushions[event.cushion_or_pocket]);
+}
+
+Pocket *event_pocket(Scene *scene, ShotEvent event)
+{
+    if (event.type != BALL_POCKETED || event.cushion_or_pocket < 0)
+    {
+        return NULL;
+    }
+    return &(scene->table.pockets[event.cushion_or_pocket]);
+}
+
+bool obstacle_index_is_current(Game *game)
+{
+    return game->obstacle_index != NULL && game->obstacle_index->version == game->table_version;
+}
+
+void refresh_table_state(Game *game)
+{
+    game->table_version++;
+    build_obstacle_index(game->obstacle_index, &(game->scene), game->table_version);
+}
+
 bool update_path(Game *game)
 {
     ShotEventType update_type = NONE;
@@ -543,12 +628,31 @@ bool update_path(Game *game)
     Ball *ball1;
     Ball *ball2;
     Pocket pocket;
+    int pocket_index = -1;
+    // Until the cue ball hits something every other ball is still at rest, so
+    // only the balls the obstacle index puts near its path can be hit.
+    bool use_obstacle_index = obstacle_index_is_current(game) && only_cue_ball_moving(game);
+    int num_candidates = 0;
+    int candidates[game->scene.ball_set.num_balls];
+    if (use_obstacle_index)
+    {
+        Path *cue_path = &(game->scene.ball_set.balls[0].path);
+        num_candidates = query_obstacle_candidates(game->obstacle_index, &(cue_path->segments[cue_path->num_segments - 1]), 0, candidates, game->scene.ball_set.num_balls);
+    }
     for (int i = 0; i < game->scene.ball_set.num_balls; i++)
     {
         Ball *current_ball = &(game->scene.ball_set.balls[i]);
-        for (int j = i + 1; j < game->scene.ball_set.num_balls; j++)
+        // A resting ball cannot reach a cushion or pocket, or another resting ball.
+        bool resting = ball_is_resting(current_ball);
+        int num_others = use_obstacle_index ? (i == 0 ? num_candidates : 0) : game->scene.ball_set.num_balls - i - 1;
+        for (int k = 0; k < num_others; k++)
         {
+            int j = use_obstacle_index ? candidates[k] : i + 1 + k;
             Ball *other_ball = &(game->scene.ball_set.balls[j]);
+            if (resting && ball_is_resting(other_ball))
+            {
+                continue;
+            }
             if (detect_ball_ball_collision(game, *current_ball, *other_ball, &time))
             {
                 if (time < first_time)
@@ -561,6 +665,11 @@ bool update_path(Game *game)
             }
         }
 
+        if (resting)
+        {
+            continue;
+        }
+
         for (int j = 0; j < game->scene.table.num_cushions; j++)
         {
             Cushion *current_cushion = &(game->scene.table.cushions[j]);
@@ -587,6 +696,7 @@ bool update_path(Game *game)
                     update_type = BALL_POCKETED;
                     ball1 = current_ball;
                     pocket = current_pocket;
+                    pocket_index = j;
                 }
             }
         }
@@ -635,7 +745,20 @@ bool update_path(Game *game)
     {
         resolve_stop(ball1, first_time);
     }
-    ShotEvent event = {update_type, ball1, ball2, cushion, &pocket, first_time};
+    Ball *balls = game->scene.ball_set.balls;
+    ShotEvent event = {first_time, update_type, 0, ball1 - balls, -1, -1};
+    if (update_type == BALL_BALL_COLLISION)
+    {
+        event.ball2 = ball2 - balls;
+    }
+    else if (update_type == BALL_CUSHION_COLLISION)
+    {
+        event.cushion_or_pocket = cushion - game->scene.table.cushions;
+    }
+    else if (update_type == BALL_POCKETED)
+    {
+        event.cushion_or_pocket = pocket_index;
+    }
     Shot *current_shot = &(game->current_shot);
     if (current_shot->num_events > 0)
     {
@@ -678,7 +801,12 @@ void add_orientation_to_path(Game *game)
     }
 }
 
-void generate_paths(Game *game, Ball *ball, Vector3 initial_position, Vector3 initial_velocity, Vector3 initial_angular_velocity, double start_time)
+void simulate_paths(Game *game, Ball *ball, Vector3 initial_position, Vector3 initial_velocity, Vector3 initial_angular_velocity, double start_time)
+{
+    simulate_paths_until(game, ball, initial_position, initial_velocity, initial_angular_velocity, start_time, 0);
+}
+
+void simulate_paths_until(Game *game, Ball *ball, Vector3 initial_position, Vector3 initial_velocity, Vector3 initial_angular_velocity, double start_time, int max_events)
 {
     for (int i = 0; i < game->scene.ball_set.num_balls; i++)
     {
@@ -687,7 +815,7 @@ void generate_paths(Game *game, Ball *ball, Vector3 initial_position, Vector3 in
         {
             continue;
         }
-        PathSegment segment = {current_ball->initial_position, {0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0}, false, 0, INFINITY, NULL};
+        PathSegment segment = {Vec2FromVector3(current_ball->initial_position), {0, 0}, {0, 0}, {0, 0, 0}, {0, 0, 0}, false, 0, INFINITY, NULL};
         add_segment(&(current_ball->path), segment);
     }
     double mu_slide = game->scene.coefficients.mu_slide;
@@ -695,15 +823,23 @@ void generate_paths(Game *game, Ball *ball, Vector3 initial_position, Vector3 in
     double R = ball->radius;
     double end_time;
 
-    Vector3 contact_point_v = Vector3Subtract(initial_velocity, Vector3CrossProduct(initial_angular_velocity, (Vector3){0, 0, R}));
-    Vector3 acceleration = Vector3Scale(Vector3Normalize(contact_point_v), -mu_slide * g);
-    Vector3 angular_acceleration = Vector3Scale(Vector3CrossProduct(acceleration, (Vector3){0, 0, -1}), -2.5 / R);
+    Vec2 velocity = Vec2FromVector3(initial_velocity);
+    Vec2 contact_point_v = contact_point_velocity(velocity, initial_angular_velocity, R);
+    Vec2 acceleration = Vec2Scale(Vec2Normalize(contact_point_v), -mu_slide * g);
+    Vector3 angular_acceleration = friction_angular_acceleration(acceleration, -2.5 / R);
 
-    end_time = start_time + 2 * Vector3Length(contact_point_v) / (7 * mu_slide * g);
-    PathSegment segment = {initial_position, initial_velocity, acceleration, initial_angular_velocity, angular_acceleration, false, start_time, end_time, NULL};
+    end_time = start_time + 2 * Vec2Length(contact_point_v) / (7 * mu_slide * g);
+    PathSegment segment = {Vec2FromVector3(initial_position), velocity, acceleration, initial_angular_velocity, angular_acceleration, false, start_time, end_time, NULL};
     add_segment(&(ball->path), segment);
-    while (update_path(game))
+    // With max_events set the simulation stops early and balls may be left
+    // part way along their last segment.
+    while ((max_events == 0 || game->current_shot.num_events < max_events) && update_path(game))
         ;
+}
+
+void generate_paths(Game *game, Ball *ball, Vector3 initial_position, Vector3 initial_velocity, Vector3 initial_angular_velocity, double start_time)
+{
+    simulate_paths(game, ball, initial_position, initial_velocity, initial_angular_velocity, start_time);
     add_orientation_to_path(game);
 }
 
@@ -711,8 +847,8 @@ void render_path_segment(PathSegment segment)
 {
     if (segment.rolling)
     {
-        Vector3 p1 = world_to_screen(segment.initial_position);
-        Vector3 p2 = world_to_screen(get_position(segment, segment.end_time));
+        Vector3 p1 = world_to_screen(Vec2ToVector3(segment.initial_position));
+        Vector3 p2 = world_to_screen(Vec2ToVector3(get_position(segment, segment.end_time)));
         DrawLine(p1.x, p1.y, p2.x, p2.y, BLUE);
     }
     else
@@ -721,8 +857,8 @@ void render_path_segment(PathSegment segment)
         {
             double t1 = segment.start_time + i * (segment.end_time - segment.start_time) / 100;
             double t2 = segment.start_time + (i + 1) * (segment.end_time - segment.start_time) / 100;
-            Vector3 p1 = world_to_screen(get_position(segment, t1));
-            Vector3 p2 = world_to_screen(get_position(segment, t2));
+            Vector3 p1 = world_to_screen(Vec2ToVector3(get_position(segment, t1)));
+            Vector3 p2 = world_to_screen(Vec2ToVector3(get_position(segment, t2)));
             DrawLine(p1.x, p1.y, p2.x, p2.y, RED);
         }
     }
@@ -786,35 +922,6 @@ void solve_direct_shot(Scene *scene, Vector3 initial_position, Vector3 target_po
     *w = required_angular_velocity;
 }
 
-void solve_one_cushion_shot(Scene *scene, Vector3 initial_position, Vector3 target_position, Vector3 v_roll, Cushion cushion, Vector3 *v, Vector3 *w)
-{
-    (void)v;
-    (void)w;
-    double mu_slide = scene->coefficients.mu_slide;
-    double g = scene->coefficients.g;
-    double R = scene->ball_set.balls[0].radius;
-
-    Vector3 cushion_tangent = Vector3Normalize(Vector3Subtract(cushion.p2, cushion.p1));
-    double cushion_coord = 0;
-    double cushion_length = Vector3Length(Vector3Subtract(cushion.p2, cushion.p1));
-    Vector3 cushion_contact_point;
-    while (cushion_coord < cushion_length)
-    {
-        cushion_contact_point = Vector3Add(cushion.p1, Vector3Scale(cushion_tangent, cushion_coord));
-        Vector3 v_after_collision;
-        Vector3 w_after_collision;
-        solve_direct_shot(scene, cushion_contact_point, target_position, v_roll, &v_after_collision, &w_after_collision);
-        Vector3 v_normal = Vector3Subtract(v_after_collision, Vector3Scale(cushion_tangent, Vector3DotProduct(v_after_collision, cushion_tangent)));
-        Vector3 v_before_collision = Vector3Subtract(v_after_collision, Vector3Scale(v_normal, 2));
-        Vector3 v_contact_point = Vector3Subtract(v_before_collision, Vector3CrossProduct(w_after_collision, (Vector3){0, 0, R}));
-        Vector3 acceleration = Vector3Scale(Vector3Normalize(v_contact_point), -mu_slide * g);
-        double x1, x2, x3, x4;
-        solve_quadratic(0.5 * acceleration.x, -v_contact_point.x, cushion_contact_point.x - initial_position.x, &x1, &x2);
-        solve_quadratic(0.5 * acceleration.y, -v_contact_point.y, cushion_contact_point.y - initial_position.y, &x3, &x4);
-        cushion_coord += 10;
-    }
-}
-
 void render_table(Table table)
 {
     for (int i = 0; i < table.num_cushions; i++)
@@ -918,7 +1025,7 @@ Vector3 get_ball_position(Ball ball, double time)
         PathSegment segment = ball.path.segments[i];
         if (time >= segment.start_time && time < segment.end_time)
         {
-            return get_position(segment, time);
+            return Vec2ToVector3(get_position(segment, time));
         }
     }
     return ball.initial_position;
@@ -984,6 +1091,13 @@ Scene create_scene()
     return scene;
 }
 
+void seed_frame_random(Game *game)
+{
+    unsigned int seed = game->seed * 2654435761u + game->num_frames;
+    SetRandomSeed(seed);
+    srand(seed);
+}
+
 void setup_new_frame(Game *game)
 {
     if (game->num_frames == game->frame_capacity)
@@ -1004,29 +1118,19 @@ void setup_new_frame(Game *game)
         ball->path.num_segments = 0;
         ball->initial_position = (Vector3){(double)GetRandomValue(230, 570) / 100, 0.3 + 0.2 * i, 0};
     }
-}
-bool apply_game_rules(Game *game)
-{
-    Frame *current_frame = &(game->frames[game->num_frames - 1]);
-    if (current_frame->num_shots >= 200)
+    refresh_table_state(game);
+    if (game->seed != 0)
     {
-        current_frame->winner = &(game->players[(game->current_player + 1) % game->num_players]);
-        game->consecutive_fouls = 0;
-        setup_new_frame(game);
-        return false;
+        seed_frame_random(game);
     }
-    if (game->consecutive_fouls >= 3)
-    {
-        current_frame->winner = &(game->players[(game->current_player + 1) % game->num_players]);
-        game->consecutive_fouls = 0;
-        setup_new_frame(game);
-        return false;
-    }
-    Ball *cue_ball = &(game->scene.ball_set.balls[0]);
+}
+ShotResult evaluate_shot(Scene *scene, Shot *shot)
+{
+    ShotResult result = {-1, false, false, false, false};
     Ball *target_ball = NULL;
-    for (int i = 1; i < game->scene.ball_set.num_balls; i++)
+    for (int i = 1; i < scene->ball_set.num_balls; i++)
     {
-        Ball *ball = &(game->scene.ball_set.balls[i]);
+        Ball *ball = &(scene->ball_set.balls[i]);
         if (!ball->pocketed)
         {
             target_ball = ball;
@@ -1035,45 +1139,79 @@ bool apply_game_rules(Game *game)
     }
     if (target_ball == NULL)
     {
-        game->current_player = (game->current_player + 1) % game->num_players;
-        game->consecutive_fouls++;
-        return false;
+        return result;
     }
-    Shot last_shot = game->frames[game->num_frames - 1].shot_history[game->frames[game->num_frames - 1].num_shots - 1];
-    bool ball_potted = false;
-    bool legal_first_hit = false;
-    bool nine_ball_potted = false;
-    bool cue_ball_potted = false;
-    for (int i = 0; i < last_shot.num_events; i++)
+    result.target_ball_id = target_ball->id;
+    for (int i = 0; i < shot->num_events; i++)
     {
-        ShotEvent event = last_shot.events[i];
-        if (event.type == BALL_BALL_COLLISION && ((event.ball1->id == 0 && event.ball2->id == target_ball->id) || (event.ball1->id == target_ball->id && event.ball2->id == 0)))
+        ShotEvent event = shot->events[i];
+        if (event.type == BALL_BALL_COLLISION && ((event_ball1(scene, event)->id == 0 && event_ball2(scene, event)->id == target_ball->id) || (event_ball1(scene, event)->id == target_ball->id && event_ball2(scene, event)->id == 0)))
         {
-            legal_first_hit = true;
+            result.legal_first_hit = true;
             break;
         }
     }
-    for (int i = 0; i < last_shot.num_events; i++)
+    for (int i = 0; i < shot->num_events; i++)
     {
-        ShotEvent event = last_shot.events[i];
+        ShotEvent event = shot->events[i];
         if (event.type == BALL_POCKETED)
         {
-            event.ball1->pocketed = true;
-            ball_potted = true;
-            if (event.ball1->id == 9)
+            result.ball_potted = true;
+            if (event_ball1(scene, event)->id == 9)
             {
-                nine_ball_potted = true;
+                result.nine_ball_potted = true;
             }
-            if (event.ball1->id == 0)
+            if (event_ball1(scene, event)->id == 0)
             {
-                cue_ball_potted = true;
+                result.cue_ball_potted = true;
             }
         }
     }
-    cue_ball->pocketed = false;
-    if (nine_ball_potted)
+    return result;
+}
+
+void mark_pocketed_balls(Scene *scene, Shot *shot)
+{
+    for (int i = 0; i < shot->num_events; i++)
+    {
+        ShotEvent event = shot->events[i];
+        if (event.type == BALL_POCKETED)
+        {
+            event_ball1(scene, event)->pocketed = true;
+        }
+    }
+    scene->ball_set.balls[0].pocketed = false;
+}
+
+bool apply_game_rules(Game *game)
+{
+    Frame *current_frame = &(game->frames[game->num_frames - 1]);
+    if (current_frame->num_shots >= 200)
+    {
+        current_frame->winner = &(game->players[(game->current_player + 1) % game->num_players]);
+        game->consecutive_fouls = 0;
+        setup_new_frame(game);
+        return false;
+    }
+    if (game->consecutive_fouls >= 3)
+    {
+        current_frame->winner = &(game->players[(game->current_player + 1) % game->num_players]);
+        game->consecutive_fouls = 0;
+        setup_new_frame(game);
+        return false;
+    }
+    Shot *last_shot = &(current_frame->shot_history[current_frame->num_shots - 1]);
+    ShotResult result = evaluate_shot(&(game->scene), last_shot);
+    if (result.target_ball_id < 0)
+    {
+        game->current_player = (game->current_player + 1) % game->num_players;
+        game->consecutive_fouls++;
+        return false;
+    }
+    mark_pocketed_balls(&(game->scene), last_shot);
+    if (result.nine_ball_potted)
     {
-        if (!legal_first_hit || cue_ball_potted)
+        if (!result.legal_first_hit || result.cue_ball_potted)
         {
             current_frame->winner = &(game->players[(game->current_player + 1) % game->num_players]);
         }
@@ -1084,25 +1222,25 @@ bool apply_game_rules(Game *game)
         game->consecutive_fouls = 0;
         setup_new_frame(game);
     }
-    if (!legal_first_hit)
+    if (!result.legal_first_hit)
     {
         game->current_player = (game->current_player + 1) % game->num_players;
         game->consecutive_fouls++;
         return false;
     }
-    if (!ball_potted)
+    if (!result.ball_potted)
     {
         game->current_player = (game->current_player + 1) % game->num_players;
         return false;
     }
-    if (legal_first_hit && cue_ball_potted)
+    if (result.legal_first_hit && result.cue_ball_potted)
     {
         game->current_player = (game->current_player + 1) % game->num_players;
         game->consecutive_fouls++;
         return false;
     }
     game->consecutive_fouls = 0;
-    return legal_first_hit && ball_potted;
+    return result.legal_first_hit && result.ball_potted;
 }
 
 void generate_shot(Game *game, Vector3 velocity, Vector3 angular_velocity)
@@ -1129,6 +1267,8 @@ void generate_shot(Game *game, Vector3 velocity, Vector3 angular_velocity)
         }
     }
     game->current_shot.end_time = end_time + 1;
+    game->current_shot.v = velocity;
+    game->current_shot.w = angular_velocity;
 }
 
 void clear_paths(Scene *scene)
@@ -1173,6 +1313,11 @@ Game *create_game(Player *players, int num_players)
     game->num_frames = 0;
     game->frame_capacity = 10;
     game->frames = malloc(sizeof(Frame) * game->frame_capacity);
+    game->seed = 0;
+    game->table_version = 0;
+    game->obstacle_index = create_obstacle_index();
+    game->geometry = create_table_geometry();
+    game->pocketability = create_pocketability();
     setup_new_frame(game);
     Shot shot;
     shot.ball_paths = malloc(game->scene.ball_set.num_balls * sizeof(Path));
@@ -1192,6 +1337,8 @@ Game *create_game(Player *players, int num_players)
 
     game->p1_stats = (Stats){0, 0, 0};
     game->p2_stats = (Stats){0, 0, 0};
+    game->stats_frame = 0;
+    game->stats_shot = 0;
     return game;
 }
 
@@ -1339,6 +1486,7 @@ void update_game(Game *game)
             ball->path.num_segments = 0;
         }
         clear_paths(&(game->scene));
+        refresh_table_state(game);
         game->time = 0;
         game->playback_speed = 0;
     }
@@ -1469,7 +1617,7 @@ void render_UI(Game *game, Vector3 v, Vector3 w)
             ShotEvent event = current_frame.shot_history[i].events[j];
             if (event.type == BALL_POCKETED)
             {
-                Ball *ball = event.ball1;
+                Ball *ball = event_ball1(&(game->scene), event);
                 DrawCircle(900, 20 + 30 * i, 10, ball->colour);
                 DrawText("Potted", 920, 10 + 30 * i, 20, WHITE);
                 break;
@@ -1494,33 +1642,33 @@ void render_UI(Game *game, Vector3 v, Vector3 w)
             }
             if (event.type == BALL_POCKETED)
             {
-                Ball *ball = event.ball1;
+                Ball *ball = event_ball1(&(game->scene), event);
                 DrawCircle(1100, 20 + 30 * i, 10, ball->colour);
                 DrawText("Potted", 1120, 10 + 30 * i, 20, colour);
             }
             if (event.type == BALL_BALL_COLLISION)
             {
-                Ball *ball1 = event.ball1;
-                Ball *ball2 = event.ball2;
+                Ball *ball1 = event_ball1(&(game->scene), event);
+                Ball *ball2 = event_ball2(&(game->scene), event);
                 DrawCircle(1100, 20 + 30 * i, 10, ball1->colour);
                 DrawCircle(1120, 20 + 30 * i, 10, ball2->colour);
                 DrawText("Collision", 1140, 10 + 30 * i, 20, colour);
             }
             if (event.type == BALL_CUSHION_COLLISION)
             {
-                Ball *ball = event.ball1;
+                Ball *ball = event_ball1(&(game->scene), event);
                 DrawCircle(1100, 20 + 30 * i, 10, ball->colour);
                 DrawText("Cushion Collision", 1120, 10 + 30 * i, 20, colour);
             }
             if (event.type == BALL_ROLL)
             {
-                Ball *ball = event.ball1;
+                Ball *ball = event_ball1(&(game->scene), event);
                 DrawCircle(1100, 20 + 30 * i, 10, ball->colour);
                 DrawText("Roll", 1120, 10 + 30 * i, 20, colour);
             }
             if (event.type == BALL_STOP)
             {
-                Ball *ball = event.ball1;
+                Ball *ball = event_ball1(&(game->scene), event);
                 DrawCircle(1100, 20 + 30 * i, 10, ball->colour);
                 DrawText("Stop", 1120, 10 + 30 * i, 20, colour);
             }
@@ -1,7 +1,9 @@
 #ifndef GAME_H
 #define GAME_H
 #include <raylib.h>
+#include <stdint.h>
 #include "player.h"
+#include "vec2.h"
 
 struct Game;
 
@@ -9,6 +11,10 @@ struct Ball;
 
 struct Player;
 
+struct ObstacleIndex;
+struct TableGeometry;
+struct Pocketability;
+
 typedef struct
 {
     Vector3 p1;
@@ -23,9 +29,9 @@ typedef struct
 
 typedef struct
 {
-    Vector3 initial_position;
-    Vector3 initial_velocity;
-    Vector3 acceleration;
+    Vec2 initial_position;
+    Vec2 initial_velocity;
+    Vec2 acceleration;
     Vector3 initial_angular_velocity;
     Vector3 angular_acceleration;
     bool rolling;
@@ -99,14 +105,18 @@ typedef enum
     BALL_STOP
 } ShotEventType;
 
+// Balls are indices into the scene's ball set and cushion_or_pocket indexes
+// the table's cushions for a cushion collision and its pockets for a pot.
+// Unused fields are -1. Events hold no pointers, so a shot's events can be
+// copied or written out as they are; the event_* functions resolve them.
 typedef struct
 {
-    ShotEventType type;
-    Ball *ball1;
-    Ball *ball2;
-    Cushion *cushion;
-    Pocket *pocket;
     double time;
+    uint8_t type;
+    int8_t reserved;
+    int16_t ball1;
+    int16_t ball2;
+    int16_t cushion_or_pocket;
 } ShotEvent;
 
 typedef struct
@@ -117,6 +127,8 @@ typedef struct
     int num_events;
     int event_capacity;
     double end_time;
+    Vector3 v;
+    Vector3 w;
 } Shot;
 
 typedef enum
@@ -149,6 +161,15 @@ typedef enum
     FOUL
 } ShotType;
 
+typedef struct
+{
+    int target_ball_id;
+    bool legal_first_hit;
+    bool ball_potted;
+    bool cue_ball_potted;
+    bool nine_ball_potted;
+} ShotResult;
+
 typedef struct Game
 {
     Scene scene;
@@ -175,6 +196,19 @@ typedef struct Game
 
     Stats p1_stats;
     Stats p2_stats;
+    // The stats cover every shot before this one.
+    int stats_frame;
+    int stats_shot;
+
+    // When non-zero, each new frame reseeds the random generators once its
+    // balls are racked, so play from then on depends only on the seed and
+    // the frame number.
+    unsigned int seed;
+
+    int table_version;
+    struct ObstacleIndex *obstacle_index;
+    struct TableGeometry *geometry;
+    struct Pocketability *pocketability;
 } Game;
 
 Game *create_game(struct Player *players, int num_players);
@@ -183,10 +217,56 @@ void update_game(Game *game);
 
 void render_game(Game *game);
 
+Vector3 world_to_screen(Vector3 position);
+
+int meters_to_pixels(double meters);
+
+void render_table(Table table);
+
+Table create_table();
+
 Scene create_scene();
 
+void free_ball_set(BallSet *ball_set);
+
 void generate_shot(Game *game, Vector3 v, Vector3 w);
 
 void clear_paths(Scene *scene);
 
+void simulate_paths(Game *game, Ball *ball, Vector3 initial_position, Vector3 initial_velocity, Vector3 initial_angular_velocity, double start_time);
+
+void simulate_paths_until(Game *game, Ball *ball, Vector3 initial_position, Vector3 initial_velocity, Vector3 initial_angular_velocity, double start_time, int max_events);
+
+ShotResult evaluate_shot(Scene *scene, Shot *shot);
+
+void mark_pocketed_balls(Scene *scene, Shot *shot);
+
+Vec2 get_position(PathSegment segment, double time);
+
+Vector3 get_ball_position(Ball ball, double time);
+
+Quaternion get_ball_orientation(Ball ball, double time);
+
+void add_orientation_to_path(Game *game);
+
+Vec2 get_velocity(PathSegment segment, double time);
+
+Vector3 get_angular_velocity(PathSegment segment, double time);
+
+Vec2 contact_point_velocity(Vec2 velocity, Vector3 angular_velocity, double radius);
+
+void refresh_table_state(Game *game);
+
+void seed_frame_random(Game *game);
+
+Ball *event_ball1(Scene *scene, ShotEvent event);
+
+Ball *event_ball2(Scene *scene, ShotEvent event);
+
+Cushion *event_cushion(Scene *scene, ShotEvent event);
+
+Pocket *event_pocket(Scene *scene, ShotEvent event);
+
+bool obstacle_index_is_current(Game *game);
+
 #endif // GAME_H
\ No newline at end of file
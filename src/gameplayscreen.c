@@ -7,10 +7,74 @@
 #include "pausescreen.h"
 #include "game.h"
 #include "serialise.h"
+#include "snapshot.h"
 
-void save_game(Game *game, char *filename)
+// Saves run in the background, so a press while one is still being
+// written is ignored.
+void save_game(GameplayScreen *gameplay_screen, char *replay_filename, char *snapshot_filename)
 {
-    serialise_game(game);
+    if (gameplay_screen->save != NULL)
+    {
+        int frames_written;
+        int num_frames;
+        if (game_save_progress(gameplay_screen->save, &frames_written, &num_frames) == SAVE_RUNNING)
+        {
+            return;
+        }
+        finish_game_save(gameplay_screen->save);
+    }
+    gameplay_screen->save = start_game_save(&gameplay_screen->game, replay_filename, snapshot_filename);
+    gameplay_screen->save_finished_at = 0;
+}
+
+void update_save_indicator(GameplayScreen *gameplay_screen)
+{
+    if (gameplay_screen->save == NULL)
+    {
+        return;
+    }
+    int frames_written;
+    int num_frames;
+    if (game_save_progress(gameplay_screen->save, &frames_written, &num_frames) == SAVE_RUNNING)
+    {
+        return;
+    }
+    if (gameplay_screen->save_finished_at == 0)
+    {
+        gameplay_screen->save_finished_at = GetTime();
+    }
+    else if (GetTime() - gameplay_screen->save_finished_at > 3)
+    {
+        finish_game_save(gameplay_screen->save);
+        gameplay_screen->save = NULL;
+    }
+}
+
+void render_save_indicator(GameplayScreen *gameplay_screen)
+{
+    if (gameplay_screen->save == NULL)
+    {
+        return;
+    }
+    int frames_written;
+    int num_frames;
+    SaveState state = game_save_progress(gameplay_screen->save, &frames_written, &num_frames);
+    char save_text[300];
+    if (state == SAVE_RUNNING)
+    {
+        sprintf(save_text, "Saving %.200s: %d/%d frames", gameplay_screen->save->replay_path, frames_written, num_frames);
+        DrawText(save_text, 10, GetScreenHeight() - 30, 20, YELLOW);
+    }
+    else if (state == SAVE_DONE)
+    {
+        sprintf(save_text, "Saved %.200s", gameplay_screen->save->replay_path);
+        DrawText(save_text, 10, GetScreenHeight() - 30, 20, GREEN);
+    }
+    else
+    {
+        sprintf(save_text, "Failed to save %.200s", gameplay_screen->save->replay_path);
+        DrawText(save_text, 10, GetScreenHeight() - 30, 20, RED);
+    }
 }
 
 void reload_player_modules(Game *game)
@@ -20,6 +84,10 @@ void reload_player_modules(Game *game)
     {
         printf("Reloading player %d\n", i);
         Player *player = &game->players[i];
+        if (player->module.library_path == NULL)
+        {
+            continue;
+        }
         if (player->module.handle != NULL)
         {
             printf("Closing handle\n");
@@ -53,7 +121,26 @@ Screen *create_gameplay_screen(Player *players, int num_players)
     gameplay_screen->base.render = render_gameplay_screen;
 
     gameplay_screen->game = *create_game(players, num_players);
+    gameplay_screen->save = NULL;
+    gameplay_screen->save_finished_at = 0;
+
+    return (Screen *)gameplay_screen;
+}
 
+Screen *load_gameplay_screen(char *path)
+{
+    Game *game = load_snapshot(path);
+    if (game == NULL)
+    {
+        return NULL;
+    }
+    reload_player_modules(game);
+    GameplayScreen *gameplay_screen = malloc(sizeof(GameplayScreen));
+    gameplay_screen->base.update = update_gameplay_screen;
+    gameplay_screen->base.render = render_gameplay_screen;
+    gameplay_screen->game = *game;
+    gameplay_screen->save = NULL;
+    gameplay_screen->save_finished_at = 0;
     return (Screen *)gameplay_screen;
 }
 
@@ -61,8 +148,13 @@ Screen *update_gameplay_screen(Screen *screen)
 {
     GameplayScreen *gameplay_screen = (GameplayScreen *)screen;
     update_game(&gameplay_screen->game);
+    update_save_indicator(gameplay_screen);
     if (IsKeyPressed(KEY_ESCAPE))
     {
+        if (gameplay_screen->save != NULL)
+        {
+            finish_game_save(gameplay_screen->save);
+        }
         for (int i = 0; i < gameplay_screen->game.num_players; i++)
         {
             if (gameplay_screen->game.players[i].module.handle != NULL)
@@ -83,7 +175,7 @@ Screen *update_gameplay_screen(Screen *screen)
     }
     if (IsKeyPressed(KEY_S))
     {
-        save_game(&gameplay_screen->game, "game.dat");
+        save_game(gameplay_screen, SAVED_REPLAY_PATH, SAVED_GAME_PATH);
     }
     return screen;
 }
@@ -92,4 +184,5 @@ void render_gameplay_screen(Screen *screen)
 {
     GameplayScreen *gameplay_screen = (GameplayScreen *)screen;
     render_game(&gameplay_screen->game);
+    render_save_indicator(gameplay_screen);
 }
\ No newline at end of file
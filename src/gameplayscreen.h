@@ -1,15 +1,25 @@
 #include "screen.h"
 #include "game.h"
+#include "serialise.h"
+
+#define SAVED_GAME_PATH "game.snap"
+#define SAVED_REPLAY_PATH "game.dat"
 
 typedef struct GameplayScreen
 {
     Screen base;
 
     Game game;
+
+    GameSave *save;
+    double save_finished_at;
 } GameplayScreen;
 
 Screen *create_gameplay_screen(Player *players, int num_players);
 
+// Resumes a game saved as a snapshot, or returns NULL if it can't be read.
+Screen *load_gameplay_screen(char *path);
+
 Screen *update_gameplay_screen(Screen *screen);
 
 void render_gameplay_screen(Screen *screen);
\ No newline at end of file
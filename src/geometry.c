@@ -0,0 +1,217 @@
+#include "geometry.h"
+#include <stdlib.h>
+#include <math.h>
+
+TableGeometry *create_table_geometry()
+{
+    TableGeometry *geometry = malloc(sizeof(TableGeometry));
+    geometry->version = -1;
+    geometry->ids = NULL;
+    geometry->x = NULL;
+    geometry->y = NULL;
+    geometry->num_balls = 0;
+    geometry->ball_capacity = 0;
+    geometry->pocket_aim_points = NULL;
+    geometry->num_pockets = 0;
+    geometry->aim_point_capacity = 0;
+    geometry->corridor_x = NULL;
+    geometry->corridor_y = NULL;
+    geometry->corridor_tangent_x = NULL;
+    geometry->corridor_tangent_y = NULL;
+    geometry->corridor_length = NULL;
+    geometry->corridor_width = NULL;
+    geometry->corridor_ignore = NULL;
+    geometry->corridor_capacity = 0;
+    return geometry;
+}
+
+void free_table_geometry(TableGeometry *geometry)
+{
+    free(geometry->ids);
+    free(geometry->x);
+    free(geometry->y);
+    free(geometry->pocket_aim_points);
+    free(geometry->corridor_x);
+    free(geometry->corridor_y);
+    free(geometry->corridor_tangent_x);
+    free(geometry->corridor_tangent_y);
+    free(geometry->corridor_length);
+    free(geometry->corridor_width);
+    free(geometry->corridor_ignore);
+    free(geometry);
+}
+
+void build_table_geometry(TableGeometry *geometry, Scene *scene, int version)
+{
+    int num_balls = scene->ball_set.num_balls;
+    int num_pockets = scene->table.num_pockets;
+    if (num_balls > geometry->ball_capacity)
+    {
+        geometry->ball_capacity = num_balls;
+        geometry->ids = realloc(geometry->ids, num_balls * sizeof(int));
+        geometry->x = realloc(geometry->x, num_balls * sizeof(float));
+        geometry->y = realloc(geometry->y, num_balls * sizeof(float));
+    }
+    if (num_balls * num_pockets > geometry->aim_point_capacity)
+    {
+        geometry->aim_point_capacity = num_balls * num_pockets;
+        geometry->pocket_aim_points = realloc(geometry->pocket_aim_points, geometry->aim_point_capacity * sizeof(Vector3));
+    }
+    for (int i = 0; i < num_balls; i++)
+    {
+        Ball *ball = &(scene->ball_set.balls[i]);
+        geometry->ids[i] = ball->id;
+        geometry->x[i] = ball->initial_position.x;
+        geometry->y[i] = ball->initial_position.y;
+        for (int j = 0; j < num_pockets; j++)
+        {
+            Vector3 pocket = scene->table.pockets[j].position;
+            geometry->pocket_aim_points[i * num_pockets + j] = ghost_ball_position(ball->initial_position, pocket, ball->radius);
+        }
+    }
+    geometry->num_balls = num_balls;
+    geometry->num_pockets = num_pockets;
+    geometry->version = version;
+}
+
+TableGeometry *get_table_geometry(Game *game)
+{
+    if (game->geometry->version != game->table_version)
+    {
+        build_table_geometry(game->geometry, &(game->scene), game->table_version);
+    }
+    return game->geometry;
+}
+
+void reserve_corridors(TableGeometry *geometry, int num_corridors)
+{
+    if (num_corridors <= geometry->corridor_capacity)
+    {
+        return;
+    }
+    int capacity = geometry->corridor_capacity == 0 ? 16 : geometry->corridor_capacity;
+    while (capacity < num_corridors)
+    {
+        capacity *= 2;
+    }
+    geometry->corridor_x = realloc(geometry->corridor_x, capacity * sizeof(float));
+    geometry->corridor_y = realloc(geometry->corridor_y, capacity * sizeof(float));
+    geometry->corridor_tangent_x = realloc(geometry->corridor_tangent_x, capacity * sizeof(float));
+    geometry->corridor_tangent_y = realloc(geometry->corridor_tangent_y, capacity * sizeof(float));
+    geometry->corridor_length = realloc(geometry->corridor_length, capacity * sizeof(float));
+    geometry->corridor_width = realloc(geometry->corridor_width, capacity * sizeof(double));
+    geometry->corridor_ignore = realloc(geometry->corridor_ignore, capacity * sizeof(int));
+    geometry->corridor_capacity = capacity;
+}
+
+Corridor ball_corridor(Vector3 p1, Vector3 p2, Ball *ball)
+{
+    return (Corridor){p1, p2, 2 * ball->radius, ball->id};
+}
+
+void prepare_corridors(TableGeometry *geometry, Corridor *corridors, int num_corridors)
+{
+    // Normalise every line once up front, in the same single precision the
+    // modules' raymath arithmetic used, so the per-ball loops are
+    // branch-free sweeps over flat arrays.
+    reserve_corridors(geometry, num_corridors);
+    for (int i = 0; i < num_corridors; i++)
+    {
+        Vector3 line = Vector3Subtract(corridors[i].p2, corridors[i].p1);
+        Vector3 tangent = Vector3Normalize(line);
+        geometry->corridor_x[i] = corridors[i].p1.x;
+        geometry->corridor_y[i] = corridors[i].p1.y;
+        geometry->corridor_tangent_x[i] = tangent.x;
+        geometry->corridor_tangent_y[i] = tangent.y;
+        geometry->corridor_length[i] = Vector3Length(line);
+        geometry->corridor_width[i] = corridors[i].half_width;
+        geometry->corridor_ignore[i] = corridors[i].ignore_id;
+    }
+}
+
+bool corridor_hits_ball(TableGeometry *geometry, int i, float x, float y, int id)
+{
+    float dx = x - geometry->corridor_x[i];
+    float dy = y - geometry->corridor_y[i];
+    float d_normal = dx * geometry->corridor_tangent_y[i] - dy * geometry->corridor_tangent_x[i];
+    float d_tangent = dx * geometry->corridor_tangent_x[i] + dy * geometry->corridor_tangent_y[i];
+    return (fabsf(d_normal) < geometry->corridor_width[i]) & (d_tangent > 0) & (d_tangent < geometry->corridor_length[i]) & (id != geometry->corridor_ignore[i]);
+}
+
+void corridors_blocked(Game *game, Corridor *corridors, int num_corridors, bool *blocked)
+{
+    TableGeometry *geometry = get_table_geometry(game);
+    prepare_corridors(geometry, corridors, num_corridors);
+    for (int i = 0; i < num_corridors; i++)
+    {
+        blocked[i] = false;
+    }
+    for (int b = 0; b < geometry->num_balls; b++)
+    {
+        float x = geometry->x[b];
+        float y = geometry->y[b];
+        int id = geometry->ids[b];
+        for (int i = 0; i < num_corridors; i++)
+        {
+            blocked[i] |= corridor_hits_ball(geometry, i, x, y, id);
+        }
+    }
+}
+
+int corridor_blockers(Game *game, Corridor corridor, int *blockers)
+{
+    TableGeometry *geometry = get_table_geometry(game);
+    prepare_corridors(geometry, &corridor, 1);
+    int num_blockers = 0;
+    for (int b = 0; b < geometry->num_balls; b++)
+    {
+        if (corridor_hits_ball(geometry, 0, geometry->x[b], geometry->y[b], geometry->ids[b]))
+        {
+            blockers[num_blockers++] = b;
+        }
+    }
+    return num_blockers;
+}
+
+bool line_is_blocked(Game *game, Vector3 p1, Vector3 p2, Ball *ball)
+{
+    Corridor corridor = ball_corridor(p1, p2, ball);
+    bool blocked;
+    corridors_blocked(game, &corridor, 1, &blocked);
+    return blocked;
+}
+
+Vector3 ghost_ball_position(Vector3 object_ball, Vector3 target, double radius)
+{
+    return Vector3Subtract(object_ball, Vector3Scale(Vector3Normalize(Vector3Subtract(target, object_ball)), 2 * radius));
+}
+
+Vector3 pocket_aim_point(Game *game, Ball *ball, int pocket)
+{
+    TableGeometry *geometry = get_table_geometry(game);
+    int i = ball - game->scene.ball_set.balls;
+    return geometry->pocket_aim_points[i * geometry->num_pockets + pocket];
+}
+
+double cut_cosine(Vector3 cue_ball, Vector3 aim_point, Vector3 object_ball, Vector3 target)
+{
+    return Vector3DotProduct(Vector3Normalize(Vector3Subtract(aim_point, cue_ball)), Vector3Normalize(Vector3Subtract(target, object_ball)));
+}
+
+Vector3 cushion_normal(Cushion cushion)
+{
+    return Vector3Normalize(Vector3CrossProduct(Vector3Subtract(cushion.p2, cushion.p1), (Vector3){0, 0, 1}));
+}
+
+Vector3 reflect_in_cushion(Vector3 point, Cushion cushion)
+{
+    Vector3 normal = cushion_normal(cushion);
+    return Vector3Subtract(point, Vector3Scale(normal, 2 * Vector3DotProduct(normal, Vector3Subtract(point, cushion.p1))));
+}
+
+Vector3 cushion_contact_point(Vector3 from, Vector3 image, Cushion cushion)
+{
+    Vector3 normal = cushion_normal(cushion);
+    Vector3 line = Vector3Subtract(image, from);
+    return Vector3Add(from, Vector3Scale(line, Vector3DotProduct(Vector3Subtract(cushion.p1, from), normal) / Vector3DotProduct(line, normal)));
+}
@@ -0,0 +1,72 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+#include "game.h"
+
+// Flat copy of the resting table used by the player modules' aiming code.
+// It is rebuilt lazily the first time it is asked for after the table
+// version changes, so every query made while choosing a shot shares it.
+typedef struct TableGeometry
+{
+    int version;
+
+    int *ids;
+    float *x;
+    float *y;
+    int num_balls;
+    int ball_capacity;
+
+    // Ghost ball position for every ball and pocket, ball-major.
+    Vector3 *pocket_aim_points;
+    int num_pockets;
+    int aim_point_capacity;
+
+    float *corridor_x;
+    float *corridor_y;
+    float *corridor_tangent_x;
+    float *corridor_tangent_y;
+    float *corridor_length;
+    double *corridor_width;
+    int *corridor_ignore;
+    int corridor_capacity;
+} TableGeometry;
+
+// The straight path of a ball of half_width / 2 radius from p1 to p2. It is
+// blocked by any other ball whose centre lies within half_width of the line
+// between the two points.
+typedef struct
+{
+    Vector3 p1;
+    Vector3 p2;
+    double half_width;
+    int ignore_id;
+} Corridor;
+
+TableGeometry *create_table_geometry();
+
+void build_table_geometry(TableGeometry *geometry, Scene *scene, int version);
+
+void free_table_geometry(TableGeometry *geometry);
+
+TableGeometry *get_table_geometry(Game *game);
+
+Corridor ball_corridor(Vector3 p1, Vector3 p2, Ball *ball);
+
+void corridors_blocked(Game *game, Corridor *corridors, int num_corridors, bool *blocked);
+
+int corridor_blockers(Game *game, Corridor corridor, int *blockers);
+
+bool line_is_blocked(Game *game, Vector3 p1, Vector3 p2, Ball *ball);
+
+Vector3 ghost_ball_position(Vector3 object_ball, Vector3 target, double radius);
+
+Vector3 pocket_aim_point(Game *game, Ball *ball, int pocket);
+
+double cut_cosine(Vector3 cue_ball, Vector3 aim_point, Vector3 object_ball, Vector3 target);
+
+Vector3 cushion_normal(Cushion cushion);
+
+Vector3 reflect_in_cushion(Vector3 point, Cushion cushion);
+
+Vector3 cushion_contact_point(Vector3 from, Vector3 image, Cushion cushion);
+
+#endif // GEOMETRY_H
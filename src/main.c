@@ -14,6 +14,7 @@
 #include "mainmenuscreen.h"
 #include "selectscreen.h"
 #include "gameplayscreen.h"
+#include "replayscreen.h"
 #include "game.h"
 #include "player.h"
 
@@ -34,12 +35,23 @@ void render_app(App *app)
     EndDrawing();
 }
 
-void init_app(App *app)
+// A replay named on the command line is opened straight away, and the menu
+// offers it again when the replay screen is left.
+void init_app(App *app, char *replay_path)
 {
-    app->current_screen = create_main_menu_screen();
+    app->current_screen = NULL;
+    if (replay_path != NULL)
+    {
+        set_main_menu_replay_path(replay_path);
+        app->current_screen = create_replay_screen(replay_path);
+    }
+    if (app->current_screen == NULL)
+    {
+        app->current_screen = create_main_menu_screen();
+    }
 }
 
-int main()
+int main(int argc, char *argv[])
 {
     const int SCREEN_WIDTH = 1640;
     const int SCREEN_HEIGHT = 900;
@@ -50,7 +62,7 @@ int main()
 
     SetTargetFPS(60);
     App app;
-    init_app(&app);
+    init_app(&app, argc > 1 ? argv[1] : NULL);
 
     while (!WindowShouldClose())
     {
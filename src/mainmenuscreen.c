@@ -2,20 +2,74 @@
 #include "selectscreen.h"
 #include "selectalgoscreen.h"
 #include "algotestscreen.h"
+#include "gameplayscreen.h"
+#include "replayscreen.h"
 #include "player.h"
 #include <raylib.h>
 #include <stdlib.h>
+#include <string.h>
+
+char main_menu_replay_path[MAX_REPLAY_PATH] = SAVED_REPLAY_PATH;
+
+void set_main_menu_replay_path(char *path)
+{
+    strncpy(main_menu_replay_path, path, MAX_REPLAY_PATH - 1);
+    main_menu_replay_path[MAX_REPLAY_PATH - 1] = '\0';
+}
 
 Screen *create_main_menu_screen()
 {
     MainMenuScreen *screen = (MainMenuScreen *)malloc(sizeof(MainMenuScreen));
     screen->base.update = update_main_menu_screen;
     screen->base.render = render_main_menu_screen;
+    screen->entering_replay_path = false;
+    screen->replay_failed = false;
     return (Screen *)screen;
 }
 
+Screen *update_replay_path_prompt(MainMenuScreen *menu)
+{
+    int length = strlen(main_menu_replay_path);
+    int key;
+    while ((key = GetCharPressed()) > 0)
+    {
+        if (key >= 32 && key < 127 && length + 1 < MAX_REPLAY_PATH)
+        {
+            main_menu_replay_path[length++] = key;
+            main_menu_replay_path[length] = '\0';
+            menu->replay_failed = false;
+        }
+    }
+    if (IsKeyPressed(KEY_BACKSPACE) && length > 0)
+    {
+        main_menu_replay_path[--length] = '\0';
+        menu->replay_failed = false;
+    }
+    if (IsKeyPressed(KEY_ESCAPE))
+    {
+        menu->entering_replay_path = false;
+        menu->replay_failed = false;
+    }
+    if (IsKeyPressed(KEY_ENTER))
+    {
+        Screen *replay_screen = create_replay_screen(main_menu_replay_path);
+        if (replay_screen != NULL)
+        {
+            free(menu);
+            return replay_screen;
+        }
+        menu->replay_failed = true;
+    }
+    return (Screen *)menu;
+}
+
 Screen *update_main_menu_screen(Screen *screen)
 {
+    MainMenuScreen *menu = (MainMenuScreen *)screen;
+    if (menu->entering_replay_path)
+    {
+        return update_replay_path_prompt(menu);
+    }
     if (IsKeyPressed(KEY_ESCAPE))
     {
         free(screen);
@@ -33,6 +87,19 @@ Screen *update_main_menu_screen(Screen *screen)
         free(screen);
         return (Screen *)select_algo_screen;
     }
+    if (IsKeyPressed(KEY_L))
+    {
+        Screen *gameplay_screen = load_gameplay_screen(SAVED_GAME_PATH);
+        if (gameplay_screen != NULL)
+        {
+            free(screen);
+            return gameplay_screen;
+        }
+    }
+    if (IsKeyPressed(KEY_V))
+    {
+        menu->entering_replay_path = true;
+    }
     if (IsKeyPressed(KEY_B))
     {
         Player player = {.type = HUMAN};
@@ -46,8 +113,20 @@ Screen *update_main_menu_screen(Screen *screen)
 
 void render_main_menu_screen(Screen *screen)
 {
-    (void)screen;
+    MainMenuScreen *menu = (MainMenuScreen *)screen;
     ClearBackground(RAYWHITE);
     DrawText("Main Menu", 190, 200, 20, DARKGRAY);
+    if (menu->entering_replay_path)
+    {
+        DrawText(TextFormat("Replay to watch: %s_", main_menu_replay_path), 180, 220, 20, DARKGRAY);
+        DrawText("Press Enter to open it, Esc to go back", 180, 240, 20, DARKGRAY);
+        if (menu->replay_failed)
+        {
+            DrawText(TextFormat("%s could not be opened as a replay", main_menu_replay_path), 180, 260, 20, RED);
+        }
+        return;
+    }
     DrawText("Press Enter to start", 180, 220, 20, DARKGRAY);
+    DrawText("Press L to resume the saved game", 180, 240, 20, DARKGRAY);
+    DrawText("Press V to watch a replay", 180, 260, 20, DARKGRAY);
 }
@@ -1,10 +1,22 @@
 #include "screen.h"
+#include <stdbool.h>
 
+#define MAX_REPLAY_PATH 256
+
+// V asks for the replay to watch, starting from the last one asked for.
 typedef struct
 {
     Screen base;
+    bool entering_replay_path;
+    bool replay_failed;
 } MainMenuScreen;
 
+// The path the replay prompt starts from. It begins as the replay the
+// gameplay screen saves and main sets it from the command line.
+extern char main_menu_replay_path[MAX_REPLAY_PATH];
+
+void set_main_menu_replay_path(char *path);
+
 Screen *create_main_menu_screen();
 
 Screen *update_main_menu_screen(Screen *screen);
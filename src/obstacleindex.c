@@ -0,0 +1,410 @@
+#include "obstacleindex.h"
+#include "polynomial.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+ObstacleIndex *create_obstacle_index()
+{
+    ObstacleIndex *index = malloc(sizeof(ObstacleIndex));
+    index->version = -1;
+    index->num_columns = 0;
+    index->num_rows = 0;
+    index->cell_capacity = 0;
+    index->cell_start = NULL;
+    index->cell_ball_capacity = 0;
+    index->cell_balls = NULL;
+    index->num_balls = 0;
+    index->ball_capacity = 0;
+    index->ball_indices = NULL;
+    index->x = NULL;
+    index->y = NULL;
+    index->radius = NULL;
+    return index;
+}
+
+void free_obstacle_index(ObstacleIndex *index)
+{
+    free(index->cell_start);
+    free(index->cell_balls);
+    free(index->ball_indices);
+    free(index->x);
+    free(index->y);
+    free(index->radius);
+    free(index);
+}
+
+void obstacle_cell_range(ObstacleIndex *index, double x, double y, double reach, int *c0, int *r0, int *c1, int *r1)
+{
+    *c0 = (int)floor((x - reach - index->min_x) / index->cell_size);
+    *r0 = (int)floor((y - reach - index->min_y) / index->cell_size);
+    *c1 = (int)floor((x + reach - index->min_x) / index->cell_size);
+    *r1 = (int)floor((y + reach - index->min_y) / index->cell_size);
+    *c0 = *c0 < 0 ? 0 : *c0;
+    *r0 = *r0 < 0 ? 0 : *r0;
+    *c1 = *c1 >= index->num_columns ? index->num_columns - 1 : *c1;
+    *r1 = *r1 >= index->num_rows ? index->num_rows - 1 : *r1;
+}
+
+int obstacle_cell_at(ObstacleIndex *index, Vec2 p)
+{
+    int column = (int)floor((p.x - index->min_x) / index->cell_size);
+    int row = (int)floor((p.y - index->min_y) / index->cell_size);
+    if (column < 0 || row < 0 || column >= index->num_columns || row >= index->num_rows)
+    {
+        return -1;
+    }
+    return row * index->num_columns + column;
+}
+
+void build_obstacle_index(ObstacleIndex *index, Scene *scene, int version)
+{
+    Table *table = &(scene->table);
+    BallSet *ball_set = &(scene->ball_set);
+    double min_x = INFINITY;
+    double min_y = INFINITY;
+    double max_x = -INFINITY;
+    double max_y = -INFINITY;
+    for (int i = 0; i < table->num_cushions; i++)
+    {
+        Cushion cushion = table->cushions[i];
+        min_x = fmin(min_x, fmin(cushion.p1.x, cushion.p2.x));
+        min_y = fmin(min_y, fmin(cushion.p1.y, cushion.p2.y));
+        max_x = fmax(max_x, fmax(cushion.p1.x, cushion.p2.x));
+        max_y = fmax(max_y, fmax(cushion.p1.y, cushion.p2.y));
+    }
+    double max_radius = 0;
+    for (int i = 0; i < ball_set->num_balls; i++)
+    {
+        max_radius = fmax(max_radius, ball_set->balls[i].radius);
+    }
+    index->version = version;
+    index->cell_size = 4 * max_radius;
+    index->min_x = min_x - index->cell_size;
+    index->min_y = min_y - index->cell_size;
+    index->num_columns = (int)ceil((max_x - min_x) / index->cell_size) + 2;
+    index->num_rows = (int)ceil((max_y - min_y) / index->cell_size) + 2;
+
+    int num_cells = index->num_columns * index->num_rows;
+    if (num_cells + 1 > index->cell_capacity)
+    {
+        index->cell_capacity = num_cells + 1;
+        index->cell_start = realloc(index->cell_start, index->cell_capacity * sizeof(int));
+    }
+    if (ball_set->num_balls > index->ball_capacity)
+    {
+        index->ball_capacity = ball_set->num_balls;
+        index->ball_indices = realloc(index->ball_indices, index->ball_capacity * sizeof(int));
+        index->x = realloc(index->x, index->ball_capacity * sizeof(double));
+        index->y = realloc(index->y, index->ball_capacity * sizeof(double));
+        index->radius = realloc(index->radius, index->ball_capacity * sizeof(double));
+    }
+
+    index->num_balls = 0;
+    for (int i = 0; i < ball_set->num_balls; i++)
+    {
+        Ball *ball = &(ball_set->balls[i]);
+        Vector3 p = ball->initial_position;
+        if (p.x < min_x || p.x > max_x || p.y < min_y || p.y > max_y)
+        {
+            continue;
+        }
+        index->ball_indices[index->num_balls] = i;
+        index->x[index->num_balls] = p.x;
+        index->y[index->num_balls] = p.y;
+        index->radius[index->num_balls] = ball->radius;
+        index->num_balls++;
+    }
+
+    // A centre that comes within two radii of a ball touches it. Queries sample
+    // the path at most half a cell apart, so the reach is padded by that much.
+    double reach = 2 * max_radius + 0.5 * index->cell_size;
+    memset(index->cell_start, 0, (num_cells + 1) * sizeof(int));
+    for (int i = 0; i < index->num_balls; i++)
+    {
+        int c0, r0, c1, r1;
+        obstacle_cell_range(index, index->x[i], index->y[i], reach, &c0, &r0, &c1, &r1);
+        for (int r = r0; r <= r1; r++)
+        {
+            for (int c = c0; c <= c1; c++)
+            {
+                index->cell_start[r * index->num_columns + c + 1]++;
+            }
+        }
+    }
+    for (int i = 0; i < num_cells; i++)
+    {
+        index->cell_start[i + 1] += index->cell_start[i];
+    }
+    int total = index->cell_start[num_cells];
+    if (total > index->cell_ball_capacity)
+    {
+        index->cell_ball_capacity = total;
+        index->cell_balls = realloc(index->cell_balls, index->cell_ball_capacity * sizeof(int));
+    }
+    int *fill = malloc(num_cells * sizeof(int));
+    memcpy(fill, index->cell_start, num_cells * sizeof(int));
+    for (int i = 0; i < index->num_balls; i++)
+    {
+        int c0, r0, c1, r1;
+        obstacle_cell_range(index, index->x[i], index->y[i], reach, &c0, &r0, &c1, &r1);
+        for (int r = r0; r <= r1; r++)
+        {
+            for (int c = c0; c <= c1; c++)
+            {
+                index->cell_balls[fill[r * index->num_columns + c]++] = i;
+            }
+        }
+    }
+    free(fill);
+}
+
+double segment_sample_step(ObstacleIndex *index, PathSegment *segment)
+{
+    double duration = segment->end_time - segment->start_time;
+    if (isinf(duration) || duration <= 0)
+    {
+        return 0;
+    }
+    double max_speed = Vec2Length(segment->initial_velocity) + Vec2Length(segment->acceleration) * duration;
+    if (max_speed == 0)
+    {
+        return 0;
+    }
+    return 0.5 * index->cell_size / max_speed;
+}
+
+int compare_ints(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+int query_obstacle_candidates(ObstacleIndex *index, PathSegment *segment, int ignore_ball, int *candidates, int max_candidates)
+{
+    unsigned char seen[index->num_balls + 1];
+    memset(seen, 0, sizeof(seen));
+    int num_candidates = 0;
+    double dt = segment_sample_step(index, segment);
+    // Samples are never more than half a cell apart. The walk stops where the
+    // centre leaves the grid, since it has crossed a cushion by then.
+    for (int k = 0;; k++)
+    {
+        double t = segment->start_time + k * dt;
+        bool last = dt == 0 || t >= segment->end_time;
+        if (last)
+        {
+            t = dt == 0 ? segment->start_time : segment->end_time;
+        }
+        int cell = obstacle_cell_at(index, get_position(*segment, t));
+        if (cell < 0)
+        {
+            break;
+        }
+        for (int i = index->cell_start[cell]; i < index->cell_start[cell + 1]; i++)
+        {
+            int slot = index->cell_balls[i];
+            int ball = index->ball_indices[slot];
+            if (seen[slot] || ball == ignore_ball)
+            {
+                continue;
+            }
+            seen[slot] = 1;
+            if (num_candidates < max_candidates)
+            {
+                candidates[num_candidates++] = ball;
+            }
+        }
+        if (last)
+        {
+            break;
+        }
+    }
+    qsort(candidates, num_candidates, sizeof(int), compare_ints);
+    return num_candidates;
+}
+
+bool segment_circle_collision(PathSegment *segment, double x, double y, double radius, double *t)
+{
+    Vec2 p1 = segment->initial_position;
+    Vec2 v1 = segment->initial_velocity;
+    Vec2 a1 = segment->acceleration;
+    double t1 = segment->start_time;
+
+    double A1 = 0.5 * a1.x;
+    double B1 = v1.x - a1.x * t1;
+    double C1 = p1.x - v1.x * t1 + 0.5 * a1.x * t1 * t1 - x;
+
+    double A3 = 0.5 * a1.y;
+    double B3 = v1.y - a1.y * t1;
+    double C3 = p1.y - v1.y * t1 + 0.5 * a1.y * t1 * t1 - y;
+
+    double a = A1 * A1 + A3 * A3;
+    double b = 2 * (A1 * B1 + A3 * B3);
+    double c = 2 * (A1 * C1 + A3 * C3) + B1 * B1 + B3 * B3;
+    double d = 2 * (B1 * C1 + B3 * C3);
+    double e = C1 * C1 + C3 * C3 - radius * radius;
+
+    double roots[4];
+    solve_quartic(a, b, c, d, e, &roots[0], &roots[1], &roots[2], &roots[3]);
+    double collision_time = INFINITY;
+    for (int i = 0; i < 4; i++)
+    {
+        if (roots[i] > segment->start_time && roots[i] < segment->end_time && roots[i] < collision_time)
+        {
+            collision_time = roots[i];
+        }
+    }
+    if (collision_time == INFINITY)
+    {
+        return false;
+    }
+    *t = collision_time;
+    return true;
+}
+
+bool segment_cushion_collision(PathSegment *segment, Cushion *cushion, double *t)
+{
+    Vec2 cushion_p1 = Vec2FromVector3(cushion->p1);
+    Vec2 line_normal = Vec2LineNormal(cushion_p1, Vec2FromVector3(cushion->p2));
+    double sn = Vec2DotProduct(Vec2Subtract(cushion_p1, segment->initial_position), line_normal);
+    double vn = Vec2DotProduct(segment->initial_velocity, line_normal);
+    double an = Vec2DotProduct(segment->acceleration, line_normal);
+    double roots[2];
+    if (an == 0)
+    {
+        if (vn == 0)
+        {
+            return false;
+        }
+        roots[0] = roots[1] = sn / vn;
+    }
+    else
+    {
+        double discriminant = vn * vn + 2 * an * sn;
+        if (discriminant < 0)
+        {
+            return false;
+        }
+        roots[0] = (-vn + sqrt(discriminant)) / an;
+        roots[1] = (-vn - sqrt(discriminant)) / an;
+    }
+    double collision_time = INFINITY;
+    for (int i = 0; i < 2; i++)
+    {
+        double time = segment->start_time + roots[i];
+        if (time > segment->start_time && time < segment->end_time && time < collision_time)
+        {
+            collision_time = time;
+        }
+    }
+    if (collision_time == INFINITY)
+    {
+        return false;
+    }
+    *t = collision_time;
+    return true;
+}
+
+bool find_first_contact(ObstacleIndex *index, Scene *scene, PathSegment *segments, int num_segments, double radius, int ignore_ball, FirstContact *contact)
+{
+    unsigned char seen[index->num_balls + 1];
+    for (int s = 0; s < num_segments; s++)
+    {
+        PathSegment *segment = &(segments[s]);
+        memset(seen, 0, sizeof(seen));
+        FirstContact best = {NONE, -1, -1, INFINITY};
+        double time;
+        for (int i = 0; i < scene->table.num_cushions; i++)
+        {
+            if (segment_cushion_collision(segment, &(scene->table.cushions[i]), &time) && time < best.time)
+            {
+                best = (FirstContact){BALL_CUSHION_COLLISION, -1, i, time};
+            }
+        }
+
+        double dt = segment_sample_step(index, segment);
+        for (int k = 0;; k++)
+        {
+            double t = segment->start_time + k * dt;
+            bool last = dt == 0 || t >= segment->end_time;
+            if (last)
+            {
+                t = dt == 0 ? segment->start_time : segment->end_time;
+            }
+            // Any ball reached before the best contact so far is seen by the
+            // first sample after that contact.
+            if (t > best.time + dt)
+            {
+                break;
+            }
+            int cell = obstacle_cell_at(index, get_position(*segment, t));
+            if (cell < 0)
+            {
+                break;
+            }
+            for (int i = index->cell_start[cell]; i < index->cell_start[cell + 1]; i++)
+            {
+                int slot = index->cell_balls[i];
+                int ball = index->ball_indices[slot];
+                if (seen[slot] || ball == ignore_ball)
+                {
+                    continue;
+                }
+                seen[slot] = 1;
+                if (segment_circle_collision(segment, index->x[slot], index->y[slot], radius + index->radius[slot], &time) && time < best.time)
+                {
+                    best = (FirstContact){BALL_BALL_COLLISION, ball, -1, time};
+                }
+            }
+            if (last)
+            {
+                break;
+            }
+        }
+        if (best.type != NONE)
+        {
+            *contact = best;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool cue_ball_first_contact(Game *game, Vector3 v, Vector3 w, FirstContact *contact)
+{
+    if (!obstacle_index_is_current(game))
+    {
+        return false;
+    }
+    Scene *scene = &(game->scene);
+    Ball *cue_ball = &(scene->ball_set.balls[0]);
+    double mu_slide = scene->coefficients.mu_slide;
+    double mu_roll = scene->coefficients.mu_roll;
+    double g = scene->coefficients.g;
+    double R = cue_ball->radius;
+
+    PathSegment segments[2];
+    Vec2 velocity = Vec2FromVector3(v);
+    Vec2 contact_point_v = contact_point_velocity(velocity, w, R);
+    Vec2 acceleration = Vec2Scale(Vec2Normalize(contact_point_v), -mu_slide * g);
+    double end_time = 2 * Vec2Length(contact_point_v) / (7 * mu_slide * g);
+    segments[0] = (PathSegment){Vec2FromVector3(cue_ball->initial_position), velocity, acceleration, w, {0, 0, 0}, false, 0, end_time, NULL};
+
+    Vec2 roll_position = get_position(segments[0], end_time);
+    Vec2 roll_velocity = Vec2Add(velocity, Vec2Scale(acceleration, end_time));
+    Vec2 roll_acceleration = Vec2Scale(Vec2Normalize(roll_velocity), -mu_roll * g);
+    double stop_time = end_time + Vec2Length(roll_velocity) / (mu_roll * g);
+    segments[1] = (PathSegment){roll_position, roll_velocity, roll_acceleration, {0, 0, 0}, {0, 0, 0}, true, end_time, stop_time, NULL};
+
+    return find_first_contact(game->obstacle_index, scene, segments, 2, R, 0, contact);
+}
+
+bool strike_hits_ball_first(Game *game, int ball, Vector3 v, Vector3 w)
+{
+    if (!obstacle_index_is_current(game))
+    {
+        return true;
+    }
+    FirstContact contact;
+    return cue_ball_first_contact(game, v, w, &contact) && contact.type == BALL_BALL_COLLISION && contact.ball == ball;
+}
@@ -0,0 +1,58 @@
+#ifndef OBSTACLEINDEX_H
+#define OBSTACLEINDEX_H
+#include "game.h"
+
+// Uniform grid over the balls that are resting on the table at the start of a
+// shot. Each ball is filed under every cell within reach of a ball centre that
+// touches it, so a moving ball only needs to look at the cells its centre
+// passes through.
+typedef struct ObstacleIndex
+{
+    int version;
+
+    double min_x;
+    double min_y;
+    double cell_size;
+    int num_columns;
+    int num_rows;
+
+    int *cell_start;
+    int *cell_balls;
+    int cell_ball_capacity;
+    int cell_capacity;
+
+    int *ball_indices;
+    double *x;
+    double *y;
+    double *radius;
+    int num_balls;
+    int ball_capacity;
+} ObstacleIndex;
+
+typedef struct
+{
+    ShotEventType type;
+    int ball;
+    int cushion;
+    double time;
+} FirstContact;
+
+ObstacleIndex *create_obstacle_index();
+
+void build_obstacle_index(ObstacleIndex *index, Scene *scene, int version);
+
+void free_obstacle_index(ObstacleIndex *index);
+
+int query_obstacle_candidates(ObstacleIndex *index, PathSegment *segment, int ignore_ball, int *candidates, int max_candidates);
+
+bool find_first_contact(ObstacleIndex *index, Scene *scene, PathSegment *segments, int num_segments, double radius, int ignore_ball, FirstContact *contact);
+
+bool cue_ball_first_contact(Game *game, Vector3 v, Vector3 w, FirstContact *contact);
+
+// Answers a player's aim query from the index: whether the cue ball struck
+// with v and w touches the ball at index ball before any other ball or
+// cushion. When the index is out of date nothing is known and the strike is
+// let through.
+bool strike_hits_ball_first(Game *game, int ball, Vector3 v, Vector3 w);
+
+#endif // OBSTACLEINDEX_H
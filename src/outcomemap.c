@@ -0,0 +1,352 @@
+#include "outcomemap.h"
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+OutcomeMap *create_outcome_map(int num_threads)
+{
+    if (num_threads <= 0)
+    {
+        num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (num_threads <= 0)
+    {
+        num_threads = 1;
+    }
+    OutcomeMap *map = malloc(sizeof(OutcomeMap));
+    map->max_depth = 8;
+    map->max_rest_depth = 3;
+    map->rest_tolerance = 0.25;
+    map->table_version = -1;
+    map->sample_capacity = 256;
+    map->samples = malloc(map->sample_capacity * sizeof(OutcomeSample));
+    map->num_samples = 0;
+    map->cell_capacity = 256;
+    map->cells = malloc(map->cell_capacity * sizeof(OutcomeCell));
+    map->num_cells = 0;
+    map->next_cell = 0;
+    map->next_sample = 0;
+    map->num_threads = num_threads;
+    map->workers = malloc(num_threads * sizeof(OutcomeWorker));
+    for (int i = 0; i < num_threads; i++)
+    {
+        map->workers[i].fork = create_game_fork(10);
+        map->workers[i].map = map;
+    }
+    return map;
+}
+
+void free_outcome_map(OutcomeMap *map)
+{
+    for (int i = 0; i < map->num_threads; i++)
+    {
+        free_game_fork(map->workers[i].fork);
+    }
+    free(map->workers);
+    free(map->samples);
+    free(map->cells);
+    free(map);
+}
+
+int add_outcome_sample(OutcomeMap *map, double angle, double speed, double spin)
+{
+    if (map->num_samples == map->sample_capacity)
+    {
+        map->sample_capacity *= 2;
+        map->samples = realloc(map->samples, map->sample_capacity * sizeof(OutcomeSample));
+    }
+    OutcomeSample *sample = &(map->samples[map->num_samples]);
+    sample->angle = angle;
+    sample->speed = speed;
+    sample->spin = spin;
+    sample->done = false;
+    sample->first_contact = -1;
+    sample->pocketed = 0;
+    sample->rest_position = (Vector3){0, 0, 0};
+    return map->num_samples++;
+}
+
+OutcomeCell *add_outcome_cell(OutcomeMap *map)
+{
+    if (map->num_cells == map->cell_capacity)
+    {
+        map->cell_capacity *= 2;
+        map->cells = realloc(map->cells, map->cell_capacity * sizeof(OutcomeCell));
+    }
+    return &(map->cells[map->num_cells++]);
+}
+
+void reset_outcome_map(OutcomeMap *map, Game *game, double min_speed, double max_speed, double max_spin, int grid_size)
+{
+    map->min[0] = 0;
+    map->max[0] = 2 * PI;
+    map->min[1] = min_speed;
+    map->max[1] = max_speed;
+    map->min[2] = -max_spin;
+    map->max[2] = max_spin;
+    map->table_version = game->table_version;
+    map->num_samples = 0;
+    map->num_cells = 0;
+    map->next_cell = 0;
+    map->next_sample = 0;
+
+    // The coarse grid is finest in angle, where outcomes change fastest. A
+    // map without spin has a single spin layer and flat cells.
+    int n[3] = {grid_size + 1, grid_size / 2 + 1, max_spin > 0 ? 3 : 1};
+    if (n[1] < 2)
+    {
+        n[1] = 2;
+    }
+    double step[3];
+    for (int d = 0; d < 3; d++)
+    {
+        step[d] = n[d] > 1 ? (map->max[d] - map->min[d]) / (n[d] - 1) : 0;
+    }
+    for (int i = 0; i < n[0]; i++)
+    {
+        for (int j = 0; j < n[1]; j++)
+        {
+            for (int k = 0; k < n[2]; k++)
+            {
+                add_outcome_sample(map, map->min[0] + i * step[0], map->min[1] + j * step[1], map->min[2] + k * step[2]);
+            }
+        }
+    }
+
+    int num_layers = n[2] > 1 ? n[2] - 1 : 1;
+    for (int i = 0; i < n[0] - 1; i++)
+    {
+        for (int j = 0; j < n[1] - 1; j++)
+        {
+            for (int k = 0; k < num_layers; k++)
+            {
+                OutcomeCell *cell = add_outcome_cell(map);
+                int index[3] = {i, j, k};
+                for (int d = 0; d < 3; d++)
+                {
+                    cell->min[d] = map->min[d] + index[d] * step[d];
+                    cell->max[d] = cell->min[d] + step[d];
+                }
+                for (int c = 0; c < 8; c++)
+                {
+                    int a = i + (c & 1);
+                    int b = j + ((c >> 1) & 1);
+                    int s = n[2] > 1 ? k + ((c >> 2) & 1) : 0;
+                    cell->corners[c] = (a * n[1] + b) * n[2] + s;
+                }
+                cell->depth = 0;
+            }
+        }
+    }
+}
+
+Vector3 outcome_strike_velocity(OutcomeSample sample)
+{
+    return (Vector3){cos(sample.angle) * sample.speed, sin(sample.angle) * sample.speed, 0};
+}
+
+Vector3 outcome_strike_spin(OutcomeSample sample)
+{
+    Vector3 aim_line = {cos(sample.angle), sin(sample.angle), 0};
+    return Vector3Scale(Vector3Normalize(Vector3CrossProduct(aim_line, (Vector3){0, 0, 1})), sample.spin);
+}
+
+void *run_outcome_worker(void *arg)
+{
+    OutcomeWorker *worker = (OutcomeWorker *)arg;
+    for (int i = worker->start; i < worker->end; i += worker->stride)
+    {
+        OutcomeSample *sample = &(worker->map->samples[i]);
+        Game *game = fork_game(worker->fork, worker->game);
+        simulate_fork(worker->fork, outcome_strike_velocity(*sample), outcome_strike_spin(*sample));
+        for (int j = 0; j < game->current_shot.num_events; j++)
+        {
+            ShotEvent event = game->current_shot.events[j];
+            Ball *ball1 = event_ball1(&(game->scene), event);
+            if (event.type == BALL_BALL_COLLISION && sample->first_contact == -1)
+            {
+                Ball *ball2 = event_ball2(&(game->scene), event);
+                if (ball1->id == 0)
+                {
+                    sample->first_contact = ball2->id;
+                }
+                else if (ball2->id == 0)
+                {
+                    sample->first_contact = ball1->id;
+                }
+            }
+            if (event.type == BALL_POCKETED && ball1->id < 64)
+            {
+                sample->pocketed |= 1ULL << ball1->id;
+            }
+        }
+        Path path = game->scene.ball_set.balls[0].path;
+        sample->rest_position = Vec2ToVector3(path.segments[path.num_segments - 1].initial_position);
+        sample->done = true;
+        release_game_fork(worker->fork);
+    }
+    return NULL;
+}
+
+void simulate_outcome_samples(OutcomeMap *map, Game *game, int start, int end)
+{
+    int num_threads = map->num_threads;
+    pthread_t threads[num_threads];
+    for (int i = 0; i < num_threads; i++)
+    {
+        OutcomeWorker *worker = &(map->workers[i]);
+        worker->game = game;
+        worker->start = start + i;
+        worker->end = end;
+        worker->stride = num_threads;
+    }
+    // The calling thread takes the first share itself.
+    for (int i = 1; i < num_threads; i++)
+    {
+        pthread_create(&(threads[i]), NULL, run_outcome_worker, &(map->workers[i]));
+    }
+    run_outcome_worker(&(map->workers[0]));
+    for (int i = 1; i < num_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+// Rest positions move smoothly almost everywhere, so a jump in them is only
+// chased for the first few splits; the discrete outcomes are chased to the
+// full depth.
+bool outcomes_differ(OutcomeMap *map, OutcomeSample *a, OutcomeSample *b, int depth)
+{
+    if (a->first_contact != b->first_contact || a->pocketed != b->pocketed)
+    {
+        return true;
+    }
+    return depth < map->max_rest_depth && Vector3Distance(a->rest_position, b->rest_position) > map->rest_tolerance;
+}
+
+bool cell_is_ready(OutcomeMap *map, OutcomeCell *cell)
+{
+    for (int c = 0; c < 8; c++)
+    {
+        if (!map->samples[cell->corners[c]].done)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool cell_is_mixed(OutcomeMap *map, OutcomeCell *cell)
+{
+    OutcomeSample *first = &(map->samples[cell->corners[0]]);
+    for (int c = 1; c < 8; c++)
+    {
+        if (outcomes_differ(map, first, &(map->samples[cell->corners[c]]), cell->depth))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Halves the cell across its widest side, measured relative to the whole map,
+// adding a sample at the middle of each edge that crosses the cut.
+void split_cell(OutcomeMap *map, int index)
+{
+    OutcomeCell cell = map->cells[index];
+    int axis = -1;
+    double widest = 0;
+    for (int d = 0; d < 3; d++)
+    {
+        double range = map->max[d] - map->min[d];
+        double width = range > 0 ? (cell.max[d] - cell.min[d]) / range : 0;
+        if (width > widest)
+        {
+            widest = width;
+            axis = d;
+        }
+    }
+    if (axis == -1)
+    {
+        return;
+    }
+    int bit = 1 << axis;
+    double middle = 0.5 * (cell.min[axis] + cell.max[axis]);
+    int midpoints[8];
+    for (int c = 0; c < 8; c++)
+    {
+        if (c & bit)
+        {
+            continue;
+        }
+        midpoints[c] = -1;
+        // Flat cells repeat corners, so repeat their midpoints too.
+        for (int e = 0; e < c; e++)
+        {
+            if (!(e & bit) && cell.corners[e] == cell.corners[c] && cell.corners[e | bit] == cell.corners[c | bit])
+            {
+                midpoints[c] = midpoints[e];
+            }
+        }
+        if (midpoints[c] == -1)
+        {
+            OutcomeSample low = map->samples[cell.corners[c]];
+            double position[3] = {low.angle, low.speed, low.spin};
+            position[axis] = middle;
+            midpoints[c] = add_outcome_sample(map, position[0], position[1], position[2]);
+        }
+    }
+
+    OutcomeCell *lower = add_outcome_cell(map);
+    *lower = cell;
+    lower->max[axis] = middle;
+    lower->depth = cell.depth + 1;
+    OutcomeCell *upper = add_outcome_cell(map);
+    *upper = cell;
+    upper->min[axis] = middle;
+    upper->depth = cell.depth + 1;
+    for (int c = 0; c < 8; c++)
+    {
+        if (c & bit)
+        {
+            map->cells[map->num_cells - 2].corners[c] = midpoints[c ^ bit];
+        }
+        else
+        {
+            map->cells[map->num_cells - 1].corners[c] = midpoints[c];
+        }
+    }
+}
+
+// Checks the cells whose corners are known, queueing new samples for those
+// that need splitting, then simulates up to max_samples queued samples.
+// Returns false once the map is fully refined.
+bool update_outcome_map(OutcomeMap *map, Game *game, int max_samples)
+{
+    while (map->next_cell < map->num_cells && map->num_samples - map->next_sample < max_samples)
+    {
+        OutcomeCell *cell = &(map->cells[map->next_cell]);
+        if (!cell_is_ready(map, cell))
+        {
+            break;
+        }
+        if (cell->depth < map->max_depth && cell_is_mixed(map, cell))
+        {
+            split_cell(map, map->next_cell);
+        }
+        map->next_cell++;
+    }
+
+    int end = map->next_sample + max_samples;
+    if (end > map->num_samples)
+    {
+        end = map->num_samples;
+    }
+    if (end > map->next_sample)
+    {
+        simulate_outcome_samples(map, game, map->next_sample, end);
+        map->next_sample = end;
+    }
+    return map->next_cell < map->num_cells || map->next_sample < map->num_samples;
+}
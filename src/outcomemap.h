@@ -0,0 +1,80 @@
+#ifndef OUTCOMEMAP_H
+#define OUTCOMEMAP_H
+#include "game.h"
+#include "fork.h"
+
+// One simulated cue ball strike: an aim angle, a cue speed and a spin in
+// radians per second about the horizontal axis across the aim line, signed
+// as in set_cue_ball_strike. The outcome is
+// the ball the cue ball hit first, a bit per pocketed ball id and where the
+// cue ball came to rest.
+typedef struct
+{
+    double angle;
+    double speed;
+    double spin;
+    bool done;
+    int first_contact;
+    unsigned long long pocketed;
+    Vector3 rest_position;
+} OutcomeSample;
+
+// A box in (angle, speed, spin) space whose eight corners are samples.
+// Corner i is at the low end of angle, speed and spin when bits 0, 1 and 2
+// of i are clear.
+typedef struct
+{
+    double min[3];
+    double max[3];
+    int corners[8];
+    int depth;
+} OutcomeCell;
+
+typedef struct
+{
+    GameFork *fork;
+    Game *game;
+    struct OutcomeMap *map;
+    int start;
+    int end;
+    int stride;
+} OutcomeWorker;
+
+// Samples the outcome of every strike in a range of angles, speeds and spins.
+// Cells start on a coarse grid and are split in half across their widest
+// side whenever their corners disagree, so samples pile up along pot window
+// edges and other outcome boundaries. The work is spread across frames with
+// update_outcome_map and across threads within each frame.
+typedef struct OutcomeMap
+{
+    double min[3];
+    double max[3];
+    int max_depth;
+    int max_rest_depth;
+    double rest_tolerance;
+    int table_version;
+    OutcomeSample *samples;
+    int num_samples;
+    int sample_capacity;
+    OutcomeCell *cells;
+    int num_cells;
+    int cell_capacity;
+    int next_cell;
+    int next_sample;
+    int num_threads;
+    OutcomeWorker *workers;
+} OutcomeMap;
+
+OutcomeMap *create_outcome_map(int num_threads);
+
+void free_outcome_map(OutcomeMap *map);
+
+void reset_outcome_map(OutcomeMap *map, Game *game, double min_speed, double max_speed, double max_spin, int grid_size);
+
+bool update_outcome_map(OutcomeMap *map, Game *game, int max_samples);
+
+Vector3 outcome_strike_velocity(OutcomeSample sample);
+
+Vector3 outcome_strike_spin(OutcomeSample sample);
+
+#endif // OUTCOMEMAP_H
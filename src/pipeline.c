@@ -0,0 +1,186 @@
+#include "pipeline.h"
+#include "pocketability.h"
+#include "obstacleindex.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+ShotPipeline *create_shot_pipeline(int reduced_count, int full_count)
+{
+    ShotPipeline *pipeline = malloc(sizeof(ShotPipeline));
+    pipeline->analytic_score = default_analytic_score;
+    pipeline->reduced_count = reduced_count;
+    pipeline->reduced_max_events = 12;
+    pipeline->full_count = full_count;
+    pipeline->list = create_candidate_list();
+    pipeline->fork = create_game_fork(10);
+    pipeline->cache = default_shot_cache();
+    pipeline->summary = create_shot_summary();
+    pipeline->last = (PipelineStats){0, 0, 0, 0, 0, 0, 0, 0};
+    pipeline->total = pipeline->last;
+    pipeline->num_decisions = 0;
+    return pipeline;
+}
+
+void free_shot_pipeline(ShotPipeline *pipeline)
+{
+    free_candidate_list(pipeline->list);
+    free_game_fork(pipeline->fork);
+    free_shot_summary(pipeline->summary);
+    free(pipeline);
+}
+
+double default_analytic_score(Game *game, ShotCandidate *candidate)
+{
+    if (candidate->blocked || candidate->cut_cosine < 0.3 || candidate->second_cut_cosine < 0.3)
+    {
+        return 0;
+    }
+    // A kick reaches its ball off a cushion, every other shot hits it first.
+    if (candidate->type != KICK_SHOT && !strike_hits_ball_first(game, candidate->object_ball, candidate->v, candidate->w))
+    {
+        return 0;
+    }
+    double score = candidate->cut_cosine * candidate->second_cut_cosine / (1 + candidate->distance);
+    if (candidate->type != DIRECT_SHOT)
+    {
+        score *= 0.5;
+    }
+    return score;
+}
+
+double seconds_since(struct timespec start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+bool good_shot(ShotResult result)
+{
+    return result.legal_first_hit && result.ball_potted && !result.cue_ball_potted;
+}
+
+// Best cut on the next ball the player would have to hit, or 0 if it cannot
+// be potted directly.
+double leave_score(Game *game)
+{
+    Ball *next_ball = NULL;
+    for (int i = 1; i < game->scene.ball_set.num_balls; i++)
+    {
+        if (!game->scene.ball_set.balls[i].pocketed)
+        {
+            next_ball = &(game->scene.ball_set.balls[i]);
+            break;
+        }
+    }
+    if (next_ball == NULL)
+    {
+        return 1;
+    }
+    double best = 0;
+    for (int i = 0; i < game->scene.table.num_pockets; i++)
+    {
+        PocketLine *line = get_pocket_line(game, next_ball, i);
+        if (line->object_ball_path_open && line->cue_ball_path_open && line->cut_cosine > best)
+        {
+            best = line->cut_cosine;
+        }
+    }
+    return best;
+}
+
+int keep_scored(CandidateList *list, int count)
+{
+    sort_candidates(list);
+    int kept = 0;
+    while (kept < list->num_candidates && kept < count && list->candidates[kept].score > 0)
+    {
+        kept++;
+    }
+    list->num_candidates = kept;
+    return kept;
+}
+
+bool choose_shot(ShotPipeline *pipeline, Game *game, Ball *ball, Vector3 *v, Vector3 *w)
+{
+    CandidateList *list = pipeline->list;
+    PipelineStats stats = {0, 0, 0, 0, 0, 0, 0, 0};
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    enumerate_candidates(game, ball, list);
+    stats.num_enumerated = list->num_candidates;
+    stats.enumerate_time = seconds_since(start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < list->num_candidates; i++)
+    {
+        list->candidates[i].score = pipeline->analytic_score(game, &(list->candidates[i]));
+    }
+    stats.num_analytic = keep_scored(list, pipeline->reduced_count);
+    stats.analytic_time = seconds_since(start);
+
+    // The analytic score is kept as a tie-break below the simulated outcome,
+    // which is always worth more than any analytic score.
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < list->num_candidates; i++)
+    {
+        ShotCandidate *candidate = &(list->candidates[i]);
+        simulate_cached(pipeline->cache, pipeline->fork, game, candidate->v, candidate->w, pipeline->reduced_max_events, pipeline->summary);
+        ShotResult result = pipeline->summary->result;
+        candidate->score = (good_shot(result) ? 2 : 1) + candidate->score;
+    }
+    stats.num_reduced = keep_scored(list, pipeline->full_count);
+    stats.reduced_time = seconds_since(start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < list->num_candidates; i++)
+    {
+        ShotCandidate *candidate = &(list->candidates[i]);
+        simulate_cached(pipeline->cache, pipeline->fork, game, candidate->v, candidate->w, 0, pipeline->summary);
+        ShotResult result = pipeline->summary->result;
+        double score = candidate->score - (int)candidate->score;
+        if (good_shot(result))
+        {
+            Game *fork = fork_after_summary(pipeline->fork, game, pipeline->summary);
+            score += 2 + leave_score(fork);
+            release_game_fork(pipeline->fork);
+        }
+        candidate->score = score;
+    }
+    stats.num_full = list->num_candidates;
+    sort_candidates(list);
+    stats.full_time = seconds_since(start);
+
+    pipeline->last = stats;
+    pipeline->total.num_enumerated += stats.num_enumerated;
+    pipeline->total.num_analytic += stats.num_analytic;
+    pipeline->total.num_reduced += stats.num_reduced;
+    pipeline->total.num_full += stats.num_full;
+    pipeline->total.enumerate_time += stats.enumerate_time;
+    pipeline->total.analytic_time += stats.analytic_time;
+    pipeline->total.reduced_time += stats.reduced_time;
+    pipeline->total.full_time += stats.full_time;
+    pipeline->num_decisions++;
+
+    if (list->num_candidates == 0)
+    {
+        return false;
+    }
+    *v = list->candidates[0].v;
+    *w = list->candidates[0].w;
+    return true;
+}
+
+void print_pipeline_stats(ShotPipeline *pipeline)
+{
+    PipelineStats total = pipeline->total;
+    int n = pipeline->num_decisions > 0 ? pipeline->num_decisions : 1;
+    printf("Shot pipeline: %d decisions\n", pipeline->num_decisions);
+    printf("  enumerate: %6.1f candidates %8.1f us\n", (double)total.num_enumerated / n, 1e6 * total.enumerate_time / n);
+    printf("  analytic:  %6.1f kept       %8.1f us\n", (double)total.num_analytic / n, 1e6 * total.analytic_time / n);
+    printf("  reduced:   %6.1f kept       %8.1f us\n", (double)total.num_reduced / n, 1e6 * total.reduced_time / n);
+    printf("  full:      %6.1f simulated  %8.1f us\n", (double)total.num_full / n, 1e6 * total.full_time / n);
+    print_shot_cache_stats(pipeline->cache);
+}
@@ -0,0 +1,56 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+#include "game.h"
+#include "candidates.h"
+#include "fork.h"
+#include "shotcache.h"
+
+typedef double (*CandidateScoreFunction)(Game *game, ShotCandidate *candidate);
+
+// Candidate counts and wall-clock seconds spent in each stage.
+typedef struct
+{
+    int num_enumerated;
+    int num_analytic;
+    int num_reduced;
+    int num_full;
+    double enumerate_time;
+    double analytic_time;
+    double reduced_time;
+    double full_time;
+} PipelineStats;
+
+// Chooses a shot in three stages of increasing cost. Every enumerated
+// candidate is scored analytically, the best reduced_count are simulated
+// until reduced_max_events events have happened, and the best full_count of
+// those are simulated to rest and judged on the position they leave.
+// Simulations go through a shot cache, shared by default with every other
+// pipeline in the process.
+typedef struct ShotPipeline
+{
+    CandidateScoreFunction analytic_score;
+    int reduced_count;
+    int reduced_max_events;
+    int full_count;
+
+    CandidateList *list;
+    GameFork *fork;
+    ShotCache *cache;
+    ShotSummary *summary;
+
+    PipelineStats last;
+    PipelineStats total;
+    int num_decisions;
+} ShotPipeline;
+
+ShotPipeline *create_shot_pipeline(int reduced_count, int full_count);
+
+void free_shot_pipeline(ShotPipeline *pipeline);
+
+double default_analytic_score(Game *game, ShotCandidate *candidate);
+
+bool choose_shot(ShotPipeline *pipeline, Game *game, Ball *ball, Vector3 *v, Vector3 *w);
+
+void print_pipeline_stats(ShotPipeline *pipeline);
+
+#endif // PIPELINE_H
@@ -0,0 +1,151 @@
+#include "pocketability.h"
+#include "geometry.h"
+#include <stdlib.h>
+
+Pocketability *create_pocketability()
+{
+    Pocketability *pocketability = malloc(sizeof(Pocketability));
+    pocketability->version = -1;
+    pocketability->num_balls = 0;
+    pocketability->num_pockets = 0;
+    pocketability->num_cushions = 0;
+    pocketability->pocket_lines = NULL;
+    pocketability->pocket_line_capacity = 0;
+    pocketability->bank_lines = NULL;
+    pocketability->bank_line_capacity = 0;
+    pocketability->blockers = NULL;
+    pocketability->num_blockers = 0;
+    pocketability->blocker_capacity = 0;
+    return pocketability;
+}
+
+void free_pocketability(Pocketability *pocketability)
+{
+    free(pocketability->pocket_lines);
+    free(pocketability->bank_lines);
+    free(pocketability->blockers);
+    free(pocketability);
+}
+
+int add_blockers(Pocketability *pocketability, Game *game, Corridor corridor, bool blocked, int *num_blockers)
+{
+    *num_blockers = 0;
+    if (!blocked)
+    {
+        return pocketability->num_blockers;
+    }
+    int num_balls = game->scene.ball_set.num_balls;
+    if (pocketability->num_blockers + num_balls > pocketability->blocker_capacity)
+    {
+        pocketability->blocker_capacity = 2 * (pocketability->num_blockers + num_balls);
+        pocketability->blockers = realloc(pocketability->blockers, pocketability->blocker_capacity * sizeof(int));
+    }
+    int first = pocketability->num_blockers;
+    *num_blockers = corridor_blockers(game, corridor, &(pocketability->blockers[first]));
+    pocketability->num_blockers += *num_blockers;
+    return first;
+}
+
+void build_pocketability(Pocketability *pocketability, Game *game, int version)
+{
+    Scene *scene = &(game->scene);
+    int num_balls = scene->ball_set.num_balls;
+    int num_pockets = scene->table.num_pockets;
+    int num_cushions = scene->table.num_cushions;
+    int num_pocket_lines = num_balls * num_pockets;
+    int num_bank_lines = num_pocket_lines * num_cushions;
+    if (num_pocket_lines > pocketability->pocket_line_capacity)
+    {
+        pocketability->pocket_line_capacity = num_pocket_lines;
+        pocketability->pocket_lines = realloc(pocketability->pocket_lines, num_pocket_lines * sizeof(PocketLine));
+    }
+    if (num_bank_lines > pocketability->bank_line_capacity)
+    {
+        pocketability->bank_line_capacity = num_bank_lines;
+        pocketability->bank_lines = realloc(pocketability->bank_lines, num_bank_lines * sizeof(BankLine));
+    }
+    pocketability->num_balls = num_balls;
+    pocketability->num_pockets = num_pockets;
+    pocketability->num_cushions = num_cushions;
+    pocketability->num_blockers = 0;
+
+    // Every line on the table goes through one batched occlusion query: two
+    // per pocket line and three per bank line.
+    int num_corridors = 2 * num_pocket_lines + 3 * num_bank_lines;
+    Corridor *corridors = malloc(num_corridors * sizeof(Corridor));
+    bool *blocked = malloc(num_corridors * sizeof(bool));
+    Ball *cue_ball = &(scene->ball_set.balls[0]);
+    Vector3 cue_ball_position = cue_ball->initial_position;
+    int c = 0;
+    for (int i = 0; i < num_balls; i++)
+    {
+        Ball *ball = &(scene->ball_set.balls[i]);
+        for (int j = 0; j < num_pockets; j++)
+        {
+            Vector3 pocket = scene->table.pockets[j].position;
+            PocketLine *line = &(pocketability->pocket_lines[i * num_pockets + j]);
+            line->aim_point = pocket_aim_point(game, ball, j);
+            line->cut_cosine = cut_cosine(cue_ball_position, line->aim_point, ball->initial_position, pocket);
+            corridors[c++] = ball_corridor(ball->initial_position, pocket, ball);
+            corridors[c++] = ball_corridor(cue_ball_position, line->aim_point, cue_ball);
+            for (int k = 0; k < num_cushions; k++)
+            {
+                Cushion cushion = scene->table.cushions[k];
+                BankLine *bank = &(pocketability->bank_lines[(i * num_pockets + j) * num_cushions + k]);
+                bank->pocket_image = reflect_in_cushion(pocket, cushion);
+                bank->exists = !(pocket.x == bank->pocket_image.x && pocket.y == bank->pocket_image.y && pocket.z == bank->pocket_image.z);
+                bank->collision_point = cushion_contact_point(ball->initial_position, bank->pocket_image, cushion);
+                bank->aim_point = ghost_ball_position(ball->initial_position, bank->collision_point, ball->radius);
+                bank->cut_cosine = cut_cosine(cue_ball_position, bank->aim_point, ball->initial_position, bank->collision_point);
+                corridors[c++] = ball_corridor(ball->initial_position, bank->collision_point, ball);
+                corridors[c++] = ball_corridor(bank->collision_point, pocket, ball);
+                corridors[c++] = ball_corridor(cue_ball_position, bank->aim_point, cue_ball);
+            }
+        }
+    }
+    corridors_blocked(game, corridors, num_corridors, blocked);
+
+    c = 0;
+    for (int i = 0; i < num_pocket_lines; i++)
+    {
+        PocketLine *line = &(pocketability->pocket_lines[i]);
+        line->object_ball_path_open = !blocked[c];
+        line->first_object_ball_blocker = add_blockers(pocketability, game, corridors[c], blocked[c], &(line->num_object_ball_blockers));
+        line->cue_ball_path_open = !blocked[c + 1];
+        line->first_cue_ball_blocker = add_blockers(pocketability, game, corridors[c + 1], blocked[c + 1], &(line->num_cue_ball_blockers));
+        c += 2;
+        for (int k = 0; k < num_cushions; k++)
+        {
+            BankLine *bank = &(pocketability->bank_lines[i * num_cushions + k]);
+            bank->object_ball_path_open = !blocked[c] && !blocked[c + 1];
+            bank->cue_ball_path_open = !blocked[c + 2];
+            c += 3;
+        }
+    }
+    free(corridors);
+    free(blocked);
+    pocketability->version = version;
+}
+
+Pocketability *get_pocketability(Game *game)
+{
+    if (game->pocketability->version != game->table_version)
+    {
+        build_pocketability(game->pocketability, game, game->table_version);
+    }
+    return game->pocketability;
+}
+
+PocketLine *get_pocket_line(Game *game, Ball *ball, int pocket)
+{
+    Pocketability *pocketability = get_pocketability(game);
+    int i = ball - game->scene.ball_set.balls;
+    return &(pocketability->pocket_lines[i * pocketability->num_pockets + pocket]);
+}
+
+BankLine *get_bank_line(Game *game, Ball *ball, int pocket, int cushion)
+{
+    Pocketability *pocketability = get_pocketability(game);
+    int i = ball - game->scene.ball_set.balls;
+    return &(pocketability->bank_lines[(i * pocketability->num_pockets + pocket) * pocketability->num_cushions + cushion]);
+}
@@ -0,0 +1,64 @@
+#ifndef POCKETABILITY_H
+#define POCKETABILITY_H
+#include "game.h"
+
+// How a ball can be sent straight into a pocket from the current table.
+// Blockers are ball indices stored in Pocketability.blockers.
+typedef struct
+{
+    Vector3 aim_point;
+    double cut_cosine;
+    bool object_ball_path_open;
+    bool cue_ball_path_open;
+    int first_object_ball_blocker;
+    int num_object_ball_blockers;
+    int first_cue_ball_blocker;
+    int num_cue_ball_blockers;
+} PocketLine;
+
+// How a ball can be banked into a pocket off one cushion. A bank only exists
+// if the cushion's mirror image of the pocket is not the pocket itself.
+typedef struct
+{
+    bool exists;
+    Vector3 pocket_image;
+    Vector3 collision_point;
+    Vector3 aim_point;
+    double cut_cosine;
+    bool object_ball_path_open;
+    bool cue_ball_path_open;
+} BankLine;
+
+// Every pocket and single-cushion bank for every ball on the table, worked
+// out once per table version and shared by everything that aims shots.
+typedef struct Pocketability
+{
+    int version;
+    int num_balls;
+    int num_pockets;
+    int num_cushions;
+
+    PocketLine *pocket_lines;
+    int pocket_line_capacity;
+
+    BankLine *bank_lines;
+    int bank_line_capacity;
+
+    int *blockers;
+    int num_blockers;
+    int blocker_capacity;
+} Pocketability;
+
+Pocketability *create_pocketability();
+
+void build_pocketability(Pocketability *pocketability, Game *game, int version);
+
+void free_pocketability(Pocketability *pocketability);
+
+Pocketability *get_pocketability(Game *game);
+
+PocketLine *get_pocket_line(Game *game, Ball *ball, int pocket);
+
+BankLine *get_bank_line(Game *game, Ball *ball, int pocket, int cushion);
+
+#endif // POCKETABILITY_H
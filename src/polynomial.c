@@ -318,7 +318,7 @@ void solve_quartic_j(double a, double b, double c, double d, double e, double *x
         double root1 = (-b1 - sqrt(b1 * b1 - 4 * a1 * c1)) / (2 * a1);
         root1 = quartic_newton_iterate(a, b, c, d, e, root1);
 
-        x0 = sorted_stationary_points[3];
+        x0 = sorted_stationary_points[2];
         f = evaluate_quartic(a, b, c, d, e, x0);
         f_prime = evaluate_cubic(4 * a, 3 * b, 2 * c, d, x0);
         f_double_prime = evaluate_quadratic(12 * a, 6 * b, 2 * c, x0);
@@ -421,6 +421,7 @@ void solve_quartic_j(double a, double b, double c, double d, double e, double *x
         *x3 = *x4 = nan("0");
         return;
     }
+    *x1 = *x2 = *x3 = *x4 = nan("0");
 }
 
 void solve_quartic(double a, double b, double c, double d, double e, double *x1, double *x2, double *x3, double *x4)
@@ -1,9 +1,40 @@
 #include <math.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 #include "polynomial.h"
 
+// Every root solve_quartic returns must be a root. expected_roots is the
+// number of real roots it should find, or -1 to accept any number.
+bool check_quartic(char *name, double a, double b, double c, double d, double e, int expected_roots)
+{
+    double roots[4] = {1e300, 1e300, 1e300, 1e300};
+    solve_quartic(a, b, c, d, e, &roots[0], &roots[1], &roots[2], &roots[3]);
+    int num_roots = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        if (isnan(roots[i]))
+        {
+            continue;
+        }
+        double x = roots[i];
+        double f = (((a * x + b) * x + c) * x + d) * x + e;
+        if (!(fabs(f) < 1e-9))
+        {
+            printf("%s: x = %g is not a root (f = %g)\n", name, x, f);
+            return false;
+        }
+        num_roots++;
+    }
+    if (expected_roots >= 0 && num_roots != expected_roots)
+    {
+        printf("%s: found %d roots, expected %d\n", name, num_roots, expected_roots);
+        return false;
+    }
+    return true;
+}
+
 int main(int argc, char **argv)
 {
     if (argc != 2)
@@ -12,6 +43,19 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    bool passed = true;
+    // Three stationary points, all below zero: the second root is found
+    // from the largest stationary point.
+    passed &= check_quartic("(x - 3)^4 - 2(x - 3)^2 - 1", 1, -12, 52, -96, 62, 2);
+    passed &= check_quartic("(x - 3)^4 - 2(x - 3)^2 + 0.5", 1, -12, 52, -96, 63.5, 4);
+    // Upside down, the signs at the stationary points match no case, but
+    // every root must still be set.
+    passed &= check_quartic("-(x - 3)^4 + 2(x - 3)^2 - 0.5", -1, 12, -52, 96, -63.5, -1);
+    if (!passed)
+    {
+        return 1;
+    }
+
     int iterations = atoi(argv[1]);
 
     for (int i = 0; i < iterations; i++)
@@ -24,4 +68,4 @@ int main(int argc, char **argv)
         double roots[4];
         solve_quartic(coeffs[0], coeffs[1], coeffs[2], coeffs[3], coeffs[4], &roots[0], &roots[1], &roots[2], &roots[3]);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,93 @@
+#include "potwindow.h"
+#include "geometry.h"
+#include <math.h>
+
+// Returns the pocket the ball went into during the current shot, or -1.
+int pocket_entered(Game *game, int ball_id)
+{
+    Shot *shot = &(game->current_shot);
+    for (int i = 0; i < shot->num_events; i++)
+    {
+        ShotEvent event = shot->events[i];
+        if (event.type == BALL_POCKETED && event_ball1(&(game->scene), event)->id == ball_id)
+        {
+            return event.cushion_or_pocket;
+        }
+    }
+    return -1;
+}
+
+bool pots_at_angle(GameFork *fork, Game *game, Ball *ball, int pocket, double angle, double speed, double spin, PotWindow *window)
+{
+    Vector3 aim_line = {cos(angle), sin(angle), 0};
+    Vector3 v = Vector3Scale(aim_line, speed);
+    Vector3 w = Vector3Scale(Vector3Normalize(Vector3CrossProduct(aim_line, (Vector3){0, 0, 1})), spin);
+    Game *forked = fork_game(fork, game);
+    simulate_fork(fork, v, w);
+    bool potted = pocket_entered(forked, ball->id) == pocket && pocket_entered(forked, 0) == -1;
+    release_game_fork(fork);
+    window->num_simulations++;
+    return potted;
+}
+
+// Starts from the ghost ball line, looks a little either side of it if that
+// misses, then walks outwards from a potting angle until the shot misses and
+// bisects each edge. The potting angles are assumed to form one interval.
+PotWindow find_pot_window(GameFork *fork, Game *game, Ball *ball, int pocket, double speed, double spin)
+{
+    PotWindow window = {false, 0, 0, 0, 0, 0};
+    Vector3 cue_ball_position = game->scene.ball_set.balls[0].initial_position;
+    Vector3 aim_line = Vector3Subtract(pocket_aim_point(game, ball, pocket), cue_ball_position);
+    double base_angle = atan2(aim_line.y, aim_line.x);
+    double step = 0.25 * ball->radius / fmax(Vector3Length(aim_line), ball->radius);
+    double tolerance = step / 1024;
+
+    double inside = 0;
+    for (int i = 0; i < 7 && !window.found; i++)
+    {
+        inside = ((i + 1) / 2) * step * (i % 2 == 1 ? 1 : -1);
+        window.found = pots_at_angle(fork, game, ball, pocket, base_angle + inside, speed, spin, &window);
+    }
+    if (!window.found)
+    {
+        return window;
+    }
+
+    double edges[2];
+    for (int side = 0; side < 2; side++)
+    {
+        double direction = side == 0 ? -1 : 1;
+        double low = inside;
+        double high = inside;
+        double gap = step;
+        bool bracketed = false;
+        for (int i = 0; i < 8 && !bracketed; i++)
+        {
+            high = inside + direction * gap;
+            bracketed = !pots_at_angle(fork, game, ball, pocket, base_angle + high, speed, spin, &window);
+            if (!bracketed)
+            {
+                low = high;
+                gap *= 2;
+            }
+        }
+        while (bracketed && fabs(high - low) > tolerance)
+        {
+            double middle = 0.5 * (low + high);
+            if (pots_at_angle(fork, game, ball, pocket, base_angle + middle, speed, spin, &window))
+            {
+                low = middle;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        edges[side] = low;
+    }
+    window.min_angle = base_angle + edges[0];
+    window.max_angle = base_angle + edges[1];
+    window.centre_angle = 0.5 * (window.min_angle + window.max_angle);
+    window.width = window.max_angle - window.min_angle;
+    return window;
+}
@@ -0,0 +1,23 @@
+#ifndef POTWINDOW_H
+#define POTWINDOW_H
+#include "game.h"
+#include "fork.h"
+
+// The range of cue angles, in radians from the x axis, that pots a ball in
+// a given pocket without scratching. Its width is a direct measure of how
+// hard the shot is.
+typedef struct
+{
+    bool found;
+    double min_angle;
+    double max_angle;
+    double centre_angle;
+    double width;
+    int num_simulations;
+} PotWindow;
+
+int pocket_entered(Game *game, int ball_id);
+
+PotWindow find_pot_window(GameFork *fork, Game *game, Ball *ball, int pocket, double speed, double spin);
+
+#endif // POTWINDOW_H
@@ -0,0 +1,396 @@
+#include "replayscreen.h"
+#include "mainmenuscreen.h"
+#include <raylib.h>
+#include <raymath.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#define TIMELINE_X 10
+#define TIMELINE_Y 840
+#define TIMELINE_WIDTH 1220
+#define TIMELINE_HEIGHT 20
+#define PANEL_X 1250
+#define LIST_ROWS 14
+
+PathSegment replay_path_segment(ReplaySegment *record)
+{
+    PathSegment segment = {record->initial_position, record->initial_velocity, record->acceleration, record->initial_angular_velocity, record->angular_acceleration, record->rolling != 0, record->start_time, record->end_time, NULL};
+    return segment;
+}
+
+Screen *create_replay_screen(char *path)
+{
+    Replay *replay = open_replay(path);
+    if (replay == NULL)
+    {
+        return NULL;
+    }
+    ReplayScreen *replay_screen = malloc(sizeof(ReplayScreen));
+    replay_screen->base.update = update_replay_screen;
+    replay_screen->base.render = render_replay_screen;
+    replay_screen->replay = replay;
+    replay_screen->table = create_table();
+    replay_screen->frame = 0;
+    replay_screen->shot = 0;
+    replay_screen->time = 0;
+    replay_screen->speed = 1;
+    replay_screen->playing = true;
+    replay_screen->show_paths = false;
+    replay_screen->segment_cursors = calloc(replay->header->num_balls + 1, sizeof(int));
+    return (Screen *)replay_screen;
+}
+
+void free_replay_screen(ReplayScreen *replay_screen)
+{
+    close_replay(replay_screen->replay);
+    free(replay_screen->table.cushions);
+    free(replay_screen->table.pockets);
+    free(replay_screen->segment_cursors);
+    free(replay_screen);
+}
+
+ReplayShot *current_replay_shot(ReplayScreen *replay_screen)
+{
+    ReplayFrame *frame = replay_frame(replay_screen->replay, replay_screen->frame);
+    if (frame == NULL)
+    {
+        return NULL;
+    }
+    return replay_shot(replay_screen->replay, frame, replay_screen->shot);
+}
+
+// Moves to a shot, stepping into the neighbouring frames past either end
+// of the current one.
+void select_replay_shot(ReplayScreen *replay_screen, int frame, int shot)
+{
+    int num_frames = replay_screen->replay->num_frames;
+    if (frame < 0)
+    {
+        frame = 0;
+        shot = 0;
+    }
+    if (frame >= num_frames)
+    {
+        frame = num_frames - 1;
+        shot = INT32_MAX;
+    }
+    ReplayFrame *record = replay_frame(replay_screen->replay, frame);
+    if (record != NULL && shot < 0)
+    {
+        if (frame > 0)
+        {
+            select_replay_shot(replay_screen, frame - 1, INT32_MAX);
+            return;
+        }
+        shot = 0;
+    }
+    if (record != NULL && shot >= (int)record->num_shots && shot != INT32_MAX && frame + 1 < num_frames)
+    {
+        frame++;
+        shot = 0;
+        record = replay_frame(replay_screen->replay, frame);
+    }
+    if (record != NULL && shot >= (int)record->num_shots)
+    {
+        shot = record->num_shots > 0 ? (int)record->num_shots - 1 : 0;
+    }
+    replay_screen->frame = frame < 0 ? 0 : frame;
+    replay_screen->shot = shot;
+    replay_screen->time = 0;
+    for (uint32_t i = 0; i < replay_screen->replay->header->num_balls; i++)
+    {
+        replay_screen->segment_cursors[i] = 0;
+    }
+}
+
+// Returns the segment of a ball's path covering time, starting the search
+// from where the ball was last drawn.
+ReplaySegment *replay_segment_at(ReplayScreen *replay_screen, ReplayShot *shot, int ball, double time)
+{
+    ReplayPath *path = replay_path(replay_screen->replay, shot, ball);
+    if (path == NULL || path->num_segments == 0)
+    {
+        return NULL;
+    }
+    ReplaySegment *segments = replay_segments(replay_screen->replay, path);
+    if (segments == NULL)
+    {
+        return NULL;
+    }
+    int cursor = replay_screen->segment_cursors[ball];
+    if (cursor >= (int)path->num_segments)
+    {
+        cursor = path->num_segments - 1;
+    }
+    while (cursor > 0 && time < segments[cursor].start_time)
+    {
+        cursor--;
+    }
+    while (cursor + 1 < (int)path->num_segments && time >= segments[cursor].end_time)
+    {
+        cursor++;
+    }
+    replay_screen->segment_cursors[ball] = cursor;
+    return &(segments[cursor]);
+}
+
+// The spin axis hardly moves within a segment, so the ball is turned about
+// the mean angular velocity.
+Quaternion replay_orientation(PathSegment segment, Quaternion initial_orientation, double time)
+{
+    double dt = fmin(time, segment.end_time) - segment.start_time;
+    if (dt <= 0)
+    {
+        return initial_orientation;
+    }
+    Vector3 w = Vector3Scale(Vector3Add(segment.initial_angular_velocity, get_angular_velocity(segment, time)), 0.5);
+    double angle = Vector3Length(w) * dt;
+    if (angle == 0)
+    {
+        return initial_orientation;
+    }
+    Quaternion delta = QuaternionFromAxisAngle(Vector3Normalize(w), -angle);
+    return QuaternionMultiply(initial_orientation, delta);
+}
+
+void render_replay_ball(ReplayBall *ball, PathSegment segment, Quaternion orientation, double time)
+{
+    Color colour = {ball->colour[0], ball->colour[1], ball->colour[2], ball->colour[3]};
+    Vector3 position = Vec2ToVector3(get_position(segment, time));
+    Vector3 screen_position = world_to_screen(position);
+    DrawCircle(screen_position.x, screen_position.y, meters_to_pixels(ball->radius), colour);
+
+    Matrix m = QuaternionToMatrix(orientation);
+    Vector3 axes[3] = {{m.m0, m.m4, m.m8}, {m.m1, m.m5, m.m9}, {m.m2, m.m6, m.m10}};
+    for (int i = 0; i < 3; i++)
+    {
+        Vector3 axis = axes[i].z > 0 ? axes[i] : Vector3Negate(axes[i]);
+        Vector3 spot = world_to_screen(Vector3Add(position, Vector3Scale(axis, ball->radius)));
+        DrawCircle(spot.x, spot.y, 2, BLACK);
+    }
+}
+
+// Draws a segment up to time. Segments are split into lines by their length
+// on screen, so shots with thousands of tiny segments stay cheap to draw.
+void render_replay_trail(PathSegment segment, double time)
+{
+    double end_time = fmin(segment.end_time, time);
+    if (end_time <= segment.start_time)
+    {
+        return;
+    }
+    Vector3 start = world_to_screen(Vec2ToVector3(segment.initial_position));
+    Vector3 end = world_to_screen(Vec2ToVector3(get_position(segment, end_time)));
+    int steps = segment.rolling ? 1 : 1 + (int)(Vector3Distance(start, end) / 8);
+    if (steps > 20)
+    {
+        steps = 20;
+    }
+    for (int i = 1; i <= steps; i++)
+    {
+        double t = segment.start_time + (end_time - segment.start_time) * i / steps;
+        Vector3 p = i == steps ? end : world_to_screen(Vec2ToVector3(get_position(segment, t)));
+        DrawLine(start.x, start.y, p.x, p.y, segment.rolling ? BLUE : RED);
+        start = p;
+    }
+}
+
+Screen *update_replay_screen(Screen *screen)
+{
+    ReplayScreen *replay_screen = (ReplayScreen *)screen;
+    if (IsKeyPressed(KEY_ESCAPE))
+    {
+        free_replay_screen(replay_screen);
+        return create_main_menu_screen();
+    }
+    if (IsKeyPressed(KEY_DOWN))
+    {
+        select_replay_shot(replay_screen, replay_screen->frame + 1, 0);
+    }
+    if (IsKeyPressed(KEY_UP))
+    {
+        select_replay_shot(replay_screen, replay_screen->frame - 1, 0);
+    }
+    if (IsKeyPressed(KEY_PAGE_DOWN))
+    {
+        select_replay_shot(replay_screen, replay_screen->frame + 10, 0);
+    }
+    if (IsKeyPressed(KEY_PAGE_UP))
+    {
+        select_replay_shot(replay_screen, replay_screen->frame - 10, 0);
+    }
+    if (IsKeyPressed(KEY_RIGHT))
+    {
+        select_replay_shot(replay_screen, replay_screen->frame, replay_screen->shot + 1);
+    }
+    if (IsKeyPressed(KEY_LEFT))
+    {
+        select_replay_shot(replay_screen, replay_screen->frame, replay_screen->shot - 1);
+    }
+    if (IsKeyPressed(KEY_SPACE))
+    {
+        replay_screen->playing = !replay_screen->playing;
+    }
+    if (IsKeyPressed(KEY_PERIOD))
+    {
+        replay_screen->speed *= 2;
+    }
+    if (IsKeyPressed(KEY_COMMA))
+    {
+        replay_screen->speed /= 2;
+    }
+    if (IsKeyPressed(KEY_T))
+    {
+        replay_screen->show_paths = !replay_screen->show_paths;
+    }
+
+    ReplayShot *shot = current_replay_shot(replay_screen);
+    double end_time = shot == NULL ? 0 : shot->end_time;
+    if (IsKeyPressed(KEY_HOME))
+    {
+        replay_screen->time = 0;
+    }
+    if (IsKeyPressed(KEY_END))
+    {
+        replay_screen->time = end_time;
+    }
+    if (IsKeyPressed(KEY_LEFT_BRACKET))
+    {
+        replay_screen->time -= 1;
+    }
+    if (IsKeyPressed(KEY_RIGHT_BRACKET))
+    {
+        replay_screen->time += 1;
+    }
+    if (IsMouseButtonDown(MOUSE_BUTTON_LEFT))
+    {
+        Vector2 mouse = GetMousePosition();
+        if (mouse.y >= TIMELINE_Y - 10 && mouse.y <= TIMELINE_Y + TIMELINE_HEIGHT + 10 && mouse.x >= TIMELINE_X && mouse.x <= TIMELINE_X + TIMELINE_WIDTH)
+        {
+            replay_screen->time = end_time * (mouse.x - TIMELINE_X) / TIMELINE_WIDTH;
+        }
+    }
+    if (replay_screen->playing)
+    {
+        replay_screen->time += replay_screen->speed * GetFrameTime();
+        if (replay_screen->time > end_time && shot != NULL)
+        {
+            select_replay_shot(replay_screen, replay_screen->frame, replay_screen->shot + 1);
+            if (current_replay_shot(replay_screen) == shot)
+            {
+                replay_screen->time = end_time;
+                replay_screen->playing = false;
+            }
+        }
+    }
+    replay_screen->time = Clamp(replay_screen->time, 0, end_time);
+    return screen;
+}
+
+void render_replay_panel(ReplayScreen *replay_screen)
+{
+    Replay *replay = replay_screen->replay;
+    DrawRectangle(PANEL_X - 10, 0, 1640 - PANEL_X + 10, 900, BLACK);
+    int y = 10;
+    for (uint32_t i = 0; i < replay->header->num_players && i < 2; i++)
+    {
+        ReplayPlayer *player = replay_player(replay, i);
+        char *name = player == NULL ? NULL : replay_text(replay, player->name_offset, player->name_length);
+        DrawText(TextFormat("Player %u: %.*s", i + 1, name == NULL ? 0 : (int)player->name_length, name == NULL ? "" : name), PANEL_X, y, 20, WHITE);
+        y += 25;
+    }
+    y += 10;
+    DrawText(TextFormat("Frames (%u)", replay->num_frames), PANEL_X, y, 20, WHITE);
+    y += 25;
+    int first = replay_screen->frame - LIST_ROWS / 2;
+    if (first > (int)replay->num_frames - LIST_ROWS)
+    {
+        first = replay->num_frames - LIST_ROWS;
+    }
+    if (first < 0)
+    {
+        first = 0;
+    }
+    for (int i = first; i < first + LIST_ROWS && i < (int)replay->num_frames; i++)
+    {
+        ReplayFrame *frame = replay_frame(replay, i);
+        if (frame == NULL)
+        {
+            break;
+        }
+        Color colour = i == replay_screen->frame ? YELLOW : LIGHTGRAY;
+        DrawText(TextFormat("Frame %d: %u shots, winner %s", i + 1, frame->num_shots, frame->winner < 0 ? "-" : TextFormat("%d", frame->winner + 1)), PANEL_X, y, 20, colour);
+        y += 22;
+    }
+    y += 10;
+    ReplayFrame *frame = replay_frame(replay, replay_screen->frame);
+    DrawText("Shots", PANEL_X, y, 20, WHITE);
+    y += 25;
+    int first_shot = replay_screen->shot - LIST_ROWS / 2;
+    if (frame != NULL && first_shot > (int)frame->num_shots - LIST_ROWS)
+    {
+        first_shot = frame->num_shots - LIST_ROWS;
+    }
+    if (first_shot < 0)
+    {
+        first_shot = 0;
+    }
+    for (int i = first_shot; frame != NULL && i < first_shot + LIST_ROWS && i < (int)frame->num_shots; i++)
+    {
+        ReplayShot *shot = replay_shot(replay, frame, i);
+        if (shot == NULL)
+        {
+            break;
+        }
+        Color colour = i == replay_screen->shot ? YELLOW : LIGHTGRAY;
+        DrawText(TextFormat("Shot %d: player %d, %u events, %.1f s", i + 1, shot->player + 1, shot->num_events, shot->end_time), PANEL_X, y, 20, colour);
+        y += 22;
+    }
+    DrawText("Up/Down frame, Left/Right shot", PANEL_X, 800, 20, GRAY);
+    DrawText("Space play, ,/. speed, [/] seek, T paths", PANEL_X, 825, 20, GRAY);
+    DrawText("Esc back to the menu", PANEL_X, 850, 20, GRAY);
+}
+
+void render_replay_screen(Screen *screen)
+{
+    ReplayScreen *replay_screen = (ReplayScreen *)screen;
+    ClearBackground(GREEN);
+    render_table(replay_screen->table);
+
+    ReplayShot *shot = current_replay_shot(replay_screen);
+    double end_time = 0;
+    if (shot != NULL)
+    {
+        end_time = shot->end_time;
+        for (uint32_t i = 0; i < replay_screen->replay->header->num_balls; i++)
+        {
+            ReplayBall *ball = replay_ball(replay_screen->replay, i);
+            ReplaySegment *record = replay_segment_at(replay_screen, shot, i, replay_screen->time);
+            if (ball == NULL || record == NULL)
+            {
+                continue;
+            }
+            if (replay_screen->show_paths)
+            {
+                ReplayPath *path = replay_path(replay_screen->replay, shot, i);
+                ReplaySegment *segments = replay_segments(replay_screen->replay, path);
+                for (int j = 0; j <= replay_screen->segment_cursors[i]; j++)
+                {
+                    render_replay_trail(replay_path_segment(&(segments[j])), replay_screen->time);
+                }
+            }
+            PathSegment segment = replay_path_segment(record);
+            render_replay_ball(ball, segment, replay_orientation(segment, record->initial_orientation, replay_screen->time), replay_screen->time);
+        }
+    }
+
+    DrawRectangle(TIMELINE_X, TIMELINE_Y, TIMELINE_WIDTH, TIMELINE_HEIGHT, DARKGRAY);
+    if (end_time > 0)
+    {
+        DrawRectangle(TIMELINE_X, TIMELINE_Y, TIMELINE_WIDTH * replay_screen->time / end_time, TIMELINE_HEIGHT, LIGHTGRAY);
+    }
+    DrawText(TextFormat("Frame %d  Shot %d  %.2f / %.2f s  x%g%s", replay_screen->frame + 1, replay_screen->shot + 1, replay_screen->time, end_time, replay_screen->speed, replay_screen->playing ? "" : "  paused"), TIMELINE_X, TIMELINE_Y - 30, 20, WHITE);
+    render_replay_panel(replay_screen);
+    DrawFPS(TIMELINE_X, 870);
+}
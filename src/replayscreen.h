@@ -0,0 +1,32 @@
+#ifndef REPLAYSCREEN_H
+#define REPLAYSCREEN_H
+#include "screen.h"
+#include "game.h"
+#include "serialise.h"
+
+// Plays a replay file straight from its stored path segments. Each ball
+// keeps the index of the segment it was last drawn in, so playing and
+// scrubbing only step over the segments between two times.
+typedef struct
+{
+    Screen base;
+
+    Replay *replay;
+    Table table;
+    int frame;
+    int shot;
+    double time;
+    double speed;
+    bool playing;
+    bool show_paths;
+    int *segment_cursors;
+} ReplayScreen;
+
+// Returns NULL if the file can't be opened as a replay.
+Screen *create_replay_screen(char *path);
+
+Screen *update_replay_screen(Screen *screen);
+
+void render_replay_screen(Screen *screen);
+
+#endif // REPLAYSCREEN_H
@@ -0,0 +1,179 @@
+#include "robustness.h"
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+RobustnessEvaluator *create_robustness_evaluator(int num_threads)
+{
+    if (num_threads <= 0)
+    {
+        num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (num_threads <= 0)
+    {
+        num_threads = 1;
+    }
+    RobustnessEvaluator *evaluator = malloc(sizeof(RobustnessEvaluator));
+    evaluator->num_threads = num_threads;
+    evaluator->workers = malloc(num_threads * sizeof(RobustnessWorker));
+    for (int i = 0; i < num_threads; i++)
+    {
+        evaluator->workers[i].fork = create_game_fork(10);
+    }
+    evaluator->sample_capacity = 1024;
+    evaluator->samples = malloc(evaluator->sample_capacity * sizeof(RobustnessSample));
+    return evaluator;
+}
+
+void free_robustness_evaluator(RobustnessEvaluator *evaluator)
+{
+    for (int i = 0; i < evaluator->num_threads; i++)
+    {
+        free_game_fork(evaluator->workers[i].fork);
+    }
+    free(evaluator->workers);
+    free(evaluator->samples);
+    free(evaluator);
+}
+
+// splitmix64. Every sample starts its own stream from a hash of the seed and
+// its index, so no state is shared between threads.
+unsigned long long next_random(unsigned long long *state)
+{
+    unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+double random_normal(unsigned long long *state)
+{
+    double u1 = ((next_random(state) >> 11) + 1.0) / 9007199254740993.0;
+    double u2 = (next_random(state) >> 11) / 9007199254740992.0;
+    return sqrt(-2 * log(u1)) * cos(2 * PI * u2);
+}
+
+Vector3 rotate_about_z(Vector3 v, double angle)
+{
+    double c = cos(angle);
+    double s = sin(angle);
+    return (Vector3){v.x * c - v.y * s, v.x * s + v.y * c, v.z};
+}
+
+void *run_robustness_worker(void *arg)
+{
+    RobustnessWorker *worker = (RobustnessWorker *)arg;
+    for (int i = 0; i < worker->num_samples; i++)
+    {
+        unsigned long long index = worker->first_sample + i;
+        unsigned long long rng = worker->seed + index * 0x9E3779B97F4A7C15ULL;
+        rng = next_random(&rng);
+        double angle = worker->noise.angle_sigma * random_normal(&rng);
+        double speed = 1 + worker->noise.speed_sigma * random_normal(&rng);
+        Vector3 spin = {worker->noise.spin_sigma * random_normal(&rng),
+                        worker->noise.spin_sigma * random_normal(&rng),
+                        worker->noise.spin_sigma * random_normal(&rng)};
+        Vector3 v = Vector3Scale(rotate_about_z(worker->v, angle), speed);
+        Vector3 w = Vector3Add(rotate_about_z(worker->w, angle), spin);
+
+        Game *game = fork_game(worker->fork, worker->game);
+        simulate_fork(worker->fork, v, w);
+        ShotResult result = evaluate_fork(worker->fork);
+        bool object_ball_potted = false;
+        for (int j = 0; j < game->current_shot.num_events; j++)
+        {
+            ShotEvent event = game->current_shot.events[j];
+            if (event.type == BALL_POCKETED && event_ball1(&(game->scene), event)->id != 0)
+            {
+                object_ball_potted = true;
+            }
+        }
+        RobustnessSample *sample = &(worker->samples[i]);
+        sample->scratched = result.cue_ball_potted;
+        sample->potted = !result.cue_ball_potted && result.legal_first_hit && object_ball_potted;
+        if (!result.cue_ball_potted)
+        {
+            Path path = game->scene.ball_set.balls[0].path;
+            sample->rest = path.segments[path.num_segments - 1].initial_position;
+        }
+        release_game_fork(worker->fork);
+    }
+    return NULL;
+}
+
+Robustness evaluate_robustness(RobustnessEvaluator *evaluator, Game *game, Vector3 v, Vector3 w, ExecutionNoise noise, int num_samples, unsigned long long seed)
+{
+    if (num_samples > evaluator->sample_capacity)
+    {
+        while (num_samples > evaluator->sample_capacity)
+        {
+            evaluator->sample_capacity *= 2;
+        }
+        evaluator->samples = realloc(evaluator->samples, evaluator->sample_capacity * sizeof(RobustnessSample));
+    }
+    int num_threads = evaluator->num_threads;
+    pthread_t threads[num_threads];
+    int first_sample = 0;
+    for (int i = 0; i < num_threads; i++)
+    {
+        RobustnessWorker *worker = &(evaluator->workers[i]);
+        worker->game = game;
+        worker->v = v;
+        worker->w = w;
+        worker->noise = noise;
+        worker->seed = seed;
+        worker->first_sample = first_sample;
+        worker->num_samples = num_samples / num_threads + (i < num_samples % num_threads ? 1 : 0);
+        worker->samples = &(evaluator->samples[first_sample]);
+        first_sample += worker->num_samples;
+    }
+    // The calling thread takes the first share itself.
+    for (int i = 1; i < num_threads; i++)
+    {
+        pthread_create(&(threads[i]), NULL, run_robustness_worker, &(evaluator->workers[i]));
+    }
+    run_robustness_worker(&(evaluator->workers[0]));
+    for (int i = 1; i < num_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    Robustness robustness = {num_samples, 0, 0, 0, 0, {0, 0, 0}, 0};
+    int num_rested = 0;
+    double sum_x = 0;
+    double sum_y = 0;
+    double sum_xx = 0;
+    double sum_yy = 0;
+    for (int i = 0; i < num_samples; i++)
+    {
+        RobustnessSample *sample = &(evaluator->samples[i]);
+        if (sample->potted)
+        {
+            robustness.num_potted++;
+        }
+        if (sample->scratched)
+        {
+            robustness.num_scratched++;
+            continue;
+        }
+        num_rested++;
+        sum_x += sample->rest.x;
+        sum_y += sample->rest.y;
+        sum_xx += sample->rest.x * sample->rest.x;
+        sum_yy += sample->rest.y * sample->rest.y;
+    }
+    if (num_samples > 0)
+    {
+        robustness.pot_probability = (double)robustness.num_potted / num_samples;
+        robustness.scratch_probability = (double)robustness.num_scratched / num_samples;
+    }
+    if (num_rested > 0)
+    {
+        double mean_x = sum_x / num_rested;
+        double mean_y = sum_y / num_rested;
+        robustness.mean_rest_position = (Vector3){mean_x, mean_y, 0};
+        robustness.rest_spread = sqrt(fmax(0, sum_xx / num_rested - mean_x * mean_x + sum_yy / num_rested - mean_y * mean_y));
+    }
+    return robustness;
+}
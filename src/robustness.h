@@ -0,0 +1,68 @@
+#ifndef ROBUSTNESS_H
+#define ROBUSTNESS_H
+#include "game.h"
+#include "fork.h"
+
+// Standard deviations of a player's execution errors: the aim angle in
+// radians, the cue speed as a fraction of the intended speed and each
+// component of the spin in radians per second.
+typedef struct
+{
+    double angle_sigma;
+    double speed_sigma;
+    double spin_sigma;
+} ExecutionNoise;
+
+// Outcome of many noisy attempts at the same shot. The rest position
+// statistics only count samples where the cue ball stays on the table.
+typedef struct
+{
+    int num_samples;
+    int num_potted;
+    int num_scratched;
+    double pot_probability;
+    double scratch_probability;
+    Vector3 mean_rest_position;
+    double rest_spread;
+} Robustness;
+
+// What one noisy attempt did. rest is only set when the cue ball stays on
+// the table.
+typedef struct
+{
+    bool potted;
+    bool scratched;
+    Vec2 rest;
+} RobustnessSample;
+
+typedef struct
+{
+    GameFork *fork;
+    Game *game;
+    Vector3 v;
+    Vector3 w;
+    ExecutionNoise noise;
+    unsigned long long seed;
+    int first_sample;
+    int num_samples;
+    RobustnessSample *samples;
+} RobustnessWorker;
+
+typedef struct RobustnessEvaluator
+{
+    int num_threads;
+    RobustnessWorker *workers;
+    RobustnessSample *samples;
+    int sample_capacity;
+} RobustnessEvaluator;
+
+RobustnessEvaluator *create_robustness_evaluator(int num_threads);
+
+void free_robustness_evaluator(RobustnessEvaluator *evaluator);
+
+// Each sample's noise depends only on seed and the sample's index, and the
+// samples are combined in index order, so the result does not depend on the
+// number of threads.
+Robustness evaluate_robustness(RobustnessEvaluator *evaluator, Game *game, Vector3 v, Vector3 w, ExecutionNoise noise, int num_samples, unsigned long long seed);
+
+#endif // ROBUSTNESS_H
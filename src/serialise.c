@@ -1,134 +1,852 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "game.h"
+#include "serialise.h"
+#include "snapshot.h"
 
-void serialise_game(Game *game)
+#define REPLAY_BUFFER_SIZE (1 << 20)
+
+void *replay_writer_thread(void *arg)
+{
+    ReplayWriter *writer = arg;
+    pthread_mutex_lock(&(writer->lock));
+    while (true)
+    {
+        while (writer->pending_used == 0 && !writer->stopping)
+        {
+            pthread_cond_wait(&(writer->cond), &(writer->lock));
+        }
+        if (writer->pending_used == 0)
+        {
+            break;
+        }
+        size_t size = writer->pending_used;
+        pthread_mutex_unlock(&(writer->lock));
+        bool written = fwrite(writer->pending, 1, size, writer->file) == size && fflush(writer->file) == 0;
+        pthread_mutex_lock(&(writer->lock));
+        if (!written)
+        {
+            writer->failed = true;
+        }
+        writer->pending_used = 0;
+        pthread_cond_broadcast(&(writer->cond));
+    }
+    pthread_mutex_unlock(&(writer->lock));
+    return NULL;
+}
+
+void start_replay_writer_thread(ReplayWriter *writer)
+{
+    writer->pending = malloc(writer->capacity);
+    writer->pending_used = 0;
+    writer->stopping = false;
+    pthread_mutex_init(&(writer->lock), NULL);
+    pthread_cond_init(&(writer->cond), NULL);
+    writer->background = true;
+    pthread_create(&(writer->thread), NULL, replay_writer_thread, writer);
+}
+
+void stop_replay_writer_thread(ReplayWriter *writer)
+{
+    pthread_mutex_lock(&(writer->lock));
+    writer->stopping = true;
+    pthread_cond_broadcast(&(writer->cond));
+    pthread_mutex_unlock(&(writer->lock));
+    pthread_join(writer->thread, NULL);
+    pthread_mutex_destroy(&(writer->lock));
+    pthread_cond_destroy(&(writer->cond));
+    free(writer->pending);
+    writer->background = false;
+}
+
+void flush_replay_writer(ReplayWriter *writer)
+{
+    if (writer->used == 0)
+    {
+        return;
+    }
+    if (writer->background)
+    {
+        pthread_mutex_lock(&(writer->lock));
+        while (writer->pending_used > 0)
+        {
+            pthread_cond_wait(&(writer->cond), &(writer->lock));
+        }
+        char *buffer = writer->pending;
+        writer->pending = writer->buffer;
+        writer->pending_used = writer->used;
+        writer->buffer = buffer;
+        pthread_cond_broadcast(&(writer->cond));
+        pthread_mutex_unlock(&(writer->lock));
+    }
+    else if (fwrite(writer->buffer, 1, writer->used, writer->file) != writer->used)
+    {
+        writer->failed = true;
+    }
+    writer->used = 0;
+}
+
+void replay_write(ReplayWriter *writer, const void *data, size_t size)
+{
+    writer->offset += size;
+    const char *bytes = data;
+    while (size > 0)
+    {
+        if (writer->used == writer->capacity)
+        {
+            flush_replay_writer(writer);
+        }
+        size_t chunk = writer->capacity - writer->used;
+        if (chunk > size)
+        {
+            chunk = size;
+        }
+        memcpy(writer->buffer + writer->used, bytes, chunk);
+        writer->used += chunk;
+        bytes += chunk;
+        size -= chunk;
+    }
+}
+
+void replay_pad(ReplayWriter *writer)
+{
+    char zeros[8] = {0};
+    replay_write(writer, zeros, (8 - writer->offset % 8) % 8);
+}
+
+int replay_player_index(Game *game, Player *player)
+{
+    return player == NULL ? -1 : (int)(player - game->players);
+}
+
+ReplaySegment replay_segment(PathSegment *segment, Quaternion orientation)
+{
+    ReplaySegment record;
+    memset(&record, 0, sizeof(ReplaySegment));
+    record.start_time = segment->start_time;
+    record.end_time = segment->end_time;
+    record.initial_position = segment->initial_position;
+    record.initial_velocity = segment->initial_velocity;
+    record.acceleration = segment->acceleration;
+    record.initial_angular_velocity = segment->initial_angular_velocity;
+    record.angular_acceleration = segment->angular_acceleration;
+    record.initial_orientation = segment->orientations != NULL ? segment->orientations[0] : orientation;
+    record.rolling = segment->rolling;
+    return record;
+}
+
+void *replay_at(Replay *replay, uint64_t offset, uint64_t size)
+{
+    if (offset > replay->size || size > replay->size - offset)
+    {
+        return NULL;
+    }
+    return (char *)replay->data + offset;
+}
+
+ReplayWriter *create_replay_writer(FILE *file, Game *game)
 {
-    FILE *file = fopen("frames.bin", "wb");
+    ReplayWriter *writer = malloc(sizeof(ReplayWriter));
+    writer->file = file;
+    writer->buffer = malloc(REPLAY_BUFFER_SIZE);
+    writer->used = 0;
+    writer->capacity = REPLAY_BUFFER_SIZE;
+    writer->offset = 0;
+    writer->failed = false;
+    writer->background = false;
+    writer->frame_offsets = malloc(10 * sizeof(uint64_t));
+    writer->frame_capacity = 10;
+
+    ReplayHeader *header = &(writer->header);
+    memset(header, 0, sizeof(ReplayHeader));
+    memcpy(header->magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+    header->version = REPLAY_VERSION;
+    header->num_players = game->num_players;
+    header->num_balls = game->scene.ball_set.num_balls;
+    header->coefficients = game->scene.coefficients;
+    // The header goes out first and is only rewritten on close, so every
+    // offset a reader needs to walk the frames is worked out up front.
+    header->players_offset = sizeof(ReplayHeader);
+    header->balls_offset = header->players_offset + game->num_players * sizeof(ReplayPlayer);
+    for (int i = 0; i < game->num_players; i++)
+    {
+        header->balls_offset += strlen(game->players[i].module.name) + strlen(game->players[i].module.description);
+    }
+    header->balls_offset += (8 - header->balls_offset % 8) % 8;
+    header->first_frame_offset = header->balls_offset + header->num_balls * sizeof(ReplayBall);
+    return writer;
+}
+
+void free_replay_writer(ReplayWriter *writer)
+{
+    free(writer->frame_offsets);
+    free(writer->buffer);
+    free(writer);
+}
+
+ReplayWriter *open_replay_writer(char *path, Game *game)
+{
+    FILE *file = fopen(path, "wb");
     if (file == NULL)
     {
-        fprintf(stderr, "Error opening file\n");
-        exit(1);
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return NULL;
+    }
+    ReplayWriter *writer = create_replay_writer(file, game);
+    ReplayHeader *header = &(writer->header);
+    replay_write(writer, header, sizeof(ReplayHeader));
+
+    uint64_t string_offset = header->players_offset + game->num_players * sizeof(ReplayPlayer);
+    for (int i = 0; i < game->num_players; i++)
+    {
+        ReplayPlayer player;
+        player.name_length = strlen(game->players[i].module.name);
+        player.description_length = strlen(game->players[i].module.description);
+        player.name_offset = string_offset;
+        player.description_offset = string_offset + player.name_length;
+        string_offset += player.name_length + player.description_length;
+        replay_write(writer, &player, sizeof(ReplayPlayer));
     }
-    int num_frames = game->num_frames;
-    Frame *frames = game->frames;
     for (int i = 0; i < game->num_players; i++)
     {
-        char *name = game->players[i].module.name;
-        int name_length = strlen(name);
-        char *description = game->players[i].module.description;
-        int description_length = strlen(description);
-        fwrite(&name_length, sizeof(int), 1, file);
-        fwrite(name, sizeof(char), strlen(name), file);
-        fwrite(&description_length, sizeof(int), 1, file);
-        fwrite(description, sizeof(char), strlen(description), file);
+        replay_write(writer, game->players[i].module.name, strlen(game->players[i].module.name));
+        replay_write(writer, game->players[i].module.description, strlen(game->players[i].module.description));
     }
-    fwrite(&num_frames, sizeof(int), 1, file);
+    replay_pad(writer);
+
+    for (int i = 0; i < game->scene.ball_set.num_balls; i++)
+    {
+        Ball *ball = &(game->scene.ball_set.balls[i]);
+        ReplayBall record = {ball->id, {ball->colour.r, ball->colour.g, ball->colour.b, ball->colour.a}, ball->radius, ball->mass};
+        replay_write(writer, &record, sizeof(ReplayBall));
+    }
+    return writer;
+}
+
+ReplayWriter *append_replay_writer(char *path, Game *game, Replay *replay, int num_frames)
+{
+    FILE *file = fopen(path, "r+b");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return NULL;
+    }
+    ReplayWriter *writer = create_replay_writer(file, game);
+    ReplayHeader *header = &(writer->header);
+    ReplayHeader *existing = replay->header;
+    if (existing->num_players != header->num_players || existing->num_balls != header->num_balls || existing->first_frame_offset != header->first_frame_offset || memcmp(&(existing->coefficients), &(header->coefficients), sizeof(Coefficients)) != 0 || num_frames < 0 || (uint32_t)num_frames > replay->num_frames)
+    {
+        fprintf(stderr, "%s was written for a different game\n", path);
+        fclose(file);
+        free_replay_writer(writer);
+        return NULL;
+    }
+    writer->offset = header->first_frame_offset;
     for (int i = 0; i < num_frames; i++)
     {
-        fwrite(&(frames[i].num_shots), sizeof(int), 1, file);
-        for (int j = 0; j < frames[i].num_shots; j++)
+        ReplayFrame *frame = replay_frame(replay, i);
+        if (frame == NULL || replay->frame_offsets[i] != writer->offset || replay_at(replay, writer->offset, frame->size) == NULL)
+        {
+            fprintf(stderr, "%s has a damaged frame %d\n", path, i);
+            fclose(file);
+            free_replay_writer(writer);
+            return NULL;
+        }
+        if (i == writer->frame_capacity)
+        {
+            writer->frame_capacity *= 2;
+            writer->frame_offsets = realloc(writer->frame_offsets, writer->frame_capacity * sizeof(uint64_t));
+        }
+        writer->frame_offsets[i] = writer->offset;
+        writer->offset += frame->size;
+    }
+    header->num_frames = num_frames;
+    // The header on disk goes back to streaming so a crash before the
+    // close leaves a file that is read by walking the frames.
+    if (ftruncate(fileno(file), writer->offset) != 0 || fwrite(header, sizeof(ReplayHeader), 1, file) != 1 || fseek(file, writer->offset, SEEK_SET) != 0)
+    {
+        fprintf(stderr, "Failed to cut %s back to frame %d\n", path, num_frames);
+        fclose(file);
+        free_replay_writer(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+void write_replay_frame(ReplayWriter *writer, Game *game, Frame *frame)
+{
+    int num_balls = writer->header.num_balls;
+    if ((int)writer->header.num_frames == writer->frame_capacity)
+    {
+        writer->frame_capacity *= 2;
+        writer->frame_offsets = realloc(writer->frame_offsets, writer->frame_capacity * sizeof(uint64_t));
+    }
+    writer->frame_offsets[writer->header.num_frames++] = writer->offset;
+
+    // Lay out the block first so every record can carry absolute offsets.
+    ReplayFrame record;
+    record.num_shots = frame->num_shots;
+    record.winner = replay_player_index(game, frame->winner);
+    record.shots_offset = writer->offset + sizeof(ReplayFrame);
+    ReplayShot *shots = malloc((frame->num_shots + 1) * sizeof(ReplayShot));
+    uint64_t cursor = record.shots_offset + frame->num_shots * sizeof(ReplayShot);
+    for (int i = 0; i < frame->num_shots; i++)
+    {
+        Shot *shot = &(frame->shot_history[i]);
+        shots[i].player = replay_player_index(game, shot->player);
+        shots[i].num_events = shot->num_events;
+        shots[i].end_time = shot->end_time;
+        shots[i].v = shot->v;
+        shots[i].w = shot->w;
+        shots[i].events_offset = cursor;
+        cursor += shot->num_events * sizeof(ShotEvent);
+        shots[i].paths_offset = cursor;
+        cursor += num_balls * sizeof(ReplayPath);
+        for (int j = 0; j < num_balls; j++)
         {
-            fwrite(&(frames[i].shot_history[j].num_events), sizeof(int), 1, file);
-            for (int k = 0; k < frames[i].shot_history[j].num_events; k++)
+            cursor += shot->ball_paths[j].num_segments * sizeof(ReplaySegment);
+        }
+    }
+    record.size = cursor - writer->offset;
+    replay_write(writer, &record, sizeof(ReplayFrame));
+    replay_write(writer, shots, frame->num_shots * sizeof(ReplayShot));
+
+    for (int i = 0; i < frame->num_shots; i++)
+    {
+        Shot *shot = &(frame->shot_history[i]);
+        replay_write(writer, shot->events, shot->num_events * sizeof(ShotEvent));
+        uint64_t segments_offset = shots[i].paths_offset + num_balls * sizeof(ReplayPath);
+        for (int j = 0; j < num_balls; j++)
+        {
+            ReplayPath path = {segments_offset, shot->ball_paths[j].num_segments, 0};
+            segments_offset += path.num_segments * sizeof(ReplaySegment);
+            replay_write(writer, &path, sizeof(ReplayPath));
+        }
+        for (int j = 0; j < num_balls; j++)
+        {
+            Path *path = &(shot->ball_paths[j]);
+            Quaternion orientation = game->scene.ball_set.balls[j].initial_orientation;
+            for (int k = 0; k < path->num_segments; k++)
             {
-                fwrite(&(frames[i].shot_history[j].events[k].type), sizeof(ShotEventType), 1, file);
+                ReplaySegment segment = replay_segment(&(path->segments[k]), orientation);
+                replay_write(writer, &segment, sizeof(ReplaySegment));
             }
-            for (int k = 0; k < game->scene.ball_set.num_balls; k++)
+        }
+    }
+    free(shots);
+    if (writer->background)
+    {
+        flush_replay_writer(writer);
+    }
+}
+
+bool sync_replay_writer(ReplayWriter *writer)
+{
+    flush_replay_writer(writer);
+    if (!writer->background)
+    {
+        return fflush(writer->file) == 0 && !writer->failed;
+    }
+    pthread_mutex_lock(&(writer->lock));
+    while (writer->pending_used > 0)
+    {
+        pthread_cond_wait(&(writer->cond), &(writer->lock));
+    }
+    bool written = !writer->failed;
+    pthread_mutex_unlock(&(writer->lock));
+    return written;
+}
+
+// Writes the frame index and the final header. The writer is freed whether
+// or not this succeeds.
+bool close_replay_writer(ReplayWriter *writer)
+{
+    writer->header.index_offset = writer->offset;
+    replay_write(writer, writer->frame_offsets, writer->header.num_frames * sizeof(uint64_t));
+    flush_replay_writer(writer);
+    if (writer->background)
+    {
+        stop_replay_writer_thread(writer);
+    }
+    if (fseek(writer->file, 0, SEEK_SET) != 0 || fwrite(&(writer->header), sizeof(ReplayHeader), 1, writer->file) != 1)
+    {
+        writer->failed = true;
+    }
+    bool written = fclose(writer->file) == 0 && !writer->failed;
+    if (!written)
+    {
+        fprintf(stderr, "Failed to write replay\n");
+    }
+    free_replay_writer(writer);
+    return written;
+}
+
+bool serialise_game(Game *game, char *path)
+{
+    ReplayWriter *writer = open_replay_writer(path, game);
+    if (writer == NULL)
+    {
+        return false;
+    }
+    for (int i = 0; i < game->num_frames; i++)
+    {
+        write_replay_frame(writer, game, &(game->frames[i]));
+    }
+    return close_replay_writer(writer);
+}
+
+void *game_save_thread(void *arg)
+{
+    GameSave *save = arg;
+    Game *game = &(save->copy);
+    bool written = true;
+    if (save->snapshot_path != NULL)
+    {
+        written = save_snapshot(game, save->snapshot_path);
+    }
+    if (save->replay_path != NULL)
+    {
+        ReplayWriter *writer = open_replay_writer(save->replay_path, game);
+        written = written && writer != NULL;
+        for (int i = 0; writer != NULL && i < game->num_frames; i++)
+        {
+            write_replay_frame(writer, game, &(game->frames[i]));
+            pthread_mutex_lock(&(save->lock));
+            save->frames_written = i + 1;
+            pthread_mutex_unlock(&(save->lock));
+        }
+        if (writer != NULL)
+        {
+            written = close_replay_writer(writer) && written;
+        }
+    }
+    pthread_mutex_lock(&(save->lock));
+    save->state = written ? SAVE_DONE : SAVE_FAILED;
+    pthread_mutex_unlock(&(save->lock));
+    return NULL;
+}
+
+char *copy_string(char *text)
+{
+    return text == NULL ? NULL : strdup(text);
+}
+
+GameSave *start_game_save(Game *game, char *replay_path, char *snapshot_path)
+{
+    GameSave *save = malloc(sizeof(GameSave));
+    Game *copy = &(save->copy);
+    *copy = *game;
+
+    // Modules can be reloaded while the save runs, so the names are copied
+    // and the frames point at the copy's players.
+    copy->players = malloc(game->num_players * sizeof(Player));
+    for (int i = 0; i < game->num_players; i++)
+    {
+        copy->players[i] = game->players[i];
+        copy->players[i].module.name = copy_string(game->players[i].module.name);
+        copy->players[i].module.description = copy_string(game->players[i].module.description);
+        copy->players[i].module.library_path = copy_string(game->players[i].module.library_path);
+    }
+    int num_balls = game->scene.ball_set.num_balls;
+    copy->scene.ball_set.balls = malloc(num_balls * sizeof(Ball));
+    for (int i = 0; i < num_balls; i++)
+    {
+        Ball *ball = &(copy->scene.ball_set.balls[i]);
+        *ball = game->scene.ball_set.balls[i];
+        ball->path.segments = malloc((ball->path.num_segments + 1) * sizeof(PathSegment));
+        memcpy(ball->path.segments, game->scene.ball_set.balls[i].path.segments, ball->path.num_segments * sizeof(PathSegment));
+    }
+    copy->frames = malloc((game->num_frames + 1) * sizeof(Frame));
+    for (int i = 0; i < game->num_frames; i++)
+    {
+        Frame *frame = &(game->frames[i]);
+        Frame *frame_copy = &(copy->frames[i]);
+        *frame_copy = *frame;
+        frame_copy->winner = frame->winner == NULL ? NULL : &(copy->players[frame->winner - game->players]);
+        frame_copy->shot_history = malloc((frame->num_shots + 1) * sizeof(Shot));
+        for (int j = 0; j < frame->num_shots; j++)
+        {
+            frame_copy->shot_history[j] = frame->shot_history[j];
+            frame_copy->shot_history[j].player = &(copy->players[frame->shot_history[j].player - game->players]);
+        }
+    }
+
+    save->replay_path = copy_string(replay_path);
+    save->snapshot_path = copy_string(snapshot_path);
+    save->state = SAVE_RUNNING;
+    save->frames_written = 0;
+    pthread_mutex_init(&(save->lock), NULL);
+    pthread_create(&(save->thread), NULL, game_save_thread, save);
+    return save;
+}
+
+SaveState game_save_progress(GameSave *save, int *frames_written, int *num_frames)
+{
+    pthread_mutex_lock(&(save->lock));
+    SaveState state = save->state;
+    *frames_written = save->frames_written;
+    pthread_mutex_unlock(&(save->lock));
+    *num_frames = save->replay_path == NULL ? 0 : save->copy.num_frames;
+    return state;
+}
+
+void finish_game_save(GameSave *save)
+{
+    pthread_join(save->thread, NULL);
+    pthread_mutex_destroy(&(save->lock));
+    Game *copy = &(save->copy);
+    for (int i = 0; i < copy->num_players; i++)
+    {
+        free(copy->players[i].module.name);
+        free(copy->players[i].module.description);
+        free(copy->players[i].module.library_path);
+    }
+    for (int i = 0; i < copy->scene.ball_set.num_balls; i++)
+    {
+        free(copy->scene.ball_set.balls[i].path.segments);
+    }
+    for (int i = 0; i < copy->num_frames; i++)
+    {
+        free(copy->frames[i].shot_history);
+    }
+    free(copy->players);
+    free(copy->scene.ball_set.balls);
+    free(copy->frames);
+    free(save->replay_path);
+    free(save->snapshot_path);
+    free(save);
+}
+
+// Maps a replay read-only. Only the header and the position of the index
+// are checked, so opening takes the same time whatever the size of the file.
+// A file that was never closed has no index and its frames are found by
+// walking the blocks instead.
+Replay *open_replay(char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open replay %s\n", path);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ReplayHeader))
+    {
+        fprintf(stderr, "Replay %s is too small\n", path);
+        close(fd);
+        return NULL;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map replay %s\n", path);
+        return NULL;
+    }
+    ReplayHeader *header = data;
+    if (memcmp(header->magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) != 0 || header->version != REPLAY_VERSION)
+    {
+        fprintf(stderr, "Replay %s is not a version %d replay\n", path, REPLAY_VERSION);
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    Replay *replay = malloc(sizeof(Replay));
+    replay->data = data;
+    replay->size = st.st_size;
+    replay->header = header;
+    if (header->index_offset != 0)
+    {
+        if (header->index_offset > (uint64_t)st.st_size || header->num_frames * sizeof(uint64_t) > st.st_size - header->index_offset)
+        {
+            fprintf(stderr, "Replay %s has a truncated frame index\n", path);
+            munmap(data, st.st_size);
+            free(replay);
+            return NULL;
+        }
+        replay->num_frames = header->num_frames;
+        replay->frame_offsets = (uint64_t *)((char *)data + header->index_offset);
+        replay->scanned = false;
+        return replay;
+    }
+
+    // The writer never got to close the file. Every complete frame block is
+    // still usable, so walk them until the first one that was cut short.
+    int capacity = 16;
+    replay->num_frames = 0;
+    replay->frame_offsets = malloc(capacity * sizeof(uint64_t));
+    replay->scanned = true;
+    uint64_t offset = header->first_frame_offset;
+    ReplayFrame *frame;
+    while ((frame = replay_at(replay, offset, sizeof(ReplayFrame))) != NULL && frame->size >= sizeof(ReplayFrame) && replay_at(replay, offset, frame->size) != NULL)
+    {
+        if ((int)replay->num_frames == capacity)
+        {
+            capacity *= 2;
+            replay->frame_offsets = realloc(replay->frame_offsets, capacity * sizeof(uint64_t));
+        }
+        replay->frame_offsets[replay->num_frames++] = offset;
+        offset += frame->size;
+    }
+    fprintf(stderr, "Replay %s was not closed, recovered %u frames\n", path, replay->num_frames);
+    return replay;
+}
+
+void close_replay(Replay *replay)
+{
+    if (replay->scanned)
+    {
+        free(replay->frame_offsets);
+    }
+    munmap(replay->data, replay->size);
+    free(replay);
+}
+
+ReplayPlayer *replay_player(Replay *replay, int player)
+{
+    if (player < 0 || player >= (int)replay->header->num_players)
+    {
+        return NULL;
+    }
+    return replay_at(replay, replay->header->players_offset + player * sizeof(ReplayPlayer), sizeof(ReplayPlayer));
+}
+
+char *replay_text(Replay *replay, uint64_t offset, uint32_t length)
+{
+    return replay_at(replay, offset, length);
+}
+
+ReplayBall *replay_ball(Replay *replay, int ball)
+{
+    if (ball < 0 || ball >= (int)replay->header->num_balls)
+    {
+        return NULL;
+    }
+    return replay_at(replay, replay->header->balls_offset + ball * sizeof(ReplayBall), sizeof(ReplayBall));
+}
+
+ReplayFrame *replay_frame(Replay *replay, int frame)
+{
+    if (frame < 0 || frame >= (int)replay->num_frames)
+    {
+        return NULL;
+    }
+    return replay_at(replay, replay->frame_offsets[frame], sizeof(ReplayFrame));
+}
+
+ReplayShot *replay_shot(Replay *replay, ReplayFrame *frame, int shot)
+{
+    if (shot < 0 || shot >= (int)frame->num_shots)
+    {
+        return NULL;
+    }
+    return replay_at(replay, frame->shots_offset + shot * sizeof(ReplayShot), sizeof(ReplayShot));
+}
+
+ShotEvent *replay_events(Replay *replay, ReplayShot *shot)
+{
+    return replay_at(replay, shot->events_offset, shot->num_events * sizeof(ShotEvent));
+}
+
+ReplayPath *replay_path(Replay *replay, ReplayShot *shot, int ball)
+{
+    if (ball < 0 || ball >= (int)replay->header->num_balls)
+    {
+        return NULL;
+    }
+    return replay_at(replay, shot->paths_offset + ball * sizeof(ReplayPath), sizeof(ReplayPath));
+}
+
+ReplaySegment *replay_segments(Replay *replay, ReplayPath *path)
+{
+    return replay_at(replay, path->segments_offset, path->num_segments * sizeof(ReplaySegment));
+}
+
+void free_frame_shots(Frame *frame, int num_balls)
+{
+    for (int i = 0; i < frame->num_shots; i++)
+    {
+        Shot *shot = &(frame->shot_history[i]);
+        for (int j = 0; j < num_balls; j++)
+        {
+            free(shot->ball_paths[j].segments);
+        }
+        free(shot->ball_paths);
+        free(shot->events);
+    }
+    free(frame->shot_history);
+    frame->shot_history = NULL;
+    frame->num_shots = 0;
+}
+
+Player *replay_game_player(Game *game, int32_t player)
+{
+    return player >= 0 && player < game->num_players ? &(game->players[player]) : NULL;
+}
+
+bool read_replay_frame(Replay *replay, int index, Game *game, Frame *frame)
+{
+    ReplayFrame *record = replay_frame(replay, index);
+    int num_balls = replay->header->num_balls;
+    if (record == NULL || num_balls != game->scene.ball_set.num_balls)
+    {
+        return false;
+    }
+    frame->winner = replay_game_player(game, record->winner);
+    frame->num_shots = 0;
+    frame->shot_capacity = record->num_shots > 0 ? record->num_shots : 1;
+    frame->shot_history = malloc(frame->shot_capacity * sizeof(Shot));
+    for (uint32_t i = 0; i < record->num_shots; i++)
+    {
+        ReplayShot *shot_record = replay_shot(replay, record, i);
+        ShotEvent *events = shot_record == NULL ? NULL : replay_events(replay, shot_record);
+        ReplayPath *paths = shot_record == NULL ? NULL : replay_at(replay, shot_record->paths_offset, num_balls * sizeof(ReplayPath));
+        bool valid = events != NULL && paths != NULL;
+        for (int j = 0; valid && j < num_balls; j++)
+        {
+            valid = replay_segments(replay, &(paths[j])) != NULL;
+        }
+        if (!valid)
+        {
+            free_frame_shots(frame, num_balls);
+            return false;
+        }
+
+        Shot *shot = &(frame->shot_history[frame->num_shots++]);
+        shot->player = replay_game_player(game, shot_record->player);
+        shot->end_time = shot_record->end_time;
+        shot->v = shot_record->v;
+        shot->w = shot_record->w;
+        shot->num_events = shot_record->num_events;
+        shot->event_capacity = shot->num_events > 0 ? shot->num_events : 1;
+        shot->events = malloc(shot->event_capacity * sizeof(ShotEvent));
+        memcpy(shot->events, events, shot->num_events * sizeof(ShotEvent));
+        shot->ball_paths = malloc(num_balls * sizeof(Path));
+        for (int j = 0; j < num_balls; j++)
+        {
+            ReplaySegment *segments = replay_segments(replay, &(paths[j]));
+            Path *path = &(shot->ball_paths[j]);
+            path->num_segments = paths[j].num_segments;
+            path->capacity = path->num_segments > 0 ? path->num_segments : 1;
+            path->segments = malloc(path->capacity * sizeof(PathSegment));
+            for (int k = 0; k < path->num_segments; k++)
             {
-                fwrite(&(frames[i].shot_history[j].ball_paths[k].num_segments), sizeof(int), 1, file);
-                for (int l = 0; l < frames[i].shot_history[j].ball_paths[k].num_segments; l++)
-                {
-                    fwrite(&(frames[i].shot_history[j].ball_paths[k].segments[l].initial_position), sizeof(Vector3), 1, file);
-                    fwrite(&(frames[i].shot_history[j].ball_paths[k].segments[l].initial_velocity), sizeof(Vector3), 1, file);
-                    fwrite(&(frames[i].shot_history[j].ball_paths[k].segments[l].acceleration), sizeof(Vector3), 1, file);
-                    fwrite(&(frames[i].shot_history[j].ball_paths[k].segments[l].start_time), sizeof(double), 1, file);
-                    fwrite(&(frames[i].shot_history[j].ball_paths[k].segments[l].end_time), sizeof(double), 1, file);
-                }
+                ReplaySegment *segment = &(segments[k]);
+                path->segments[k] = (PathSegment){segment->initial_position, segment->initial_velocity, segment->acceleration, segment->initial_angular_velocity, segment->angular_acceleration, segment->rolling, segment->start_time, segment->end_time, NULL};
             }
         }
     }
-    fclose(file);
+    return true;
+}
+
+void report_bad_record(char *filename, char *record, uint64_t offset)
+{
+    fprintf(stderr, "%s: %s at offset %llu lies outside the file\n", filename, record, (unsigned long long)offset);
 }
 
+// Prints a replay record by record. A record that lies outside the file is
+// reported with its offset and nothing after it is printed.
 void deserialise_game(char *filename)
 {
-    FILE *file = fopen(filename, "rb");
-    if (file == NULL)
+    Replay *replay = open_replay(filename);
+    if (replay == NULL)
     {
-        fprintf(stderr, "Error opening file\n");
         exit(1);
     }
-    for (int i = 0; i < 2; i++)
-    {
-        int name_length;
-        fread(&name_length, sizeof(int), 1, file);
-        char name[name_length + 1];
-        fread(name, sizeof(char), name_length, file);
-        name[name_length] = '\0';
-        printf("Name: %s\n", name);
-        int description_length;
-        fread(&description_length, sizeof(int), 1, file);
-        char description[description_length + 1];
-        fread(description, sizeof(char), description_length, file);
-        description[description_length] = '\0';
-        printf("Description: %s\n", description);
-    }
-
-    int num_frames;
-    fread(&num_frames, sizeof(int), 1, file);
-    printf("Num frames: %d\n", num_frames);
-    for (int i = 0; i < num_frames; i++)
+    ReplayHeader *header = replay->header;
+    for (uint32_t i = 0; i < header->num_players; i++)
     {
-        printf("Frame %d\n", i + 1);
-        int num_shots;
-        fread(&num_shots, sizeof(int), 1, file);
-        printf("Num shots: %d\n", num_shots);
+        ReplayPlayer *player = replay_player(replay, i);
+        if (player == NULL)
+        {
+            report_bad_record(filename, "player", header->players_offset + i * sizeof(ReplayPlayer));
+            close_replay(replay);
+            return;
+        }
+        char *name = replay_text(replay, player->name_offset, player->name_length);
+        char *description = replay_text(replay, player->description_offset, player->description_length);
+        if (name == NULL || description == NULL)
+        {
+            report_bad_record(filename, "player name", name == NULL ? player->name_offset : player->description_offset);
+            close_replay(replay);
+            return;
+        }
+        printf("Name: %.*s\n", (int)player->name_length, name);
+        printf("Description: %.*s\n", (int)player->description_length, description);
+    }
 
-        for (int j = 0; j < num_shots; j++)
+    printf("Num frames: %u\n", replay->num_frames);
+    for (uint32_t i = 0; i < replay->num_frames; i++)
+    {
+        ReplayFrame *frame = replay_frame(replay, i);
+        if (frame == NULL)
+        {
+            report_bad_record(filename, "frame", replay->frame_offsets[i]);
+            close_replay(replay);
+            return;
+        }
+        printf("Frame %u\n", i + 1);
+        printf("Num shots: %u\n", frame->num_shots);
+        for (uint32_t j = 0; j < frame->num_shots; j++)
         {
-            printf("Shot %d\n", j + 1);
-            int num_events;
-            fread(&num_events, sizeof(int), 1, file);
-            printf("Num events: %d\n", num_events);
-            for (int k = 0; k < num_events; k++)
+            ReplayShot *shot = replay_shot(replay, frame, j);
+            if (shot == NULL)
             {
-                ShotEventType type;
-                fread(&type, sizeof(ShotEventType), 1, file);
+                report_bad_record(filename, "shot", frame->shots_offset + j * sizeof(ReplayShot));
+                close_replay(replay);
+                return;
+            }
+            ShotEvent *events = replay_events(replay, shot);
+            if (events == NULL)
+            {
+                report_bad_record(filename, "events", shot->events_offset);
+                close_replay(replay);
+                return;
+            }
+            printf("Shot %u\n", j + 1);
+            printf("Num events: %u\n", shot->num_events);
+            for (uint32_t k = 0; k < shot->num_events; k++)
+            {
+                ShotEventType type = events[k].type;
                 printf("Event type: %s\n", type == BALL_BALL_COLLISION ? "Ball Ball Collision" : type == BALL_CUSHION_COLLISION ? "Ball Cushion Collision"
                                                                                              : type == BALL_POCKETED            ? "Ball Potted"
                                                                                              : type == BALL_ROLL                ? "Ball Roll"
                                                                                              : type == BALL_STOP                ? "Ball Stop"
                                                                                                                                 : "None");
             }
-            for (int k = 0; k < 10; k++)
+            for (uint32_t k = 0; k < header->num_balls; k++)
             {
-                printf("Ball %d\n", k + 1);
-                int num_segments;
-                fread(&num_segments, sizeof(int), 1, file);
-                printf("Num segments: %d\n", num_segments);
-                for (int l = 0; l < num_segments; l++)
+                ReplayPath *path = replay_path(replay, shot, k);
+                if (path == NULL)
+                {
+                    report_bad_record(filename, "path", shot->paths_offset + k * sizeof(ReplayPath));
+                    close_replay(replay);
+                    return;
+                }
+                ReplaySegment *segments = replay_segments(replay, path);
+                if (segments == NULL)
+                {
+                    report_bad_record(filename, "segments", path->segments_offset);
+                    close_replay(replay);
+                    return;
+                }
+                printf("Ball %u\n", k + 1);
+                printf("Num segments: %u\n", path->num_segments);
+                for (uint32_t l = 0; l < path->num_segments; l++)
                 {
-                    Vector3 initial_position;
-                    fread(&initial_position, sizeof(Vector3), 1, file);
-                    Vector3 initial_velocity;
-                    fread(&initial_velocity, sizeof(Vector3), 1, file);
-                    Vector3 acceleration;
-                    fread(&acceleration, sizeof(Vector3), 1, file);
-                    double start_time;
-                    fread(&start_time, sizeof(double), 1, file);
-                    double end_time;
-                    fread(&end_time, sizeof(double), 1, file);
-                    printf("Segment %d\n", l + 1);
-                    printf("Initial position: (%f, %f, %f)\n", initial_position.x, initial_position.y, initial_position.z);
-                    printf("Initial velocity: (%f, %f, %f)\n", initial_velocity.x, initial_velocity.y, initial_velocity.z);
-                    printf("Acceleration: (%f, %f, %f)\n", acceleration.x, acceleration.y, acceleration.z);
-                    printf("Start time: %f\n", start_time);
-                    printf("End time: %f\n", end_time);
+                    printf("Segment %u\n", l + 1);
+                    printf("Initial position: (%f, %f)\n", segments[l].initial_position.x, segments[l].initial_position.y);
+                    printf("Initial velocity: (%f, %f)\n", segments[l].initial_velocity.x, segments[l].initial_velocity.y);
+                    printf("Acceleration: (%f, %f)\n", segments[l].acceleration.x, segments[l].acceleration.y);
+                    printf("Start time: %f\n", segments[l].start_time);
+                    printf("End time: %f\n", segments[l].end_time);
                 }
             }
         }
     }
-    fclose(file);
+    close_replay(replay);
 }
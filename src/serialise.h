@@ -1,4 +1,212 @@
+#ifndef SERIALISE_H
+#define SERIALISE_H
 #include "game.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
 
-void serialise_game(Game *game);
-void deserialise_game(char *filename);
\ No newline at end of file
+#define REPLAY_MAGIC "POOLRPL"
+#define REPLAY_VERSION 1
+
+// A replay file starts with a ReplayHeader, the players and the ball set,
+// followed by one self-contained block per frame and finally an index of
+// frame block offsets. Every record has a fixed size and all offsets are
+// absolute file positions, so any shot can be reached from the index
+// without reading the frames before it. index_offset stays 0 until the
+// last frame has been written, and a file without an index is read by
+// walking the frame blocks, which is how a run that died partway through
+// is recovered.
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t num_players;
+    uint32_t num_balls;
+    uint32_t num_frames;
+    uint64_t players_offset;
+    uint64_t balls_offset;
+    uint64_t first_frame_offset;
+    uint64_t index_offset;
+    Coefficients coefficients;
+} ReplayHeader;
+
+// Names and descriptions are stored without terminators.
+typedef struct
+{
+    uint64_t name_offset;
+    uint64_t description_offset;
+    uint32_t name_length;
+    uint32_t description_length;
+} ReplayPlayer;
+
+typedef struct
+{
+    int32_t id;
+    uint8_t colour[4];
+    double radius;
+    double mass;
+} ReplayBall;
+
+// The first record of a frame block. size covers the whole block.
+typedef struct
+{
+    uint32_t num_shots;
+    int32_t winner;
+    uint64_t size;
+    uint64_t shots_offset;
+} ReplayFrame;
+
+// Events are stored as ShotEvent records and each shot has one ReplayPath
+// per ball. v and w are the strike the shot was played with.
+typedef struct
+{
+    int32_t player;
+    uint32_t num_events;
+    double end_time;
+    uint64_t events_offset;
+    uint64_t paths_offset;
+    Vector3 v;
+    Vector3 w;
+} ReplayShot;
+
+typedef struct
+{
+    uint64_t segments_offset;
+    uint32_t num_segments;
+    uint32_t reserved;
+} ReplayPath;
+
+typedef struct
+{
+    double start_time;
+    double end_time;
+    Vec2 initial_position;
+    Vec2 initial_velocity;
+    Vec2 acceleration;
+    Vector3 initial_angular_velocity;
+    Vector3 angular_acceleration;
+    Quaternion initial_orientation;
+    uint32_t rolling;
+    uint32_t reserved;
+} ReplaySegment;
+
+// Collects records in a buffer and writes them to the file in large blocks.
+// Once a background thread is started the writer keeps a second buffer:
+// a full buffer is handed to the thread and filling carries on in the
+// other, so the caller only waits when the thread is a whole buffer behind.
+typedef struct
+{
+    FILE *file;
+    char *buffer;
+    size_t used;
+    size_t capacity;
+    uint64_t offset;
+    bool failed;
+    ReplayHeader header;
+    uint64_t *frame_offsets;
+    int frame_capacity;
+
+    bool background;
+    bool stopping;
+    char *pending;
+    size_t pending_used;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} ReplayWriter;
+
+ReplayWriter *open_replay_writer(char *path, Game *game);
+
+// Moves file writes onto a background thread. Each frame is handed over as
+// soon as it has been laid out, so a crash loses at most the frames the
+// thread has not yet written.
+void start_replay_writer_thread(ReplayWriter *writer);
+
+void write_replay_frame(ReplayWriter *writer, Game *game, Frame *frame);
+
+// Waits until every frame written so far is in the file. Returns false if
+// a write has failed.
+bool sync_replay_writer(ReplayWriter *writer);
+
+bool close_replay_writer(ReplayWriter *writer);
+
+// A replay file mapped read-only. The accessors return pointers straight
+// into the mapping, or NULL when a record would lie outside the file.
+typedef struct
+{
+    void *data;
+    size_t size;
+    ReplayHeader *header;
+    uint32_t num_frames;
+    uint64_t *frame_offsets;
+    bool scanned;
+} Replay;
+
+// Reopens the streamed replay at path, which replay maps, to carry on
+// writing after its first num_frames frames. Anything after them is cut
+// off. Returns NULL if the file was written for a different table or holds
+// fewer frames.
+ReplayWriter *append_replay_writer(char *path, Game *game, Replay *replay, int num_frames);
+
+bool serialise_game(Game *game, char *path);
+
+typedef enum
+{
+    SAVE_RUNNING,
+    SAVE_DONE,
+    SAVE_FAILED
+} SaveState;
+
+// A save running on its own thread from a copy of the game. The copy
+// shares the finished shots with the game, which never change once taken,
+// and copies everything the game keeps changing. The snapshot is written
+// first and the replay after it; either path can be NULL.
+typedef struct
+{
+    Game copy;
+    char *replay_path;
+    char *snapshot_path;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    SaveState state;
+    int frames_written;
+} GameSave;
+
+GameSave *start_game_save(Game *game, char *replay_path, char *snapshot_path);
+
+SaveState game_save_progress(GameSave *save, int *frames_written, int *num_frames);
+
+// Waits for the save to finish and frees it.
+void finish_game_save(GameSave *save);
+
+Replay *open_replay(char *path);
+
+void close_replay(Replay *replay);
+
+ReplayPlayer *replay_player(Replay *replay, int player);
+
+char *replay_text(Replay *replay, uint64_t offset, uint32_t length);
+
+ReplayBall *replay_ball(Replay *replay, int ball);
+
+ReplayFrame *replay_frame(Replay *replay, int frame);
+
+ReplayShot *replay_shot(Replay *replay, ReplayFrame *frame, int shot);
+
+ShotEvent *replay_events(Replay *replay, ReplayShot *shot);
+
+ReplayPath *replay_path(Replay *replay, ReplayShot *shot, int ball);
+
+ReplaySegment *replay_segments(Replay *replay, ReplayPath *path);
+
+// Reads a frame back into memory with its shots, players and winner
+// pointing into game. Segments come back without orientation tables.
+// Returns false, leaving nothing allocated, if a record lies outside the
+// file.
+bool read_replay_frame(Replay *replay, int index, Game *game, Frame *frame);
+
+void free_frame_shots(Frame *frame, int num_balls);
+
+void deserialise_game(char *filename);
+
+#endif // SERIALISE_H
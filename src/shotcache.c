@@ -0,0 +1,382 @@
+#include "shotcache.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+ShotCache *shared_shot_cache = NULL;
+pthread_mutex_t shared_shot_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+ShotSummary *create_shot_summary()
+{
+    ShotSummary *summary = malloc(sizeof(ShotSummary));
+    summary->num_balls = 0;
+    summary->ball_capacity = 10;
+    summary->rest_positions = malloc(summary->ball_capacity * sizeof(Vector3));
+    summary->pocketed = malloc(summary->ball_capacity * sizeof(bool));
+    summary->num_events = 0;
+    summary->event_capacity = 10;
+    summary->events = malloc(summary->event_capacity * sizeof(ShotEvent));
+    return summary;
+}
+
+void free_shot_summary(ShotSummary *summary)
+{
+    free(summary->rest_positions);
+    free(summary->pocketed);
+    free(summary->events);
+    free(summary);
+}
+
+void reserve_summary(ShotSummary *summary, int num_balls, int num_events)
+{
+    if (num_balls > summary->ball_capacity)
+    {
+        while (summary->ball_capacity < num_balls)
+        {
+            summary->ball_capacity *= 2;
+        }
+        summary->rest_positions = realloc(summary->rest_positions, summary->ball_capacity * sizeof(Vector3));
+        summary->pocketed = realloc(summary->pocketed, summary->ball_capacity * sizeof(bool));
+    }
+    if (num_events > summary->event_capacity)
+    {
+        while (summary->event_capacity < num_events)
+        {
+            summary->event_capacity *= 2;
+        }
+        summary->events = realloc(summary->events, summary->event_capacity * sizeof(ShotEvent));
+    }
+}
+
+void copy_summary(ShotSummary *to, ShotSummary *from)
+{
+    reserve_summary(to, from->num_balls, from->num_events);
+    to->result = from->result;
+    to->num_balls = from->num_balls;
+    to->num_events = from->num_events;
+    memcpy(to->rest_positions, from->rest_positions, from->num_balls * sizeof(Vector3));
+    memcpy(to->pocketed, from->pocketed, from->num_balls * sizeof(bool));
+    memcpy(to->events, from->events, from->num_events * sizeof(ShotEvent));
+}
+
+// Summarises the current shot of a game whose paths have been simulated.
+void summarise_shot(Game *game, ShotSummary *summary)
+{
+    Scene *scene = &(game->scene);
+    Shot *shot = &(game->current_shot);
+    Ball *balls = scene->ball_set.balls;
+    reserve_summary(summary, scene->ball_set.num_balls, shot->num_events);
+    summary->result = evaluate_shot(scene, shot);
+    summary->num_balls = scene->ball_set.num_balls;
+    for (int i = 0; i < scene->ball_set.num_balls; i++)
+    {
+        Path path = balls[i].path;
+        summary->rest_positions[i] = path.num_segments > 0 ? Vec2ToVector3(path.segments[path.num_segments - 1].initial_position) : balls[i].initial_position;
+        summary->pocketed[i] = balls[i].pocketed;
+    }
+    summary->num_events = shot->num_events;
+    memcpy(summary->events, shot->events, shot->num_events * sizeof(ShotEvent));
+    for (int i = 0; i < shot->num_events; i++)
+    {
+        if (shot->events[i].type == BALL_POCKETED)
+        {
+            summary->pocketed[shot->events[i].ball1] = true;
+        }
+    }
+    summary->pocketed[0] = false;
+}
+
+ShotCache *create_shot_cache(size_t max_bytes)
+{
+    ShotCache *cache = malloc(sizeof(ShotCache));
+    cache->max_bytes = max_bytes;
+    cache->bytes = 0;
+    cache->num_entries = 0;
+    cache->num_buckets = 1024;
+    cache->buckets = calloc(cache->num_buckets, sizeof(ShotCacheEntry *));
+    cache->newest = NULL;
+    cache->oldest = NULL;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+    pthread_mutex_init(&(cache->lock), NULL);
+    return cache;
+}
+
+void free_cache_entry(ShotCacheEntry *entry)
+{
+    free(entry->key);
+    free(entry->summary.rest_positions);
+    free(entry->summary.pocketed);
+    free(entry->summary.events);
+    free(entry);
+}
+
+void free_shot_cache(ShotCache *cache)
+{
+    ShotCacheEntry *entry = cache->newest;
+    while (entry != NULL)
+    {
+        ShotCacheEntry *older = entry->older;
+        free_cache_entry(entry);
+        entry = older;
+    }
+    free(cache->buckets);
+    pthread_mutex_destroy(&(cache->lock));
+    free(cache);
+}
+
+// One cache shared by every pipeline in the process.
+ShotCache *default_shot_cache()
+{
+    pthread_mutex_lock(&shared_shot_cache_lock);
+    if (shared_shot_cache == NULL)
+    {
+        shared_shot_cache = create_shot_cache(64 << 20);
+    }
+    pthread_mutex_unlock(&shared_shot_cache_lock);
+    return shared_shot_cache;
+}
+
+int shot_key_length(Scene *scene)
+{
+    return 2 + 3 * scene->ball_set.num_balls + sizeof(Coefficients) / sizeof(long long) + 6;
+}
+
+long long float_bits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(float));
+    return bits;
+}
+
+void make_shot_key(Scene *scene, Vector3 v, Vector3 w, int max_events, long long *key)
+{
+    int n = 0;
+    key[n++] = scene->ball_set.num_balls;
+    key[n++] = max_events;
+    for (int i = 0; i < scene->ball_set.num_balls; i++)
+    {
+        Ball *ball = &(scene->ball_set.balls[i]);
+        key[n++] = float_bits(ball->initial_position.x);
+        key[n++] = float_bits(ball->initial_position.y);
+        key[n++] = ball->pocketed;
+    }
+    memcpy(&(key[n]), &(scene->coefficients), sizeof(Coefficients));
+    n += sizeof(Coefficients) / sizeof(long long);
+    key[n++] = float_bits(v.x);
+    key[n++] = float_bits(v.y);
+    key[n++] = float_bits(v.z);
+    key[n++] = float_bits(w.x);
+    key[n++] = float_bits(w.y);
+    key[n++] = float_bits(w.z);
+}
+
+unsigned long long hash_shot_key(long long *key, int key_length)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    for (int i = 0; i < key_length; i++)
+    {
+        hash ^= (unsigned long long)key[i];
+        hash *= 1099511628211ULL;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+ShotCacheEntry *find_cache_entry(ShotCache *cache, long long *key, int key_length, unsigned long long hash)
+{
+    ShotCacheEntry *entry = cache->buckets[hash & (cache->num_buckets - 1)];
+    while (entry != NULL)
+    {
+        if (entry->hash == hash && entry->key_length == key_length && memcmp(entry->key, key, key_length * sizeof(long long)) == 0)
+        {
+            return entry;
+        }
+        entry = entry->next_in_bucket;
+    }
+    return NULL;
+}
+
+void unlink_cache_entry(ShotCache *cache, ShotCacheEntry *entry)
+{
+    if (entry->newer != NULL)
+    {
+        entry->newer->older = entry->older;
+    }
+    else
+    {
+        cache->newest = entry->older;
+    }
+    if (entry->older != NULL)
+    {
+        entry->older->newer = entry->newer;
+    }
+    else
+    {
+        cache->oldest = entry->newer;
+    }
+}
+
+void push_cache_entry(ShotCache *cache, ShotCacheEntry *entry)
+{
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    if (cache->newest != NULL)
+    {
+        cache->newest->newer = entry;
+    }
+    cache->newest = entry;
+    if (cache->oldest == NULL)
+    {
+        cache->oldest = entry;
+    }
+}
+
+void evict_cache_entries(ShotCache *cache)
+{
+    while (cache->bytes > cache->max_bytes && cache->oldest != NULL)
+    {
+        ShotCacheEntry *entry = cache->oldest;
+        ShotCacheEntry **link = &(cache->buckets[entry->hash & (cache->num_buckets - 1)]);
+        while (*link != entry)
+        {
+            link = &((*link)->next_in_bucket);
+        }
+        *link = entry->next_in_bucket;
+        unlink_cache_entry(cache, entry);
+        cache->bytes -= entry->bytes;
+        cache->num_entries--;
+        cache->evictions++;
+        free_cache_entry(entry);
+    }
+}
+
+void grow_cache_buckets(ShotCache *cache)
+{
+    int num_buckets = cache->num_buckets * 2;
+    ShotCacheEntry **buckets = calloc(num_buckets, sizeof(ShotCacheEntry *));
+    for (ShotCacheEntry *entry = cache->newest; entry != NULL; entry = entry->older)
+    {
+        int bucket = entry->hash & (num_buckets - 1);
+        entry->next_in_bucket = buckets[bucket];
+        buckets[bucket] = entry;
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->num_buckets = num_buckets;
+}
+
+void set_shot_cache_limit(ShotCache *cache, size_t max_bytes)
+{
+    pthread_mutex_lock(&(cache->lock));
+    cache->max_bytes = max_bytes;
+    evict_cache_entries(cache);
+    pthread_mutex_unlock(&(cache->lock));
+}
+
+// Copies the cached summary of a strike into summary and marks it as the
+// most recently used. Returns false on a miss.
+bool lookup_shot_cache(ShotCache *cache, Scene *scene, Vector3 v, Vector3 w, int max_events, ShotSummary *summary)
+{
+    int key_length = shot_key_length(scene);
+    long long key[key_length];
+    make_shot_key(scene, v, w, max_events, key);
+    unsigned long long hash = hash_shot_key(key, key_length);
+
+    pthread_mutex_lock(&(cache->lock));
+    ShotCacheEntry *entry = find_cache_entry(cache, key, key_length, hash);
+    if (entry == NULL)
+    {
+        cache->misses++;
+        pthread_mutex_unlock(&(cache->lock));
+        return false;
+    }
+    cache->hits++;
+    unlink_cache_entry(cache, entry);
+    push_cache_entry(cache, entry);
+    copy_summary(summary, &(entry->summary));
+    pthread_mutex_unlock(&(cache->lock));
+    return true;
+}
+
+void store_shot_cache(ShotCache *cache, Scene *scene, Vector3 v, Vector3 w, int max_events, ShotSummary *summary)
+{
+    int key_length = shot_key_length(scene);
+    ShotCacheEntry *entry = malloc(sizeof(ShotCacheEntry));
+    entry->key = malloc(key_length * sizeof(long long));
+    entry->key_length = key_length;
+    make_shot_key(scene, v, w, max_events, entry->key);
+    entry->hash = hash_shot_key(entry->key, key_length);
+    entry->summary.ball_capacity = summary->num_balls;
+    entry->summary.rest_positions = malloc(summary->num_balls * sizeof(Vector3));
+    entry->summary.pocketed = malloc(summary->num_balls * sizeof(bool));
+    entry->summary.event_capacity = summary->num_events;
+    entry->summary.events = malloc(summary->num_events * sizeof(ShotEvent));
+    copy_summary(&(entry->summary), summary);
+    entry->bytes = sizeof(ShotCacheEntry) + key_length * sizeof(long long) + summary->num_balls * (sizeof(Vector3) + sizeof(bool)) + summary->num_events * sizeof(ShotEvent);
+
+    pthread_mutex_lock(&(cache->lock));
+    // Another thread may have simulated the same strike in the meantime.
+    if (find_cache_entry(cache, entry->key, key_length, entry->hash) != NULL)
+    {
+        pthread_mutex_unlock(&(cache->lock));
+        free_cache_entry(entry);
+        return;
+    }
+    if (cache->num_entries >= cache->num_buckets)
+    {
+        grow_cache_buckets(cache);
+    }
+    int bucket = entry->hash & (cache->num_buckets - 1);
+    entry->next_in_bucket = cache->buckets[bucket];
+    cache->buckets[bucket] = entry;
+    push_cache_entry(cache, entry);
+    cache->bytes += entry->bytes;
+    cache->num_entries++;
+    evict_cache_entries(cache);
+    pthread_mutex_unlock(&(cache->lock));
+}
+
+// Summarises a strike from the game's table, simulating it in fork only when
+// the cache has not seen it. max_events limits the simulation as in
+// simulate_fork_until.
+void simulate_cached(ShotCache *cache, GameFork *fork, Game *game, Vector3 v, Vector3 w, int max_events, ShotSummary *summary)
+{
+    if (lookup_shot_cache(cache, &(game->scene), v, w, max_events, summary))
+    {
+        return;
+    }
+    Game *forked = fork_game(fork, game);
+    simulate_fork_until(fork, v, w, max_events);
+    summarise_shot(forked, summary);
+    release_game_fork(fork);
+    store_shot_cache(cache, &(game->scene), v, w, max_events, summary);
+    if (max_events > 0 && summary->num_events < max_events)
+    {
+        store_shot_cache(cache, &(game->scene), v, w, 0, summary);
+    }
+}
+
+// Forks the game and moves it on to the table a summarised shot leaves, as
+// advance_fork does after a simulation.
+Game *fork_after_summary(GameFork *fork, Game *game, ShotSummary *summary)
+{
+    Game *forked = fork_game(fork, game);
+    for (int i = 0; i < forked->scene.ball_set.num_balls; i++)
+    {
+        forked->scene.ball_set.balls[i].initial_position = summary->rest_positions[i];
+        forked->scene.ball_set.balls[i].pocketed = summary->pocketed[i];
+    }
+    advance_fork(fork);
+    return forked;
+}
+
+void print_shot_cache_stats(ShotCache *cache)
+{
+    pthread_mutex_lock(&(cache->lock));
+    long long lookups = cache->hits + cache->misses;
+    printf("Shot cache: %lld hits, %lld misses (%.1f%%), %d entries, %.1f of %.1f MB, %lld evictions\n", cache->hits, cache->misses, lookups > 0 ? 100.0 * cache->hits / lookups : 0, cache->num_entries, cache->bytes / 1048576.0, cache->max_bytes / 1048576.0, cache->evictions);
+    pthread_mutex_unlock(&(cache->lock));
+}
@@ -0,0 +1,79 @@
+#ifndef SHOTCACHE_H
+#define SHOTCACHE_H
+#include "game.h"
+#include "fork.h"
+#include <pthread.h>
+#include <stddef.h>
+
+// Everything about a simulated shot that callers use without replaying its
+// paths: the rules verdict, where each ball stopped, which balls are off the
+// table afterwards and the events in order.
+typedef struct
+{
+    ShotResult result;
+    Vector3 *rest_positions;
+    bool *pocketed;
+    int num_balls;
+    int ball_capacity;
+    ShotEvent *events;
+    int num_events;
+    int event_capacity;
+} ShotSummary;
+
+typedef struct ShotCacheEntry
+{
+    unsigned long long hash;
+    long long *key;
+    int key_length;
+    ShotSummary summary;
+    size_t bytes;
+    struct ShotCacheEntry *next_in_bucket;
+    struct ShotCacheEntry *newer;
+    struct ShotCacheEntry *older;
+} ShotCacheEntry;
+
+// A bounded least recently used map from (table state, strike) to shot
+// summaries. Keys hold the exact bits of the ball positions, the strike and
+// the coefficients, so a hit returns exactly what simulating again would.
+// A reduced simulation that ends before its event limit is the whole shot,
+// so it is stored as a full simulation too. Safe to share between threads.
+typedef struct ShotCache
+{
+    size_t max_bytes;
+    size_t bytes;
+    int num_entries;
+    ShotCacheEntry **buckets;
+    int num_buckets;
+    ShotCacheEntry *newest;
+    ShotCacheEntry *oldest;
+    long long hits;
+    long long misses;
+    long long evictions;
+    pthread_mutex_t lock;
+} ShotCache;
+
+ShotSummary *create_shot_summary();
+
+void free_shot_summary(ShotSummary *summary);
+
+void summarise_shot(Game *game, ShotSummary *summary);
+
+ShotCache *create_shot_cache(size_t max_bytes);
+
+void free_shot_cache(ShotCache *cache);
+
+ShotCache *default_shot_cache();
+
+void set_shot_cache_limit(ShotCache *cache, size_t max_bytes);
+
+bool lookup_shot_cache(ShotCache *cache, Scene *scene, Vector3 v, Vector3 w, int max_events, ShotSummary *summary);
+
+void store_shot_cache(ShotCache *cache, Scene *scene, Vector3 v, Vector3 w, int max_events, ShotSummary *summary);
+
+void simulate_cached(ShotCache *cache, GameFork *fork, Game *game, Vector3 v, Vector3 w, int max_events, ShotSummary *summary);
+
+Game *fork_after_summary(GameFork *fork, Game *game, ShotSummary *summary);
+
+void print_shot_cache_stats(ShotCache *cache);
+
+#endif // SHOTCACHE_H
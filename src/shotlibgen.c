@@ -0,0 +1,96 @@
+#include "game.h"
+#include "fork.h"
+#include "shotlibrary.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct
+{
+    GameFork *fork;
+    Scene scene;
+    Ball balls[2];
+    ShotLibraryHeader *header;
+    ShotLibraryEntry *entries;
+    int first;
+    int stride;
+} LibraryWorker;
+
+void *run_library_worker(void *arg)
+{
+    LibraryWorker *worker = arg;
+    int size = shot_library_size(worker->header);
+    for (int i = worker->first; i < size; i += worker->stride)
+    {
+        worker->entries[i] = simulate_library_entry(worker->fork, &(worker->scene), worker->header, i);
+        if (worker->first == 0 && (i / worker->stride) % 10000 == 0)
+        {
+            printf("%d / %d\n", i, size);
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    char *path = argc > 1 ? argv[1] : "shot_library.bin";
+    int num_threads = argc > 2 ? atoi(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_threads <= 0)
+    {
+        printf("Usage: %s [library.bin] [threads]\n", argv[0]);
+        return 1;
+    }
+
+    // The canonical shots are played on an open bed so that nothing but the
+    // two balls affects the outcome.
+    Scene scene = create_scene();
+    scene.table.num_cushions = 0;
+    scene.table.num_pockets = 0;
+    ShotLibraryHeader header = default_shot_library_header(scene.coefficients, scene.ball_set.balls[0].radius);
+    int size = shot_library_size(&header);
+    ShotLibraryEntry *entries = malloc(size * sizeof(ShotLibraryEntry));
+    printf("Simulating %d shots on %d threads\n", size, num_threads);
+
+    LibraryWorker *workers = malloc(num_threads * sizeof(LibraryWorker));
+    pthread_t threads[num_threads];
+    for (int i = 0; i < num_threads; i++)
+    {
+        LibraryWorker *worker = &(workers[i]);
+        worker->fork = create_game_fork(2);
+        worker->scene = scene;
+        worker->balls[0] = scene.ball_set.balls[0];
+        worker->balls[1] = scene.ball_set.balls[1];
+        worker->scene.ball_set.balls = worker->balls;
+        worker->scene.ball_set.num_balls = 2;
+        worker->scene.ball_set.ball_capacity = 2;
+        worker->header = &header;
+        worker->entries = entries;
+        worker->first = i;
+        worker->stride = num_threads;
+        pthread_create(&(threads[i]), NULL, run_library_worker, worker);
+    }
+    for (int i = 0; i < num_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+        free_game_fork(workers[i].fork);
+    }
+
+    int num_hits = 0;
+    for (int i = 0; i < size; i++)
+    {
+        if (entries[i].flags & SHOT_LIBRARY_HIT)
+        {
+            num_hits++;
+        }
+    }
+    printf("%d of %d shots reached the object ball\n", num_hits, size);
+    if (!write_shot_library(path, &header, entries))
+    {
+        return 1;
+    }
+    printf("Wrote %s (%zu bytes)\n", path, sizeof(ShotLibraryHeader) + size * sizeof(ShotLibraryEntry));
+    free(workers);
+    free(entries);
+    return 0;
+}
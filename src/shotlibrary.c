@@ -0,0 +1,283 @@
+#include "shotlibrary.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+ShotLibraryHeader default_shot_library_header(Coefficients coefficients, double ball_radius)
+{
+    ShotLibraryHeader header;
+    memset(&header, 0, sizeof(ShotLibraryHeader));
+    memcpy(header.magic, SHOT_LIBRARY_MAGIC, sizeof(SHOT_LIBRARY_MAGIC));
+    header.version = SHOT_LIBRARY_VERSION;
+    header.num_distances = 24;
+    header.num_cut_angles = 35;
+    header.num_speeds = 31;
+    header.num_spin_ratios = 25;
+    header.min_distance = 0.1;
+    header.max_distance = 4;
+    header.max_cut_angle = 85 * PI / 180;
+    header.min_speed = 0.5;
+    header.max_speed = 8;
+    header.min_spin_ratio = -3;
+    header.max_spin_ratio = 3;
+    header.ball_radius = ball_radius;
+    header.coefficients = coefficients;
+    return header;
+}
+
+int shot_library_size(ShotLibraryHeader *header)
+{
+    return header->num_distances * header->num_cut_angles * header->num_speeds * header->num_spin_ratios;
+}
+
+double library_grid_value(double min, double max, int n, int i)
+{
+    return min + i * (max - min) / (n - 1);
+}
+
+Vec2 library_velocity(Path *path, double time)
+{
+    for (int i = path->num_segments - 1; i >= 0; i--)
+    {
+        PathSegment segment = path->segments[i];
+        if (segment.start_time < time)
+        {
+            return Vec2Add(segment.initial_velocity, Vec2Scale(segment.acceleration, time - segment.start_time));
+        }
+    }
+    return (Vec2){0, 0};
+}
+
+// Sets up and simulates the canonical shot for one grid point. The scene must
+// hold a cue ball and one object ball on a table with no cushions or pockets.
+ShotLibraryEntry simulate_library_entry(GameFork *fork, Scene *scene, ShotLibraryHeader *header, int index)
+{
+    int i_spin = index % header->num_spin_ratios;
+    int i_speed = (index / header->num_spin_ratios) % header->num_speeds;
+    int i_cut = (index / (header->num_spin_ratios * header->num_speeds)) % header->num_cut_angles;
+    int i_distance = index / (header->num_spin_ratios * header->num_speeds * header->num_cut_angles);
+    double distance = library_grid_value(header->min_distance, header->max_distance, header->num_distances, i_distance);
+    double cut_angle = library_grid_value(0, header->max_cut_angle, header->num_cut_angles, i_cut);
+    double speed = library_grid_value(header->min_speed, header->max_speed, header->num_speeds, i_speed);
+    double spin_ratio = library_grid_value(header->min_spin_ratio, header->max_spin_ratio, header->num_spin_ratios, i_spin);
+    double R = header->ball_radius;
+
+    Vector3 contact = {distance, 0, 0};
+    Vector3 object_start = {distance + 2 * R * cos(cut_angle), 2 * R * sin(cut_angle), 0};
+    scene->ball_set.balls[0].initial_position = Vector3Zero();
+    scene->ball_set.balls[1].initial_position = object_start;
+    fork_scene(fork, scene);
+    simulate_fork(fork, (Vector3){speed, 0, 0}, (Vector3){0, spin_ratio * speed / R, 0});
+
+    Game *game = &(fork->game);
+    Path *cue_path = &(game->scene.ball_set.balls[0].path);
+    Path *object_path = &(game->scene.ball_set.balls[1].path);
+    Vec2 cue_rest = cue_path->segments[cue_path->num_segments - 1].initial_position;
+    Vec2 object_rest = object_path->segments[object_path->num_segments - 1].initial_position;
+
+    ShotLibraryEntry entry;
+    memset(&entry, 0, sizeof(ShotLibraryEntry));
+    entry.cue_rest_x = cue_rest.x - contact.x;
+    entry.cue_rest_y = cue_rest.y - contact.y;
+    entry.object_travel = Vec2Length(Vec2Subtract(object_rest, Vec2FromVector3(object_start)));
+    int num_collisions = 0;
+    for (int i = 0; i < game->current_shot.num_events; i++)
+    {
+        ShotEvent event = game->current_shot.events[i];
+        if (event.type != BALL_BALL_COLLISION)
+        {
+            continue;
+        }
+        num_collisions++;
+        if (num_collisions > 1)
+        {
+            continue;
+        }
+        entry.contact_speed = Vec2Length(library_velocity(cue_path, event.time));
+        for (int j = 0; j < object_path->num_segments; j++)
+        {
+            Vec2 v = object_path->segments[j].initial_velocity;
+            if (object_path->segments[j].start_time >= event.time && Vec2Length(v) > 0)
+            {
+                entry.object_throw = atan2(v.y, v.x) - cut_angle;
+                break;
+            }
+        }
+    }
+    if (num_collisions > 0)
+    {
+        entry.flags |= SHOT_LIBRARY_HIT;
+    }
+    if (num_collisions > 1)
+    {
+        entry.flags |= SHOT_LIBRARY_SECOND_HIT;
+    }
+    release_game_fork(fork);
+    return entry;
+}
+
+bool write_shot_library(char *path, ShotLibraryHeader *header, ShotLibraryEntry *entries)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return false;
+    }
+    int size = shot_library_size(header);
+    bool written = fwrite(header, sizeof(ShotLibraryHeader), 1, file) == 1 && fwrite(entries, sizeof(ShotLibraryEntry), size, file) == (size_t)size;
+    if (fclose(file) != 0 || !written)
+    {
+        fprintf(stderr, "Failed to write %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+bool shot_library_matches(ShotLibraryHeader *header, Coefficients coefficients, double ball_radius)
+{
+    return header->ball_radius == ball_radius && memcmp(&(header->coefficients), &coefficients, sizeof(Coefficients)) == 0;
+}
+
+// Maps a library file read-only. Nothing is parsed beyond checking the
+// header, so opening costs the same whatever the size of the library.
+ShotLibrary *open_shot_library(char *path, Coefficients coefficients, double ball_radius)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open shot library %s\n", path);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ShotLibraryHeader))
+    {
+        fprintf(stderr, "Shot library %s is too small\n", path);
+        close(fd);
+        return NULL;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map shot library %s\n", path);
+        return NULL;
+    }
+    ShotLibraryHeader *header = data;
+    if (memcmp(header->magic, SHOT_LIBRARY_MAGIC, sizeof(SHOT_LIBRARY_MAGIC)) != 0 || header->version != SHOT_LIBRARY_VERSION || (size_t)st.st_size != sizeof(ShotLibraryHeader) + shot_library_size(header) * sizeof(ShotLibraryEntry))
+    {
+        fprintf(stderr, "Shot library %s is not a version %d library\n", path, SHOT_LIBRARY_VERSION);
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    if (!shot_library_matches(header, coefficients, ball_radius))
+    {
+        fprintf(stderr, "Shot library %s was simulated with different coefficients or ball radius; run shotlibgen to rebuild it\n", path);
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    ShotLibrary *library = malloc(sizeof(ShotLibrary));
+    library->data = data;
+    library->size = st.st_size;
+    library->header = header;
+    library->entries = (ShotLibraryEntry *)(header + 1);
+    return library;
+}
+
+void close_shot_library(ShotLibrary *library)
+{
+    munmap(library->data, library->size);
+    free(library);
+}
+
+// Finds the grid cell containing value and the position within it. Returns
+// false outside the grid.
+bool library_grid_cell(double min, double max, int n, double value, int *i, double *f)
+{
+    double u = (value - min) / (max - min) * (n - 1);
+    if (u < 0 || u > n - 1)
+    {
+        return false;
+    }
+    *i = fmin(u, n - 2);
+    *f = u - *i;
+    return true;
+}
+
+// Predicts a shot that sends the cue ball from cue_position to contact with
+// the object ball at contact_position. The outcome is interpolated from the
+// 16 surrounding grid points, and the lookup fails when the shot is outside
+// the grid, any of those points missed the object ball or the library does
+// not match the game's coefficients and ball radius.
+bool lookup_shot_library(ShotLibrary *library, Coefficients coefficients, double ball_radius, Vector3 cue_position, Vector3 contact_position, Vector3 object_position, double speed, double spin_ratio, LibraryOutcome *outcome)
+{
+    ShotLibraryHeader *header = library->header;
+    if (!shot_library_matches(header, coefficients, ball_radius))
+    {
+        return false;
+    }
+    Vector3 aim_line = Vector3Subtract(contact_position, cue_position);
+    aim_line.z = 0;
+    double distance = Vector3Length(aim_line);
+    Vector3 aim = Vector3Scale(aim_line, 1 / distance);
+    Vector3 normal = Vector3Normalize(Vector3Subtract(object_position, contact_position));
+    double cut_angle = acos(fmax(-1, fmin(1, Vector3DotProduct(aim, normal))));
+    double side = aim.x * normal.y - aim.y * normal.x < 0 ? -1 : 1;
+
+    int index[4];
+    double fraction[4];
+    if (!library_grid_cell(header->min_distance, header->max_distance, header->num_distances, distance, &index[0], &fraction[0]) ||
+        !library_grid_cell(0, header->max_cut_angle, header->num_cut_angles, cut_angle, &index[1], &fraction[1]) ||
+        !library_grid_cell(header->min_speed, header->max_speed, header->num_speeds, speed, &index[2], &fraction[2]) ||
+        !library_grid_cell(header->min_spin_ratio, header->max_spin_ratio, header->num_spin_ratios, spin_ratio, &index[3], &fraction[3]))
+    {
+        return false;
+    }
+
+    double cue_rest_x = 0;
+    double cue_rest_y = 0;
+    double object_travel = 0;
+    double object_throw = 0;
+    double contact_speed = 0;
+    for (int corner = 0; corner < 16; corner++)
+    {
+        double weight = 1;
+        int i[4];
+        for (int k = 0; k < 4; k++)
+        {
+            int high = (corner >> k) & 1;
+            i[k] = index[k] + high;
+            weight *= high ? fraction[k] : 1 - fraction[k];
+        }
+        ShotLibraryEntry *entry = &(library->entries[((i[0] * header->num_cut_angles + i[1]) * header->num_speeds + i[2]) * header->num_spin_ratios + i[3]]);
+        if (!(entry->flags & SHOT_LIBRARY_HIT))
+        {
+            return false;
+        }
+        cue_rest_x += weight * entry->cue_rest_x;
+        cue_rest_y += weight * entry->cue_rest_y;
+        object_travel += weight * entry->object_travel;
+        object_throw += weight * entry->object_throw;
+        contact_speed += weight * entry->contact_speed;
+    }
+
+    Vector3 across = {-aim.y * side, aim.x * side, 0};
+    double object_angle = cut_angle + object_throw;
+    outcome->cue_rest = Vector3Add(contact_position, Vector3Add(Vector3Scale(aim, cue_rest_x), Vector3Scale(across, cue_rest_y)));
+    outcome->object_direction = Vector3Add(Vector3Scale(aim, cos(object_angle)), Vector3Scale(across, sin(object_angle)));
+    outcome->object_rest = Vector3Add(object_position, Vector3Scale(outcome->object_direction, object_travel));
+    outcome->object_travel = object_travel;
+    outcome->object_throw = side * object_throw;
+    outcome->contact_speed = contact_speed;
+    return true;
+}
+
+Vector3 library_strike_spin(Vector3 aim_line, double speed, double spin_ratio, double radius)
+{
+    return Vector3Scale(Vector3Normalize(Vector3CrossProduct((Vector3){0, 0, 1}, aim_line)), spin_ratio * speed / radius);
+}
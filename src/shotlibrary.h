@@ -0,0 +1,94 @@
+#ifndef SHOTLIBRARY_H
+#define SHOTLIBRARY_H
+#include "game.h"
+#include "fork.h"
+#include <stdint.h>
+
+#define SHOT_LIBRARY_MAGIC "SHOTLIB"
+#define SHOT_LIBRARY_VERSION 1
+
+#define SHOT_LIBRARY_HIT 1
+#define SHOT_LIBRARY_SECOND_HIT 2
+
+// A shot library is a file of outcomes simulated with the real engine for a
+// grid of canonical single-ball shots. In the canonical frame the cue ball
+// starts at the origin and is struck along +x with top or back spin, and the
+// object ball sits so that the cue ball meets it at (distance, 0) with the
+// line of centres turned cut_angle towards +y. Shots cut the other way are
+// mirror images. Spin is stored as the ratio spin * radius / speed.
+typedef struct
+{
+    char magic[8];
+    int32_t version;
+    int32_t num_distances;
+    int32_t num_cut_angles;
+    int32_t num_speeds;
+    int32_t num_spin_ratios;
+    int32_t reserved;
+    double min_distance;
+    double max_distance;
+    double max_cut_angle;
+    double min_speed;
+    double max_speed;
+    double min_spin_ratio;
+    double max_spin_ratio;
+    double ball_radius;
+    Coefficients coefficients;
+} ShotLibraryHeader;
+
+// Positions are relative to the contact point for the cue ball and to the
+// object ball's starting point for the object ball, in the canonical frame.
+// The object ball's throw is its departure angle from the line of centres.
+typedef struct
+{
+    float cue_rest_x;
+    float cue_rest_y;
+    float object_travel;
+    float object_throw;
+    float contact_speed;
+    uint32_t flags;
+} ShotLibraryEntry;
+
+typedef struct
+{
+    void *data;
+    size_t size;
+    ShotLibraryHeader *header;
+    ShotLibraryEntry *entries;
+} ShotLibrary;
+
+// A shot library prediction in world coordinates.
+typedef struct
+{
+    Vector3 cue_rest;
+    Vector3 object_direction;
+    Vector3 object_rest;
+    double object_travel;
+    double object_throw;
+    double contact_speed;
+} LibraryOutcome;
+
+ShotLibraryHeader default_shot_library_header(Coefficients coefficients, double ball_radius);
+
+int shot_library_size(ShotLibraryHeader *header);
+
+ShotLibraryEntry simulate_library_entry(GameFork *fork, Scene *scene, ShotLibraryHeader *header, int index);
+
+bool write_shot_library(char *path, ShotLibraryHeader *header, ShotLibraryEntry *entries);
+
+// A library only predicts shots for the coefficients and ball radius it was
+// simulated with. Opening refuses a library built for anything else, and
+// lookups fail when the game they are asked about does not match.
+bool shot_library_matches(ShotLibraryHeader *header, Coefficients coefficients, double ball_radius);
+
+ShotLibrary *open_shot_library(char *path, Coefficients coefficients, double ball_radius);
+
+void close_shot_library(ShotLibrary *library);
+
+// The angular velocity that gives a cue ball struck along aim_line the
+// library's spin ratio: positive is topspin and 1 is natural roll.
+Vector3 library_strike_spin(Vector3 aim_line, double speed, double spin_ratio, double radius);
+
+bool lookup_shot_library(ShotLibrary *library, Coefficients coefficients, double ball_radius, Vector3 cue_position, Vector3 contact_position, Vector3 object_position, double speed, double spin_ratio, LibraryOutcome *outcome);
+
+#endif // SHOTLIBRARY_H
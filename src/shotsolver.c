@@ -0,0 +1,378 @@
+#include "shotsolver.h"
+#include "geometry.h"
+#include "pocketability.h"
+#include "potwindow.h"
+#include <math.h>
+
+// The unknowns are the cue angle, speed and, with a rest target, spin. The
+// residuals are the object ball's direction error, how far short of the
+// pocket it stopped and, with a rest target, the cue ball's rest position
+// error, each divided by its tolerance.
+typedef struct
+{
+    GameFork *fork;
+    Game *game;
+    ShotTarget target;
+    Vector3 cue_ball_position;
+    Vector3 object_ball_position;
+    Vector3 aim_target;
+    double radius;
+    double ghost_angle;
+    double aim_tolerance;
+    double aim_sign;
+    int num_unknowns;
+    int num_residuals;
+    int num_simulations;
+    bool hit;
+    bool potted;
+    Vector3 contact_position;
+    Vector3 rest_position;
+    Vector3 object_rest_position;
+} ShotSolver;
+
+double wrap_angle(double angle)
+{
+    return atan2(sin(angle), cos(angle));
+}
+
+PathSegment *segment_at(Path path, double time)
+{
+    int i = path.num_segments - 1;
+    while (i > 0 && path.segments[i].start_time > time)
+    {
+        i--;
+    }
+    return &(path.segments[i]);
+}
+
+// Sensitivity of the object ball's departure angle to the cue angle for a
+// cue ball travelling in a straight line. With u the aim direction, d the
+// line from cue ball to object ball, a = u x d and q = sqrt(4R^2 - a^2),
+// the object ball leaves at the cue angle plus asin(a / 2R), so the slope
+// is 1 - (u . d) / q. Misses use the slope at the ghost ball line.
+double aim_slope(ShotSolver *solver, double angle)
+{
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        Vector3 u = {cos(angle), sin(angle), 0};
+        Vector3 d = Vector3Subtract(solver->object_ball_position, solver->cue_ball_position);
+        double along = u.x * d.x + u.y * d.y;
+        double across = u.x * d.y - u.y * d.x;
+        double contact_distance = 2 * solver->radius;
+        if (along > 0 && fabs(across) < contact_distance)
+        {
+            return 1 - along / sqrt(contact_distance * contact_distance - across * across);
+        }
+        angle = solver->ghost_angle;
+    }
+    return 1;
+}
+
+bool evaluate_strike(ShotSolver *solver, double *x, double *r)
+{
+    Vector3 aim_line = {cos(x[0]), sin(x[0]), 0};
+    Vector3 v = Vector3Scale(aim_line, x[1]);
+    Vector3 w = Vector3Scale(Vector3Normalize(Vector3CrossProduct(aim_line, (Vector3){0, 0, 1})), x[2]);
+    Game *game = fork_game(solver->fork, solver->game);
+    simulate_fork(solver->fork, v, w);
+    solver->num_simulations++;
+
+    solver->hit = false;
+    double object_angle = 0;
+    for (int i = 0; i < game->current_shot.num_events; i++)
+    {
+        ShotEvent event = game->current_shot.events[i];
+        if (event.type != BALL_BALL_COLLISION)
+        {
+            continue;
+        }
+        Ball *ball1 = event_ball1(&(game->scene), event);
+        Ball *ball2 = event_ball2(&(game->scene), event);
+        if (ball1->id != 0 && ball2->id != 0)
+        {
+            continue;
+        }
+        Ball *cue_ball = ball1->id == 0 ? ball1 : ball2;
+        Ball *object_ball = ball1->id == 0 ? ball2 : ball1;
+        if (object_ball->id == solver->target.object_ball)
+        {
+            Vec2 object_velocity = segment_at(object_ball->path, event.time)->initial_velocity;
+            object_angle = atan2(object_velocity.y, object_velocity.x);
+            solver->contact_position = Vec2ToVector3(segment_at(cue_ball->path, event.time)->initial_position);
+            solver->hit = true;
+        }
+        break;
+    }
+
+    Vector3 target_line = Vector3Subtract(solver->aim_target, solver->object_ball_position);
+    double target_angle = atan2(target_line.y, target_line.x);
+    if (solver->hit)
+    {
+        r[0] = solver->aim_sign * wrap_angle(object_angle - target_angle) / solver->aim_tolerance;
+    }
+    else
+    {
+        r[0] = solver->aim_sign * aim_slope(solver, solver->ghost_angle) * wrap_angle(x[0] - solver->ghost_angle) / solver->aim_tolerance;
+    }
+
+    // The cushion takes speed out of the rebound, so a bank is judged on the
+    // object ball's direction after the cushion rather than on the mirror
+    // image of the pocket.
+    if (solver->hit && solver->target.cushion != -1)
+    {
+        Ball *object_ball = &(game->scene.ball_set.balls[solver->target.object_ball]);
+        Cushion *cushion = &(game->scene.table.cushions[solver->target.cushion]);
+        for (int i = 0; i < game->current_shot.num_events; i++)
+        {
+            ShotEvent event = game->current_shot.events[i];
+            if (event.type != BALL_CUSHION_COLLISION || event_ball1(&(game->scene), event)->id != object_ball->id)
+            {
+                continue;
+            }
+            if (event_cushion(&(game->scene), event) == cushion)
+            {
+                PathSegment *rebound = segment_at(object_ball->path, event.time);
+                Vec2 pocket_line = Vec2Subtract(Vec2FromVector3(game->scene.table.pockets[solver->target.pocket].position), rebound->initial_position);
+                double rebound_angle = atan2(rebound->initial_velocity.y, rebound->initial_velocity.x);
+                r[0] = wrap_angle(rebound_angle - atan2(pocket_line.y, pocket_line.x)) / solver->aim_tolerance;
+            }
+            break;
+        }
+    }
+
+    Pocket pocket = game->scene.table.pockets[solver->target.pocket];
+    bool object_ball_potted = pocket_entered(game, solver->target.object_ball) == solver->target.pocket;
+    Path object_path = game->scene.ball_set.balls[solver->target.object_ball].path;
+    solver->object_rest_position = Vec2ToVector3(object_path.segments[object_path.num_segments - 1].initial_position);
+    r[1] = object_ball_potted ? 0 : Vector3Distance(solver->object_rest_position, pocket.position) / pocket.radius;
+
+    Path path = game->scene.ball_set.balls[0].path;
+    solver->rest_position = Vec2ToVector3(path.segments[path.num_segments - 1].initial_position);
+    if (solver->num_residuals == 4)
+    {
+        r[2] = (solver->rest_position.x - solver->target.rest_target.x) / solver->target.rest_tolerance;
+        r[3] = (solver->rest_position.y - solver->target.rest_target.y) / solver->target.rest_tolerance;
+    }
+    solver->potted = object_ball_potted && pocket_entered(game, 0) == -1;
+    release_game_fork(solver->fork);
+    return solver->potted;
+}
+
+double sum_of_squares(double *r, int n)
+{
+    double sum = 0;
+    for (int i = 0; i < n; i++)
+    {
+        sum += r[i] * r[i];
+    }
+    return sum;
+}
+
+bool solution_converged(ShotSolver *solver, double *r, bool potted)
+{
+    if (!potted)
+    {
+        return false;
+    }
+    return solver->num_residuals == 2 || r[2] * r[2] + r[3] * r[3] < 1;
+}
+
+// Solves the damped normal equations (J^T J + lambda diag(J^T J)) dx = -J^T r
+// by Gaussian elimination.
+void gauss_newton_step(double J[4][3], double *r, int m, int n, double lambda, double *dx)
+{
+    double A[3][4];
+    for (int i = 0; i < n; i++)
+    {
+        for (int j = 0; j < n; j++)
+        {
+            A[i][j] = 0;
+            for (int k = 0; k < m; k++)
+            {
+                A[i][j] += J[k][i] * J[k][j];
+            }
+        }
+        A[i][n] = 0;
+        for (int k = 0; k < m; k++)
+        {
+            A[i][n] -= J[k][i] * r[k];
+        }
+    }
+    for (int i = 0; i < n; i++)
+    {
+        A[i][i] += lambda * A[i][i] + 1e-9;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        int pivot = i;
+        for (int k = i + 1; k < n; k++)
+        {
+            if (fabs(A[k][i]) > fabs(A[pivot][i]))
+            {
+                pivot = k;
+            }
+        }
+        for (int j = 0; j <= n; j++)
+        {
+            double swap = A[i][j];
+            A[i][j] = A[pivot][j];
+            A[pivot][j] = swap;
+        }
+        for (int k = i + 1; k < n; k++)
+        {
+            double factor = A[k][i] / A[i][i];
+            for (int j = i; j <= n; j++)
+            {
+                A[k][j] -= factor * A[i][j];
+            }
+        }
+    }
+    for (int i = n - 1; i >= 0; i--)
+    {
+        dx[i] = A[i][n];
+        for (int j = i + 1; j < n; j++)
+        {
+            dx[i] -= A[i][j] * dx[j];
+        }
+        dx[i] /= A[i][i];
+    }
+}
+
+// Finds the cue strike for a target shot by damped Gauss-Newton iteration.
+// The first Jacobian comes from the contact geometry (angle), the rest
+// distance scaling with speed squared (speed) and one extra simulation
+// (spin); after that each simulated step refines it with a Broyden update,
+// so a solve costs a couple of simulations more than its iterations.
+// Without a rest target only the angle and speed are solved for.
+ShotSolution solve_shot(GameFork *fork, Game *game, ShotTarget target, double speed, double spin, int max_iterations)
+{
+    ShotSolver solver;
+    solver.fork = fork;
+    solver.game = game;
+    solver.target = target;
+    if (solver.target.rest_tolerance <= 0)
+    {
+        solver.target.rest_tolerance = 0.1;
+    }
+    Ball *object_ball = &(game->scene.ball_set.balls[target.object_ball]);
+    solver.cue_ball_position = game->scene.ball_set.balls[0].initial_position;
+    solver.object_ball_position = object_ball->initial_position;
+    solver.radius = object_ball->radius;
+    solver.aim_target = game->scene.table.pockets[target.pocket].position;
+    if (target.cushion != -1)
+    {
+        solver.aim_target = get_bank_line(game, object_ball, target.pocket, target.cushion)->pocket_image;
+    }
+    Vector3 ghost_line = Vector3Subtract(ghost_ball_position(solver.object_ball_position, solver.aim_target, solver.radius), solver.cue_ball_position);
+    solver.ghost_angle = atan2(ghost_line.y, ghost_line.x);
+    solver.aim_tolerance = 0.25 * game->scene.table.pockets[target.pocket].radius / fmax(Vector3Distance(solver.object_ball_position, solver.aim_target), solver.radius);
+    solver.aim_sign = target.cushion == -1 ? 1 : -1;
+    solver.num_unknowns = target.has_rest_target ? 3 : 2;
+    solver.num_residuals = target.has_rest_target ? 4 : 2;
+    solver.num_simulations = 0;
+    int m = solver.num_residuals;
+    int n = solver.num_unknowns;
+
+    double x[3] = {solver.ghost_angle, speed, spin};
+    double r[4] = {0, 0, 0, 0};
+    bool potted = evaluate_strike(&solver, x, r);
+
+    // Distances rolled grow with the square of the speed.
+    double J[4][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+    double slope = aim_slope(&solver, x[0]);
+    J[0][0] = solver.aim_sign * slope / solver.aim_tolerance;
+    if (r[1] > 0)
+    {
+        double object_travel = Vector3Distance(solver.object_rest_position, solver.object_ball_position);
+        J[1][1] = -2 * object_travel / x[1] / game->scene.table.pockets[target.pocket].radius;
+    }
+    if (n == 3)
+    {
+        Vector3 travel = Vector3Subtract(solver.rest_position, solver.hit ? solver.contact_position : solver.cue_ball_position);
+        double scale = 1 / solver.target.rest_tolerance;
+        J[2][0] = -travel.y * slope * scale;
+        J[3][0] = travel.x * slope * scale;
+        J[2][1] = 2 * travel.x / x[1] * scale;
+        J[3][1] = 2 * travel.y / x[1] * scale;
+        double spin_step = 5;
+        double x_spin[3] = {x[0], x[1], x[2] + spin_step};
+        double r_spin[4];
+        evaluate_strike(&solver, x_spin, r_spin);
+        for (int i = 0; i < m; i++)
+        {
+            J[i][2] = (r_spin[i] - r[i]) / spin_step;
+        }
+    }
+
+    double cost = sum_of_squares(r, m);
+    double lambda = 1e-3;
+    int iteration = 0;
+    while (iteration < max_iterations && !solution_converged(&solver, r, potted))
+    {
+        iteration++;
+        double dx[3] = {0, 0, 0};
+        gauss_newton_step(J, r, m, n, lambda, dx);
+        // The models behind the Jacobian only hold near the current strike.
+        dx[0] = fmax(-0.05, fmin(0.05, dx[0]));
+        dx[1] = fmax(-0.25 * x[1], fmin(0.25 * x[1], dx[1]));
+        dx[2] = fmax(-15, fmin(15, dx[2]));
+        double x_new[3] = {x[0] + dx[0], fmax(0.1, fmin(10, x[1] + dx[1])), fmax(-200, fmin(200, x[2] + dx[2]))};
+        double r_new[4] = {0, 0, 0, 0};
+        bool potted_new = evaluate_strike(&solver, x_new, r_new);
+
+        double step[3];
+        double step_length = 0;
+        for (int j = 0; j < n; j++)
+        {
+            step[j] = x_new[j] - x[j];
+            step_length += step[j] * step[j];
+        }
+        if (step_length > 0)
+        {
+            for (int i = 0; i < m; i++)
+            {
+                double predicted = 0;
+                for (int j = 0; j < n; j++)
+                {
+                    predicted += J[i][j] * step[j];
+                }
+                for (int j = 0; j < n; j++)
+                {
+                    J[i][j] += (r_new[i] - r[i] - predicted) * step[j] / step_length;
+                }
+            }
+        }
+
+        double cost_new = sum_of_squares(r_new, m);
+        if (cost_new < cost || (potted_new && !potted))
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                x[i] = x_new[i];
+            }
+            for (int i = 0; i < 4; i++)
+            {
+                r[i] = r_new[i];
+            }
+            cost = cost_new;
+            potted = potted_new;
+            lambda *= 0.3;
+        }
+        else
+        {
+            lambda = lambda * 4 + 1e-3;
+        }
+    }
+
+    ShotSolution solution;
+    Vector3 aim_line = {cos(x[0]), sin(x[0]), 0};
+    solution.v = Vector3Scale(aim_line, x[1]);
+    solution.w = Vector3Scale(Vector3Normalize(Vector3CrossProduct(aim_line, (Vector3){0, 0, 1})), x[2]);
+    solution.converged = solution_converged(&solver, r, potted);
+    solution.potted = potted;
+    solution.aim_error = r[0] * solver.aim_tolerance;
+    solution.rest_error = m == 4 ? sqrt(r[2] * r[2] + r[3] * r[3]) * solver.target.rest_tolerance : 0;
+    solution.iterations = iteration;
+    solution.num_simulations = solver.num_simulations;
+    return solution;
+}
@@ -0,0 +1,33 @@
+#ifndef SHOTSOLVER_H
+#define SHOTSOLVER_H
+#include "game.h"
+#include "fork.h"
+
+// What a shot should do: hit object_ball first and send it into pocket,
+// off cushion first when cushion is not -1, and optionally leave the cue
+// ball within rest_tolerance of rest_target.
+typedef struct
+{
+    int object_ball;
+    int pocket;
+    int cushion;
+    bool has_rest_target;
+    Vector3 rest_target;
+    double rest_tolerance;
+} ShotTarget;
+
+typedef struct
+{
+    bool converged;
+    bool potted;
+    Vector3 v;
+    Vector3 w;
+    double aim_error;
+    double rest_error;
+    int iterations;
+    int num_simulations;
+} ShotSolution;
+
+ShotSolution solve_shot(GameFork *fork, Game *game, ShotTarget target, double speed, double spin, int max_iterations);
+
+#endif // SHOTSOLVER_H
@@ -0,0 +1,446 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "game.h"
+#include "snapshot.h"
+#include "obstacleindex.h"
+#include "geometry.h"
+#include "pocketability.h"
+
+#define SNAPSHOT_BUFFER_SIZE (1 << 20)
+
+int snapshot_player_index(Game *game, Player *player)
+{
+    return player == NULL ? -1 : (int)(player - game->players);
+}
+
+size_t snapshot_align(size_t offset)
+{
+    return (offset + 7) & ~(size_t)7;
+}
+
+void snapshot_write(FILE *file, size_t *offset, const void *data, size_t size, bool *failed)
+{
+    if (size > 0 && fwrite(data, 1, size, file) != size)
+    {
+        *failed = true;
+    }
+    *offset += size;
+}
+
+void snapshot_pad(FILE *file, size_t *offset, bool *failed)
+{
+    char zeros[8] = {0};
+    snapshot_write(file, offset, zeros, snapshot_align(*offset) - *offset, failed);
+}
+
+void snapshot_write_path(FILE *file, size_t *offset, Path *path, bool *failed)
+{
+    for (int i = 0; i < path->num_segments; i++)
+    {
+        PathSegment segment = path->segments[i];
+        segment.orientations = NULL;
+        snapshot_write(file, offset, &segment, sizeof(PathSegment), failed);
+    }
+}
+
+uint32_t snapshot_add_string(char *strings, uint32_t *string_size, char *text, uint32_t *length)
+{
+    uint32_t offset = *string_size;
+    *length = text == NULL ? 0 : strlen(text);
+    if (strings != NULL)
+    {
+        memcpy(strings + offset, text, *length);
+    }
+    *string_size += *length;
+    return offset;
+}
+
+bool save_snapshot(Game *game, char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return false;
+    }
+    setvbuf(file, NULL, _IOFBF, SNAPSHOT_BUFFER_SIZE);
+
+    Scene *scene = &(game->scene);
+    int num_balls = scene->ball_set.num_balls;
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(SnapshotHeader));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.num_players = game->num_players;
+    header.num_cushions = scene->table.num_cushions;
+    header.num_pockets = scene->table.num_pockets;
+    header.num_balls = num_balls;
+    header.num_frames = game->num_frames;
+    header.current_player = game->current_player;
+    header.consecutive_fouls = game->consecutive_fouls;
+    header.state = game->state;
+    header.seed = game->seed;
+    header.time = game->time;
+    header.playback_speed = game->playback_speed;
+    header.default_playback_speed = game->default_playback_speed;
+    header.v = game->v;
+    header.w = game->w;
+    header.p1_stats = game->p1_stats;
+    header.p2_stats = game->p2_stats;
+    header.stats_frame = game->stats_frame;
+    header.stats_shot = game->stats_shot;
+    header.coefficients = scene->coefficients;
+    for (int i = 0; i < num_balls; i++)
+    {
+        header.num_segments += scene->ball_set.balls[i].path.num_segments;
+    }
+    for (int i = 0; i < game->num_frames; i++)
+    {
+        Frame *frame = &(game->frames[i]);
+        header.num_shots += frame->num_shots;
+        for (int j = 0; j < frame->num_shots; j++)
+        {
+            Shot *shot = &(frame->shot_history[j]);
+            header.num_events += shot->num_events;
+            for (int k = 0; k < num_balls; k++)
+            {
+                header.num_segments += shot->ball_paths[k].num_segments;
+            }
+        }
+    }
+
+    SnapshotPlayer *players = malloc((game->num_players + 1) * sizeof(SnapshotPlayer));
+    for (int i = 0; i < game->num_players; i++)
+    {
+        PlayerModule *module = &(game->players[i].module);
+        SnapshotPlayer *player = &(players[i]);
+        memset(player, 0, sizeof(SnapshotPlayer));
+        player->type = game->players[i].type;
+        player->name_offset = snapshot_add_string(NULL, &(header.string_size), module->name, &(player->name_length));
+        player->description_offset = snapshot_add_string(NULL, &(header.string_size), module->description, &(player->description_length));
+        player->library_path_offset = snapshot_add_string(NULL, &(header.string_size), module->library_path, &(player->library_path_length));
+    }
+    char *strings = malloc(header.string_size + 1);
+    uint32_t string_size = 0;
+    for (int i = 0; i < game->num_players; i++)
+    {
+        PlayerModule *module = &(game->players[i].module);
+        uint32_t length;
+        snapshot_add_string(strings, &string_size, module->name, &length);
+        snapshot_add_string(strings, &string_size, module->description, &length);
+        snapshot_add_string(strings, &string_size, module->library_path, &length);
+    }
+
+    size_t offset = 0;
+    bool failed = false;
+    snapshot_write(file, &offset, &header, sizeof(SnapshotHeader), &failed);
+    snapshot_pad(file, &offset, &failed);
+    snapshot_write(file, &offset, players, game->num_players * sizeof(SnapshotPlayer), &failed);
+    snapshot_pad(file, &offset, &failed);
+    snapshot_write(file, &offset, scene->table.cushions, scene->table.num_cushions * sizeof(Cushion), &failed);
+    snapshot_pad(file, &offset, &failed);
+    snapshot_write(file, &offset, scene->table.pockets, scene->table.num_pockets * sizeof(Pocket), &failed);
+    snapshot_pad(file, &offset, &failed);
+    for (int i = 0; i < num_balls; i++)
+    {
+        Ball *ball = &(scene->ball_set.balls[i]);
+        SnapshotBall record = {ball->id, {ball->colour.r, ball->colour.g, ball->colour.b, ball->colour.a}, ball->initial_position, ball->pocketed, ball->initial_orientation, ball->radius, ball->mass};
+        snapshot_write(file, &offset, &record, sizeof(SnapshotBall), &failed);
+    }
+    snapshot_pad(file, &offset, &failed);
+    for (int i = 0; i < game->num_frames; i++)
+    {
+        Frame *frame = &(game->frames[i]);
+        SnapshotFrame record = {frame->num_shots, snapshot_player_index(game, frame->winner)};
+        snapshot_write(file, &offset, &record, sizeof(SnapshotFrame), &failed);
+    }
+    snapshot_pad(file, &offset, &failed);
+    for (int i = 0; i < game->num_frames; i++)
+    {
+        Frame *frame = &(game->frames[i]);
+        for (int j = 0; j < frame->num_shots; j++)
+        {
+            Shot *shot = &(frame->shot_history[j]);
+            SnapshotShot record = {snapshot_player_index(game, shot->player), shot->num_events, shot->end_time, shot->v, shot->w};
+            snapshot_write(file, &offset, &record, sizeof(SnapshotShot), &failed);
+        }
+    }
+    snapshot_pad(file, &offset, &failed);
+    for (int i = 0; i < num_balls; i++)
+    {
+        uint32_t num_segments = scene->ball_set.balls[i].path.num_segments;
+        snapshot_write(file, &offset, &num_segments, sizeof(uint32_t), &failed);
+    }
+    for (int i = 0; i < game->num_frames; i++)
+    {
+        Frame *frame = &(game->frames[i]);
+        for (int j = 0; j < frame->num_shots; j++)
+        {
+            for (int k = 0; k < num_balls; k++)
+            {
+                uint32_t num_segments = frame->shot_history[j].ball_paths[k].num_segments;
+                snapshot_write(file, &offset, &num_segments, sizeof(uint32_t), &failed);
+            }
+        }
+    }
+    snapshot_pad(file, &offset, &failed);
+    for (int i = 0; i < num_balls; i++)
+    {
+        snapshot_write_path(file, &offset, &(scene->ball_set.balls[i].path), &failed);
+    }
+    for (int i = 0; i < game->num_frames; i++)
+    {
+        Frame *frame = &(game->frames[i]);
+        for (int j = 0; j < frame->num_shots; j++)
+        {
+            for (int k = 0; k < num_balls; k++)
+            {
+                snapshot_write_path(file, &offset, &(frame->shot_history[j].ball_paths[k]), &failed);
+            }
+        }
+    }
+    snapshot_pad(file, &offset, &failed);
+    for (int i = 0; i < game->num_frames; i++)
+    {
+        Frame *frame = &(game->frames[i]);
+        for (int j = 0; j < frame->num_shots; j++)
+        {
+            Shot *shot = &(frame->shot_history[j]);
+            snapshot_write(file, &offset, shot->events, shot->num_events * sizeof(ShotEvent), &failed);
+        }
+    }
+    snapshot_write(file, &offset, strings, header.string_size, &failed);
+
+    free(players);
+    free(strings);
+    if (fclose(file) != 0 || failed)
+    {
+        fprintf(stderr, "Failed to write snapshot %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+// Returns the start of a section of count records and moves the cursor past
+// it, or NULL if the section runs past the end of the file.
+void *snapshot_section(char *data, size_t size, size_t *cursor, size_t count, size_t record_size)
+{
+    size_t start = snapshot_align(*cursor);
+    if (start > size || count > (size - start) / record_size)
+    {
+        return NULL;
+    }
+    *cursor = start + count * record_size;
+    return data + start;
+}
+
+char *snapshot_string(char *strings, uint32_t string_size, uint32_t offset, uint32_t length)
+{
+    if (length == 0 || offset > string_size || length > string_size - offset)
+    {
+        return NULL;
+    }
+    return strndup(strings + offset, length);
+}
+
+Game *load_snapshot(char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to open snapshot %s\n", path);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < (long)sizeof(SnapshotHeader))
+    {
+        fprintf(stderr, "Snapshot %s is too small\n", path);
+        fclose(file);
+        return NULL;
+    }
+    char *data = malloc(size);
+    size_t read = fread(data, 1, size, file);
+    fclose(file);
+    SnapshotHeader *header = (SnapshotHeader *)data;
+    if (read != (size_t)size || memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || header->version != SNAPSHOT_VERSION)
+    {
+        fprintf(stderr, "%s is not a version %d snapshot\n", path, SNAPSHOT_VERSION);
+        free(data);
+        return NULL;
+    }
+
+    size_t num_paths = (size_t)header->num_balls * (header->num_shots + 1);
+    size_t cursor = sizeof(SnapshotHeader);
+    SnapshotPlayer *players = snapshot_section(data, size, &cursor, header->num_players, sizeof(SnapshotPlayer));
+    Cushion *cushions = snapshot_section(data, size, &cursor, header->num_cushions, sizeof(Cushion));
+    Pocket *pockets = snapshot_section(data, size, &cursor, header->num_pockets, sizeof(Pocket));
+    SnapshotBall *balls = snapshot_section(data, size, &cursor, header->num_balls, sizeof(SnapshotBall));
+    SnapshotFrame *frames = snapshot_section(data, size, &cursor, header->num_frames, sizeof(SnapshotFrame));
+    SnapshotShot *shots = snapshot_section(data, size, &cursor, header->num_shots, sizeof(SnapshotShot));
+    uint32_t *segment_counts = snapshot_section(data, size, &cursor, num_paths, sizeof(uint32_t));
+    PathSegment *segments = snapshot_section(data, size, &cursor, header->num_segments, sizeof(PathSegment));
+    ShotEvent *events = snapshot_section(data, size, &cursor, header->num_events, sizeof(ShotEvent));
+    char *strings = snapshot_section(data, size, &cursor, header->string_size, 1);
+    bool valid = players != NULL && cushions != NULL && pockets != NULL && balls != NULL && frames != NULL && shots != NULL && segment_counts != NULL && segments != NULL && events != NULL && strings != NULL;
+    valid = valid && header->num_players > 0 && header->num_balls > 0 && header->num_frames > 0;
+    valid = valid && header->current_player >= 0 && header->current_player < (int32_t)header->num_players;
+
+    // Check that the counts add up before pointing anything into the file.
+    uint64_t total_shots = 0;
+    uint64_t total_segments = 0;
+    uint64_t total_events = 0;
+    for (uint32_t i = 0; valid && i < header->num_frames; i++)
+    {
+        total_shots += frames[i].num_shots;
+        valid = frames[i].winner >= -1 && frames[i].winner < (int32_t)header->num_players;
+    }
+    valid = valid && total_shots == header->num_shots;
+    valid = valid && header->stats_frame >= 0 && header->stats_frame < (int32_t)header->num_frames && header->stats_shot >= 0 && header->stats_shot <= (int32_t)frames[header->stats_frame].num_shots;
+    for (uint32_t i = 0; valid && i < header->num_shots; i++)
+    {
+        total_events += shots[i].num_events;
+        valid = shots[i].player >= -1 && shots[i].player < (int32_t)header->num_players;
+    }
+    for (size_t i = 0; valid && i < num_paths; i++)
+    {
+        total_segments += segment_counts[i];
+    }
+    if (!valid || total_events != header->num_events || total_segments != header->num_segments)
+    {
+        fprintf(stderr, "Snapshot %s is corrupt\n", path);
+        free(data);
+        return NULL;
+    }
+
+    Game *game = malloc(sizeof(Game));
+    memset(game, 0, sizeof(Game));
+    game->num_players = header->num_players;
+    game->players = malloc(game->num_players * sizeof(Player));
+    for (int i = 0; i < game->num_players; i++)
+    {
+        Player *player = &(game->players[i]);
+        memset(player, 0, sizeof(Player));
+        player->type = players[i].type;
+        player->game = game;
+        player->module.name = snapshot_string(strings, header->string_size, players[i].name_offset, players[i].name_length);
+        player->module.description = snapshot_string(strings, header->string_size, players[i].description_offset, players[i].description_length);
+        player->module.library_path = snapshot_string(strings, header->string_size, players[i].library_path_offset, players[i].library_path_length);
+    }
+
+    Scene *scene = &(game->scene);
+    scene->coefficients = header->coefficients;
+    scene->table.num_cushions = header->num_cushions;
+    scene->table.cushion_capacity = header->num_cushions + 1;
+    scene->table.cushions = malloc(scene->table.cushion_capacity * sizeof(Cushion));
+    memcpy(scene->table.cushions, cushions, header->num_cushions * sizeof(Cushion));
+    scene->table.num_pockets = header->num_pockets;
+    scene->table.pocket_capacity = header->num_pockets + 1;
+    scene->table.pockets = malloc(scene->table.pocket_capacity * sizeof(Pocket));
+    memcpy(scene->table.pockets, pockets, header->num_pockets * sizeof(Pocket));
+
+    // The scene's paths keep growing as shots are simulated, so they get
+    // their own copies. Everything in the shot history points into data.
+    int num_balls = header->num_balls;
+    scene->ball_set.num_balls = num_balls;
+    scene->ball_set.ball_capacity = num_balls;
+    scene->ball_set.balls = malloc(num_balls * sizeof(Ball));
+    PathSegment *next_segment = segments;
+    for (int i = 0; i < num_balls; i++)
+    {
+        Ball *ball = &(scene->ball_set.balls[i]);
+        ball->id = balls[i].id;
+        ball->colour = (Color){balls[i].colour[0], balls[i].colour[1], balls[i].colour[2], balls[i].colour[3]};
+        ball->initial_position = balls[i].initial_position;
+        ball->initial_orientation = balls[i].initial_orientation;
+        ball->radius = balls[i].radius;
+        ball->mass = balls[i].mass;
+        ball->pocketed = balls[i].pocketed;
+        ball->path.num_segments = segment_counts[i];
+        ball->path.capacity = segment_counts[i] > 10 ? segment_counts[i] : 10;
+        ball->path.segments = malloc(ball->path.capacity * sizeof(PathSegment));
+        memcpy(ball->path.segments, next_segment, segment_counts[i] * sizeof(PathSegment));
+        next_segment += segment_counts[i];
+    }
+    for (uint32_t i = 0; i < header->num_segments; i++)
+    {
+        segments[i].orientations = NULL;
+    }
+
+    Shot *history = malloc((header->num_shots + 1) * sizeof(Shot));
+    Path *paths = malloc((header->num_shots * num_balls + 1) * sizeof(Path));
+    uint32_t *next_count = segment_counts + num_balls;
+    ShotEvent *next_event = events;
+    for (uint32_t i = 0; i < header->num_shots; i++)
+    {
+        Shot *shot = &(history[i]);
+        shot->player = shots[i].player < 0 ? NULL : &(game->players[shots[i].player]);
+        shot->ball_paths = &(paths[i * num_balls]);
+        shot->events = next_event;
+        shot->num_events = shots[i].num_events;
+        shot->event_capacity = shots[i].num_events;
+        shot->end_time = shots[i].end_time;
+        shot->v = shots[i].v;
+        shot->w = shots[i].w;
+        next_event += shots[i].num_events;
+        for (int j = 0; j < num_balls; j++)
+        {
+            shot->ball_paths[j].segments = next_segment;
+            shot->ball_paths[j].num_segments = *next_count;
+            shot->ball_paths[j].capacity = *next_count;
+            next_segment += *next_count;
+            next_count++;
+        }
+    }
+
+    // Only the last frame takes new shots, so it is the only one that
+    // needs a history of its own.
+    game->num_frames = header->num_frames;
+    game->frame_capacity = header->num_frames * 2;
+    game->frames = malloc(game->frame_capacity * sizeof(Frame));
+    Shot *next_shot = history;
+    for (int i = 0; i < game->num_frames; i++)
+    {
+        Frame *frame = &(game->frames[i]);
+        frame->num_shots = frames[i].num_shots;
+        frame->shot_capacity = frames[i].num_shots;
+        frame->shot_history = next_shot;
+        frame->winner = frames[i].winner < 0 ? NULL : &(game->players[frames[i].winner]);
+        next_shot += frames[i].num_shots;
+    }
+    Frame *current_frame = &(game->frames[game->num_frames - 1]);
+    current_frame->shot_capacity = current_frame->num_shots > 10 ? current_frame->num_shots : 10;
+    current_frame->shot_history = malloc(current_frame->shot_capacity * sizeof(Shot));
+    memcpy(current_frame->shot_history, next_shot - current_frame->num_shots, current_frame->num_shots * sizeof(Shot));
+
+    Shot shot;
+    shot.ball_paths = malloc(num_balls * sizeof(Path));
+    shot.event_capacity = 10;
+    shot.events = malloc(shot.event_capacity * sizeof(ShotEvent));
+    shot.num_events = 0;
+    game->current_shot = shot;
+
+    game->current_player = header->current_player;
+    game->consecutive_fouls = header->consecutive_fouls;
+    game->state = header->state;
+    game->seed = header->seed;
+    game->time = header->time;
+    game->playback_speed = header->playback_speed;
+    game->default_playback_speed = header->default_playback_speed;
+    game->v = header->v;
+    game->w = header->w;
+    game->p1_stats = header->p1_stats;
+    game->p2_stats = header->p2_stats;
+    game->stats_frame = header->stats_frame;
+    game->stats_shot = header->stats_shot;
+
+    game->table_version = 0;
+    game->obstacle_index = create_obstacle_index();
+    game->geometry = create_table_geometry();
+    game->pocketability = create_pocketability();
+    refresh_table_state(game);
+    add_orientation_to_path(game);
+    return game;
+}
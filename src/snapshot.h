@@ -0,0 +1,92 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include "game.h"
+#include <stdint.h>
+
+#define SNAPSHOT_MAGIC "POOLSNP"
+#define SNAPSHOT_VERSION 2
+
+// A snapshot holds everything needed to carry on with a game. It is a
+// SnapshotHeader followed by the players, cushions, pockets, balls, frames,
+// shots, segment counts, segments, events and a string table, each section
+// starting on an 8 byte boundary. Pointers are stored as indices: a shot's
+// player and a frame's winner index the players (-1 for none), and the
+// segment counts list the scene's ball paths followed by each shot's ball
+// paths in order. Segments and events are the in-memory records, so a load
+// reads the file in one go and points the shots straight into it.
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t num_players;
+    uint32_t num_cushions;
+    uint32_t num_pockets;
+    uint32_t num_balls;
+    uint32_t num_frames;
+    uint32_t num_shots;
+    uint32_t num_segments;
+    uint32_t num_events;
+    uint32_t string_size;
+    int32_t current_player;
+    int32_t consecutive_fouls;
+    int32_t state;
+    uint32_t seed;
+    double time;
+    double playback_speed;
+    double default_playback_speed;
+    Vector3 v;
+    Vector3 w;
+    Stats p1_stats;
+    Stats p2_stats;
+    int32_t stats_frame;
+    int32_t stats_shot;
+    Coefficients coefficients;
+} SnapshotHeader;
+
+// Strings are offsets into the string table and are not terminated.
+typedef struct
+{
+    int32_t type;
+    uint32_t name_offset;
+    uint32_t name_length;
+    uint32_t description_offset;
+    uint32_t description_length;
+    uint32_t library_path_offset;
+    uint32_t library_path_length;
+    uint32_t reserved;
+} SnapshotPlayer;
+
+typedef struct
+{
+    int32_t id;
+    uint8_t colour[4];
+    Vector3 initial_position;
+    uint32_t pocketed;
+    Quaternion initial_orientation;
+    double radius;
+    double mass;
+} SnapshotBall;
+
+typedef struct
+{
+    uint32_t num_shots;
+    int32_t winner;
+} SnapshotFrame;
+
+typedef struct
+{
+    int32_t player;
+    uint32_t num_events;
+    double end_time;
+    Vector3 v;
+    Vector3 w;
+} SnapshotShot;
+
+bool save_snapshot(Game *game, char *path);
+
+// The players come back with their names and library paths but without
+// modules loaded. Segments lose their orientation tables except on the
+// scene's current paths, which are rebuilt.
+Game *load_snapshot(char *path);
+
+#endif // SNAPSHOT_H
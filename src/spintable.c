@@ -0,0 +1,138 @@
+#include "spintable.h"
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+
+SpinTable *spin_tables = NULL;
+pthread_mutex_t spin_tables_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void final_position(double cut_angle, double spin_ratio, Coefficients c, double *final_x, double *final_y)
+{
+    double v_cp_x = (1 - spin_ratio) * sin(cut_angle);
+    double v_cp_y = -spin_ratio * cos(cut_angle);
+    double v_cp_mag = sqrt(v_cp_x * v_cp_x + v_cp_y * v_cp_y);
+
+    double v_roll_x = (5 + 2 * spin_ratio) * sin(cut_angle) / 7;
+    double v_roll_y = (2 * spin_ratio) * cos(cut_angle) / 7;
+    double v_roll_mag = sqrt(v_roll_x * v_roll_x + v_roll_y * v_roll_y);
+
+    *final_x = (2 * v_cp_mag / (49 * c.mu_slide * c.g)) * ((6 + spin_ratio) * sin(cut_angle)) + (v_roll_mag / (2 * c.mu_roll * c.g)) * v_roll_x;
+    *final_y = (2 * v_cp_mag / (49 * c.mu_slide * c.g)) * ((spin_ratio)*cos(cut_angle)) + (v_roll_mag / (2 * c.mu_roll * c.g)) * v_roll_y;
+}
+
+double spin_final_angle(double cut_angle, double spin_ratio, Coefficients c)
+{
+    double final_x;
+    double final_y;
+    final_position(cut_angle, spin_ratio, c, &final_x, &final_y);
+    return atan2(final_y, final_x);
+}
+
+double spin_final_distance(double cut_angle, double spin_ratio, Coefficients c)
+{
+    double final_x;
+    double final_y;
+    final_position(cut_angle, spin_ratio, c, &final_x, &final_y);
+    return sqrt(final_x * final_x + final_y * final_y);
+}
+
+// Bisects for the spin ratio in [-100, 100] whose final angle matches.
+double solve_spin_ratio(double cut_angle, double final_angle, Coefficients c)
+{
+    double upper = 100;
+    double lower = -100;
+    while (upper - lower > 0.0001)
+    {
+        double spin_ratio = (upper + lower) / 2;
+        if (spin_final_angle(cut_angle, spin_ratio, c) < final_angle)
+        {
+            lower = spin_ratio;
+        }
+        else
+        {
+            upper = spin_ratio;
+        }
+    }
+    return (upper + lower) / 2;
+}
+
+SpinTable *build_spin_table(Coefficients c)
+{
+    SpinTable *table = malloc(sizeof(SpinTable));
+    table->mu_slide = c.mu_slide;
+    table->mu_roll = c.mu_roll;
+    table->g = c.g;
+    table->num_cut_angles = 91;
+    table->num_final_angles = 271;
+    table->min_final_angle = -PI;
+    table->max_final_angle = PI / 2;
+    table->spin_ratios = malloc(table->num_cut_angles * table->num_final_angles * sizeof(double));
+    for (int i = 0; i < table->num_cut_angles; i++)
+    {
+        double cut_angle = i * (PI / 2) / (table->num_cut_angles - 1);
+        for (int j = 0; j < table->num_final_angles; j++)
+        {
+            double final_angle = table->min_final_angle + j * (table->max_final_angle - table->min_final_angle) / (table->num_final_angles - 1);
+            table->spin_ratios[i * table->num_final_angles + j] = solve_spin_ratio(cut_angle, final_angle, c);
+        }
+    }
+    table->next = NULL;
+    return table;
+}
+
+SpinTable *get_spin_table(Coefficients c)
+{
+    pthread_mutex_lock(&spin_tables_lock);
+    SpinTable *table = spin_tables;
+    while (table != NULL && (table->mu_slide != c.mu_slide || table->mu_roll != c.mu_roll || table->g != c.g))
+    {
+        table = table->next;
+    }
+    if (table == NULL)
+    {
+        table = build_spin_table(c);
+        table->next = spin_tables;
+        spin_tables = table;
+    }
+    pthread_mutex_unlock(&spin_tables_lock);
+    return table;
+}
+
+// Interpolates the spin ratio that sends the cue ball off at final_angle
+// after a cut of cut_angle, then takes one Newton step on the exact final
+// angle using the table's slope, kept only if it helps, which reduces the
+// error where the spin changes quickly. The distance is evaluated exactly at that spin.
+// Returns false, with no spin, when the final angle is beyond the cut.
+bool lookup_spin(SpinTable *table, double cut_angle, double final_angle, double *spin_ratio, double *distance)
+{
+    Coefficients c = {0};
+    c.mu_slide = table->mu_slide;
+    c.mu_roll = table->mu_roll;
+    c.g = table->g;
+    if (cut_angle + final_angle > PI / 2)
+    {
+        *spin_ratio = 0;
+        *distance = spin_final_distance(cut_angle, 0, c);
+        return false;
+    }
+    double angle_step = (table->max_final_angle - table->min_final_angle) / (table->num_final_angles - 1);
+    double u = fmax(0, fmin(1, cut_angle / (PI / 2))) * (table->num_cut_angles - 1);
+    double v = fmax(0, fmin(1, (final_angle - table->min_final_angle) / (table->max_final_angle - table->min_final_angle))) * (table->num_final_angles - 1);
+    int i = fmin(u, table->num_cut_angles - 2);
+    int j = fmin(v, table->num_final_angles - 2);
+    double fu = u - i;
+    double fv = v - j;
+    int n = table->num_final_angles;
+    double *s = &(table->spin_ratios[i * n + j]);
+    double spin = (1 - fu) * ((1 - fv) * s[0] + fv * s[1]) + fu * ((1 - fv) * s[n] + fv * s[n + 1]);
+    double slope = ((1 - fu) * (s[1] - s[0]) + fu * (s[n + 1] - s[n])) / angle_step;
+    double error = final_angle - spin_final_angle(cut_angle, spin, c);
+    double stepped = fmax(-100, fmin(100, spin + error * slope));
+    if (fabs(final_angle - spin_final_angle(cut_angle, stepped, c)) < fabs(error))
+    {
+        spin = stepped;
+    }
+    *spin_ratio = spin;
+    *distance = spin_final_distance(cut_angle, *spin_ratio, c);
+    return true;
+}
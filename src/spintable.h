@@ -0,0 +1,33 @@
+#ifndef SPINTABLE_H
+#define SPINTABLE_H
+#include "game.h"
+
+// Where the cue ball ends up after hitting an object ball, as a function of
+// the cut angle and the spin ratio (spin * radius / speed) at impact. The
+// final angle is measured from the tangent line and the final distance is
+// divided by the square of the impact speed.
+double spin_final_angle(double cut_angle, double spin_ratio, Coefficients c);
+
+double spin_final_distance(double cut_angle, double spin_ratio, Coefficients c);
+
+// The inverse of spin_final_angle sampled on a grid of cut angles and final
+// angles. Tables depend only on the friction coefficients and are built once
+// per coefficient set, then shared by every caller.
+typedef struct SpinTable
+{
+    double mu_slide;
+    double mu_roll;
+    double g;
+    int num_cut_angles;
+    int num_final_angles;
+    double min_final_angle;
+    double max_final_angle;
+    double *spin_ratios;
+    struct SpinTable *next;
+} SpinTable;
+
+SpinTable *get_spin_table(Coefficients c);
+
+bool lookup_spin(SpinTable *table, double cut_angle, double final_angle, double *spin_ratio, double *distance);
+
+#endif // SPINTABLE_H
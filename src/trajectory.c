@@ -0,0 +1,351 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "game.h"
+#include "trajectory.h"
+
+#define TRAJECTORY_TIME_QUANTUM 1e-9
+#define TRAJECTORY_POSITION_QUANTUM 1e-6
+#define TRAJECTORY_VELOCITY_QUANTUM 1e-6
+
+typedef enum
+{
+    COUNT_QUANTUM,
+    TIME_QUANTUM,
+    POSITION_QUANTUM,
+    VELOCITY_QUANTUM
+} TrajectoryQuantum;
+
+const TrajectoryQuantum trajectory_column_quanta[NUM_TRAJECTORY_COLUMNS] = {
+    [TRAJECTORY_SHOT_PLAYER] = COUNT_QUANTUM,
+    [TRAJECTORY_SHOT_END_TIME] = TIME_QUANTUM,
+    [TRAJECTORY_SHOT_NUM_EVENTS] = COUNT_QUANTUM,
+    [TRAJECTORY_PATH_NUM_SEGMENTS] = COUNT_QUANTUM,
+    [TRAJECTORY_SEGMENT_START_TIME] = TIME_QUANTUM,
+    [TRAJECTORY_SEGMENT_POSITION_X] = POSITION_QUANTUM,
+    [TRAJECTORY_SEGMENT_POSITION_Y] = POSITION_QUANTUM,
+    [TRAJECTORY_SEGMENT_VELOCITY_X] = VELOCITY_QUANTUM,
+    [TRAJECTORY_SEGMENT_VELOCITY_Y] = VELOCITY_QUANTUM,
+    [TRAJECTORY_SEGMENT_ACCELERATION_X] = VELOCITY_QUANTUM,
+    [TRAJECTORY_SEGMENT_ACCELERATION_Y] = VELOCITY_QUANTUM,
+    [TRAJECTORY_SEGMENT_ANGULAR_VELOCITY_X] = VELOCITY_QUANTUM,
+    [TRAJECTORY_SEGMENT_ANGULAR_VELOCITY_Y] = VELOCITY_QUANTUM,
+    [TRAJECTORY_SEGMENT_ANGULAR_VELOCITY_Z] = VELOCITY_QUANTUM,
+    [TRAJECTORY_SEGMENT_ANGULAR_ACCELERATION_X] = VELOCITY_QUANTUM,
+    [TRAJECTORY_SEGMENT_ANGULAR_ACCELERATION_Y] = VELOCITY_QUANTUM,
+    [TRAJECTORY_SEGMENT_ANGULAR_ACCELERATION_Z] = VELOCITY_QUANTUM,
+    [TRAJECTORY_SEGMENT_ROLLING] = COUNT_QUANTUM,
+    [TRAJECTORY_EVENT_TIME] = TIME_QUANTUM,
+    [TRAJECTORY_EVENT_TYPE] = COUNT_QUANTUM,
+    [TRAJECTORY_EVENT_BALL1] = COUNT_QUANTUM,
+    [TRAJECTORY_EVENT_BALL2] = COUNT_QUANTUM,
+    [TRAJECTORY_EVENT_CUSHION_OR_POCKET] = COUNT_QUANTUM,
+};
+
+double trajectory_quantum(TrajectoryHeader *header, TrajectoryColumn column)
+{
+    switch (trajectory_column_quanta[column])
+    {
+    case TIME_QUANTUM:
+        return header->time_quantum;
+    case POSITION_QUANTUM:
+        return header->position_quantum;
+    case VELOCITY_QUANTUM:
+        return header->velocity_quantum;
+    default:
+        return 1;
+    }
+}
+
+void trajectory_write(TrajectoryWriter *writer, const void *data, size_t size)
+{
+    if (size > 0 && fwrite(data, 1, size, writer->file) != size)
+    {
+        writer->failed = true;
+    }
+    writer->offset += size;
+}
+
+void trajectory_pad(TrajectoryWriter *writer)
+{
+    char zeros[8] = {0};
+    trajectory_write(writer, zeros, (8 - writer->offset % 8) % 8);
+}
+
+void trajectory_push(TrajectoryWriter *writer, TrajectoryColumn column, double value)
+{
+    int64_t quantised = llround(value / trajectory_quantum(&(writer->header), column));
+    int64_t delta = quantised - writer->previous[column];
+    writer->previous[column] = quantised;
+    uint64_t zigzag = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+
+    TrajectoryBuffer *buffer = &(writer->columns[column]);
+    if (buffer->size + 10 > buffer->capacity)
+    {
+        buffer->capacity = buffer->capacity * 2 + 16;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+    }
+    while (zigzag >= 0x80)
+    {
+        buffer->data[buffer->size++] = (uint8_t)(zigzag | 0x80);
+        zigzag >>= 7;
+    }
+    buffer->data[buffer->size++] = (uint8_t)zigzag;
+}
+
+int trajectory_player_index(Game *game, Player *player)
+{
+    return player == NULL ? -1 : (int)(player - game->players);
+}
+
+TrajectoryWriter *open_trajectory_writer(char *path, Game *game)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return NULL;
+    }
+    TrajectoryWriter *writer = malloc(sizeof(TrajectoryWriter));
+    memset(writer, 0, sizeof(TrajectoryWriter));
+    writer->file = file;
+
+    TrajectoryHeader *header = &(writer->header);
+    memcpy(header->magic, TRAJECTORY_MAGIC, sizeof(TRAJECTORY_MAGIC));
+    header->version = TRAJECTORY_VERSION;
+    header->num_players = game->num_players;
+    header->num_balls = game->scene.ball_set.num_balls;
+    header->time_quantum = TRAJECTORY_TIME_QUANTUM;
+    header->position_quantum = TRAJECTORY_POSITION_QUANTUM;
+    header->velocity_quantum = TRAJECTORY_VELOCITY_QUANTUM;
+    header->coefficients = game->scene.coefficients;
+    trajectory_write(writer, header, sizeof(TrajectoryHeader));
+
+    for (int i = 0; i < game->num_players; i++)
+    {
+        char *name = game->players[i].module.name;
+        uint32_t length = strlen(name);
+        trajectory_write(writer, &length, sizeof(uint32_t));
+        trajectory_write(writer, name, length);
+    }
+
+    writer->block_capacity = 16;
+    writer->blocks = malloc(writer->block_capacity * sizeof(TrajectoryBlock));
+    return writer;
+}
+
+void write_trajectory_frame(TrajectoryWriter *writer, Game *game, Frame *frame)
+{
+    int num_balls = writer->header.num_balls;
+    TrajectoryBlock block;
+    memset(&block, 0, sizeof(TrajectoryBlock));
+    block.frame = frame - game->frames;
+    block.winner = trajectory_player_index(game, frame->winner);
+    block.num_shots = frame->num_shots;
+    for (int i = 0; i < NUM_TRAJECTORY_COLUMNS; i++)
+    {
+        writer->columns[i].size = 0;
+        writer->previous[i] = 0;
+    }
+
+    for (int i = 0; i < frame->num_shots; i++)
+    {
+        Shot *shot = &(frame->shot_history[i]);
+        trajectory_push(writer, TRAJECTORY_SHOT_PLAYER, trajectory_player_index(game, shot->player));
+        trajectory_push(writer, TRAJECTORY_SHOT_END_TIME, shot->end_time);
+        trajectory_push(writer, TRAJECTORY_SHOT_NUM_EVENTS, shot->num_events);
+        for (int j = 0; j < num_balls; j++)
+        {
+            Path *path = &(shot->ball_paths[j]);
+            trajectory_push(writer, TRAJECTORY_PATH_NUM_SEGMENTS, path->num_segments);
+            for (int k = 0; k < path->num_segments; k++)
+            {
+                PathSegment *segment = &(path->segments[k]);
+                trajectory_push(writer, TRAJECTORY_SEGMENT_START_TIME, segment->start_time);
+                trajectory_push(writer, TRAJECTORY_SEGMENT_POSITION_X, segment->initial_position.x);
+                trajectory_push(writer, TRAJECTORY_SEGMENT_POSITION_Y, segment->initial_position.y);
+                trajectory_push(writer, TRAJECTORY_SEGMENT_VELOCITY_X, segment->initial_velocity.x);
+                trajectory_push(writer, TRAJECTORY_SEGMENT_VELOCITY_Y, segment->initial_velocity.y);
+                trajectory_push(writer, TRAJECTORY_SEGMENT_ACCELERATION_X, segment->acceleration.x);
+                trajectory_push(writer, TRAJECTORY_SEGMENT_ACCELERATION_Y, segment->acceleration.y);
+                trajectory_push(writer, TRAJECTORY_SEGMENT_ANGULAR_VELOCITY_X, segment->initial_angular_velocity.x);
+                trajectory_push(writer, TRAJECTORY_SEGMENT_ANGULAR_VELOCITY_Y, segment->initial_angular_velocity.y);
+                trajectory_push(writer, TRAJECTORY_SEGMENT_ANGULAR_VELOCITY_Z, segment->initial_angular_velocity.z);
+                trajectory_push(writer, TRAJECTORY_SEGMENT_ANGULAR_ACCELERATION_X, segment->angular_acceleration.x);
+                trajectory_push(writer, TRAJECTORY_SEGMENT_ANGULAR_ACCELERATION_Y, segment->angular_acceleration.y);
+                trajectory_push(writer, TRAJECTORY_SEGMENT_ANGULAR_ACCELERATION_Z, segment->angular_acceleration.z);
+                trajectory_push(writer, TRAJECTORY_SEGMENT_ROLLING, segment->rolling);
+            }
+            block.num_segments += path->num_segments;
+        }
+        for (int j = 0; j < shot->num_events; j++)
+        {
+            ShotEvent *event = &(shot->events[j]);
+            trajectory_push(writer, TRAJECTORY_EVENT_TIME, event->time);
+            trajectory_push(writer, TRAJECTORY_EVENT_TYPE, event->type);
+            trajectory_push(writer, TRAJECTORY_EVENT_BALL1, event->ball1);
+            trajectory_push(writer, TRAJECTORY_EVENT_BALL2, event->ball2);
+            trajectory_push(writer, TRAJECTORY_EVENT_CUSHION_OR_POCKET, event->cushion_or_pocket);
+        }
+        block.num_events += shot->num_events;
+    }
+
+    for (int i = 0; i < NUM_TRAJECTORY_COLUMNS; i++)
+    {
+        block.column_offsets[i] = writer->offset;
+        block.column_sizes[i] = writer->columns[i].size;
+        trajectory_write(writer, writer->columns[i].data, writer->columns[i].size);
+    }
+
+    if (writer->header.num_blocks == (uint32_t)writer->block_capacity)
+    {
+        writer->block_capacity *= 2;
+        writer->blocks = realloc(writer->blocks, writer->block_capacity * sizeof(TrajectoryBlock));
+    }
+    writer->blocks[writer->header.num_blocks++] = block;
+}
+
+bool close_trajectory_writer(TrajectoryWriter *writer)
+{
+    trajectory_pad(writer);
+    writer->header.index_offset = writer->offset;
+    trajectory_write(writer, writer->blocks, writer->header.num_blocks * sizeof(TrajectoryBlock));
+    if (fseek(writer->file, 0, SEEK_SET) != 0 || fwrite(&(writer->header), sizeof(TrajectoryHeader), 1, writer->file) != 1)
+    {
+        writer->failed = true;
+    }
+    if (fclose(writer->file) != 0)
+    {
+        writer->failed = true;
+    }
+    bool ok = !writer->failed;
+    for (int i = 0; i < NUM_TRAJECTORY_COLUMNS; i++)
+    {
+        free(writer->columns[i].data);
+    }
+    free(writer->blocks);
+    free(writer);
+    return ok;
+}
+
+bool export_trajectories(Game *game, char *path)
+{
+    TrajectoryWriter *writer = open_trajectory_writer(path, game);
+    if (writer == NULL)
+    {
+        return false;
+    }
+    for (int i = 0; i < game->num_frames; i++)
+    {
+        write_trajectory_frame(writer, game, &(game->frames[i]));
+    }
+    if (!close_trajectory_writer(writer))
+    {
+        fprintf(stderr, "Failed to write %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+TrajectoryArchive *open_trajectory_archive(char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open trajectory archive %s\n", path);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TrajectoryHeader))
+    {
+        fprintf(stderr, "Trajectory archive %s is too small\n", path);
+        close(fd);
+        return NULL;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map trajectory archive %s\n", path);
+        return NULL;
+    }
+    TrajectoryHeader *header = data;
+    if (memcmp(header->magic, TRAJECTORY_MAGIC, sizeof(TRAJECTORY_MAGIC)) != 0 || header->version != TRAJECTORY_VERSION)
+    {
+        fprintf(stderr, "%s is not a version %d trajectory archive\n", path, TRAJECTORY_VERSION);
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    if (header->index_offset == 0 || header->index_offset + header->num_blocks * sizeof(TrajectoryBlock) > (size_t)st.st_size)
+    {
+        fprintf(stderr, "Trajectory archive %s has no block index\n", path);
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    TrajectoryArchive *archive = malloc(sizeof(TrajectoryArchive));
+    archive->data = data;
+    archive->size = st.st_size;
+    archive->header = header;
+    archive->blocks = (TrajectoryBlock *)((char *)data + header->index_offset);
+    return archive;
+}
+
+void close_trajectory_archive(TrajectoryArchive *archive)
+{
+    munmap(archive->data, archive->size);
+    free(archive);
+}
+
+int trajectory_column_length(TrajectoryArchive *archive, TrajectoryBlock *block, TrajectoryColumn column)
+{
+    if (column <= TRAJECTORY_SHOT_NUM_EVENTS)
+    {
+        return block->num_shots;
+    }
+    if (column == TRAJECTORY_PATH_NUM_SEGMENTS)
+    {
+        return block->num_shots * archive->header->num_balls;
+    }
+    if (column <= TRAJECTORY_SEGMENT_ROLLING)
+    {
+        return block->num_segments;
+    }
+    return block->num_events;
+}
+
+bool read_trajectory_column(TrajectoryArchive *archive, TrajectoryBlock *block, TrajectoryColumn column, double *values)
+{
+    uint64_t offset = block->column_offsets[column];
+    uint64_t size = block->column_sizes[column];
+    if (offset > archive->size || size > archive->size - offset)
+    {
+        return false;
+    }
+    uint8_t *bytes = (uint8_t *)archive->data + offset;
+    uint8_t *end = bytes + size;
+    double quantum = trajectory_quantum(archive->header, column);
+    int length = trajectory_column_length(archive, block, column);
+    int64_t value = 0;
+    for (int i = 0; i < length; i++)
+    {
+        uint64_t zigzag = 0;
+        int shift = 0;
+        do
+        {
+            if (bytes == end || shift > 63)
+            {
+                return false;
+            }
+            zigzag |= (uint64_t)(*bytes & 0x7f) << shift;
+            shift += 7;
+        } while (*bytes++ & 0x80);
+        value += (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+        values[i] = value * quantum;
+    }
+    return bytes == end;
+}
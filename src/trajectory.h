@@ -0,0 +1,120 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+#include "game.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#define TRAJECTORY_MAGIC "POOLTRJ"
+#define TRAJECTORY_VERSION 1
+
+// A trajectory archive keeps the shots of a game as columns for offline
+// analysis. There is one block per frame and every block stores each column
+// below as its own run of varints, so a scan over one quantity only touches
+// that column's bytes. Values are quantised to the header's quanta and every
+// column holds the zigzag encoded difference from the value before it in the
+// same block. Orientations are not kept, and a segment's end time is the
+// start of the next segment of its path, or infinity for the last one.
+typedef enum
+{
+    TRAJECTORY_SHOT_PLAYER,
+    TRAJECTORY_SHOT_END_TIME,
+    TRAJECTORY_SHOT_NUM_EVENTS,
+    TRAJECTORY_PATH_NUM_SEGMENTS,
+    TRAJECTORY_SEGMENT_START_TIME,
+    TRAJECTORY_SEGMENT_POSITION_X,
+    TRAJECTORY_SEGMENT_POSITION_Y,
+    TRAJECTORY_SEGMENT_VELOCITY_X,
+    TRAJECTORY_SEGMENT_VELOCITY_Y,
+    TRAJECTORY_SEGMENT_ACCELERATION_X,
+    TRAJECTORY_SEGMENT_ACCELERATION_Y,
+    TRAJECTORY_SEGMENT_ANGULAR_VELOCITY_X,
+    TRAJECTORY_SEGMENT_ANGULAR_VELOCITY_Y,
+    TRAJECTORY_SEGMENT_ANGULAR_VELOCITY_Z,
+    TRAJECTORY_SEGMENT_ANGULAR_ACCELERATION_X,
+    TRAJECTORY_SEGMENT_ANGULAR_ACCELERATION_Y,
+    TRAJECTORY_SEGMENT_ANGULAR_ACCELERATION_Z,
+    TRAJECTORY_SEGMENT_ROLLING,
+    TRAJECTORY_EVENT_TIME,
+    TRAJECTORY_EVENT_TYPE,
+    TRAJECTORY_EVENT_BALL1,
+    TRAJECTORY_EVENT_BALL2,
+    TRAJECTORY_EVENT_CUSHION_OR_POCKET,
+    NUM_TRAJECTORY_COLUMNS
+} TrajectoryColumn;
+
+// The header is followed by each player's name as a length and the
+// characters, then the blocks and finally one TrajectoryBlock per frame.
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t num_players;
+    uint32_t num_balls;
+    uint32_t num_blocks;
+    uint64_t index_offset;
+    double time_quantum;
+    double position_quantum;
+    double velocity_quantum;
+    Coefficients coefficients;
+} TrajectoryHeader;
+
+// Shot columns have num_shots values, path columns num_shots * num_balls,
+// segment columns num_segments and event columns num_events.
+typedef struct
+{
+    uint32_t frame;
+    int32_t winner;
+    uint32_t num_shots;
+    uint32_t num_segments;
+    uint32_t num_events;
+    uint32_t column_sizes[NUM_TRAJECTORY_COLUMNS];
+    uint64_t column_offsets[NUM_TRAJECTORY_COLUMNS];
+} TrajectoryBlock;
+
+typedef struct
+{
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+} TrajectoryBuffer;
+
+typedef struct
+{
+    FILE *file;
+    uint64_t offset;
+    bool failed;
+    TrajectoryHeader header;
+    TrajectoryBuffer columns[NUM_TRAJECTORY_COLUMNS];
+    int64_t previous[NUM_TRAJECTORY_COLUMNS];
+    TrajectoryBlock *blocks;
+    int block_capacity;
+} TrajectoryWriter;
+
+TrajectoryWriter *open_trajectory_writer(char *path, Game *game);
+
+void write_trajectory_frame(TrajectoryWriter *writer, Game *game, Frame *frame);
+
+bool close_trajectory_writer(TrajectoryWriter *writer);
+
+bool export_trajectories(Game *game, char *path);
+
+// A trajectory archive mapped read-only.
+typedef struct
+{
+    void *data;
+    size_t size;
+    TrajectoryHeader *header;
+    TrajectoryBlock *blocks;
+} TrajectoryArchive;
+
+TrajectoryArchive *open_trajectory_archive(char *path);
+
+void close_trajectory_archive(TrajectoryArchive *archive);
+
+int trajectory_column_length(TrajectoryArchive *archive, TrajectoryBlock *block, TrajectoryColumn column);
+
+// Decodes one column of a block into values, which must have room for
+// trajectory_column_length values. Returns false if the column is corrupt.
+bool read_trajectory_column(TrajectoryArchive *archive, TrajectoryBlock *block, TrajectoryColumn column, double *values);
+
+#endif // TRAJECTORY_H
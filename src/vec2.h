@@ -0,0 +1,67 @@
+#ifndef VEC2_H
+#define VEC2_H
+#include <raylib.h>
+#include <math.h>
+
+// Balls never leave the bed, so the simulation keeps positions, velocities
+// and accelerations as planar doubles. Vector3 is only used where the rest
+// of the program (players, cushions, rendering) expects it.
+typedef struct
+{
+    double x;
+    double y;
+} Vec2;
+
+static inline Vec2 Vec2Add(Vec2 v, Vec2 w)
+{
+    return (Vec2){v.x + w.x, v.y + w.y};
+}
+
+static inline Vec2 Vec2Subtract(Vec2 v, Vec2 w)
+{
+    return (Vec2){v.x - w.x, v.y - w.y};
+}
+
+static inline Vec2 Vec2Scale(Vec2 v, double s)
+{
+    return (Vec2){v.x * s, v.y * s};
+}
+
+static inline double Vec2DotProduct(Vec2 v, Vec2 w)
+{
+    return v.x * w.x + v.y * w.y;
+}
+
+static inline double Vec2Length(Vec2 v)
+{
+    return sqrt(v.x * v.x + v.y * v.y);
+}
+
+static inline Vec2 Vec2Normalize(Vec2 v)
+{
+    double length = Vec2Length(v);
+    if (length == 0)
+    {
+        return v;
+    }
+    return Vec2Scale(v, 1 / length);
+}
+
+// The outward normal of a cushion running from p1 to p2, in the same sense
+// as Cross(p2 - p1, (0, 0, 1)).
+static inline Vec2 Vec2LineNormal(Vec2 p1, Vec2 p2)
+{
+    return Vec2Normalize((Vec2){p2.y - p1.y, p1.x - p2.x});
+}
+
+static inline Vec2 Vec2FromVector3(Vector3 v)
+{
+    return (Vec2){v.x, v.y};
+}
+
+static inline Vector3 Vec2ToVector3(Vec2 v)
+{
+    return (Vector3){v.x, v.y, 0};
+}
+
+#endif // VEC2_H